@@ -0,0 +1,248 @@
+//
+// Instruction buffers and their rendering as SPIM assembly text; see
+// asm_writer.h.
+//
+#include <assert.h>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include "emit.h"
+
+static const char *reg_names[32] = {
+  "$zero", "$at", "$v0", "$v1", "$a0", "$a1", "$a2", "$a3",
+  "$t0", "$t1", "$t2", "$t3", "$t4", "$t5", "$t6", "$t7",
+  "$s0", "$s1", "$s2", "$s3", "$s4", "$s5", "$s6", "$s7",
+  "$t8", "$t9", "$k0", "$k1", "$gp", "$sp", "$fp", "$ra"
+};
+
+int asm_reg(const char *name)
+{
+  int n = name[2] - '0';
+  switch (name[1]) {
+  case 'a': return n >= 0 && n <= 3 ? 4 + n : 1;
+  case 'v': return 2 + n;
+  case 't': return n <= 7 ? 8 + n : 16 + n;
+  case 's': return name[2] == 'p' ? 29 : 16 + n;
+  case 'k': return 26 + n;
+  case 'g': return 28;
+  case 'f': return 30;
+  case 'r': return 31;
+  case 'z': return 0;
+  }
+  assert(!"unknown register");
+  return 0;
+}
+
+const char *asm_reg_name(int reg)
+{
+  return reg_names[reg];
+}
+
+struct AsmName {
+  const char *text;
+  int len;
+};
+
+//
+// names holds the text of every label, and name_numbers numbers it by
+// its contents, so the same text always gets the same number.  Both
+// are shared by the threads of -j and guarded by names_lock; each
+// thread keeps its own cache of the numbers it has looked up, by the
+// pointer or symbols it was given, and only takes the lock on a miss.
+//
+static std::vector<AsmName> names;
+static std::unordered_map<std::string, int> name_numbers;
+static std::mutex names_lock;
+
+typedef std::pair<Symbol, std::pair<const char *, Symbol> > SymbolKey;
+static thread_local std::map<const char *, int> name_cache;
+static thread_local std::map<SymbolKey, int> symbol_cache;
+
+static int intern(const std::string &text)
+{
+  std::lock_guard<std::mutex> hold(names_lock);
+  std::unordered_map<std::string, int>::iterator i = name_numbers.find(text);
+  if (i != name_numbers.end())
+    return i->second;
+  char *copy = new char[text.size() + 1];
+  memcpy(copy, text.c_str(), text.size() + 1);
+  AsmName name = { copy, (int) text.size() };
+  names.push_back(name);
+  return name_numbers[text] = names.size() - 1;
+}
+
+int asm_name(const char *name)
+{
+  std::map<const char *, int>::iterator i = name_cache.find(name);
+  if (i != name_cache.end())
+    return i->second;
+  return name_cache[name] = intern(name);
+}
+
+int asm_symbol(Symbol sym, const char *suffix, Symbol sym2)
+{
+  SymbolKey key(sym, std::make_pair(suffix, sym2));
+  std::map<SymbolKey, int>::iterator i = symbol_cache.find(key);
+  if (i != symbol_cache.end())
+    return i->second;
+  std::string text(sym->get_string(), sym->get_len());
+  text += suffix;
+  if (sym2)
+    text.append(sym2->get_string(), sym2->get_len());
+  return symbol_cache[key] = intern(text);
+}
+
+//
+// Rendering.
+//
+AsmWriter &AsmWriter::label(int l)
+{
+  int n = ASM_LABEL_NUM(l);
+  switch (ASM_LABEL_KIND(l)) {
+  case LABEL_LOCAL:        return *this << "label" << n;
+  case LABEL_NAME:         buf->sputn(names[n].text, names[n].len); return *this;
+  case LABEL_INT_CONST:    return *this << INTCONST_PREFIX << n;
+  case LABEL_STR_CONST:    return *this << STRCONST_PREFIX << n;
+  case LABEL_BOOL_CONST:   return *this << BOOLCONST_PREFIX << n;
+  case LABEL_INLINE_CACHE: return *this << INLINECACHE_PREFIX << n;
+  }
+  assert(!"unknown label kind");
+  return *this;
+}
+
+static const char *mnemonics[] = {
+  "", "", LW, SW, LI, LA, MOVE, NEG, ADD, ADDU, DIV, MUL, SUB,
+  ADDI, ADDIU, SLL, SRL, SRA, SLTIU, JALR, JAL, RET, BRANCH,
+  BEQZ, BEQ, BNE, BLEQ, BLT, BNE, BLT, BGT
+};
+
+AsmWriter &AsmWriter::insn(const AsmInsn &in)
+{
+  const char *r1 = reg_names[in.r1], *r2 = reg_names[in.r2];
+  *this << mnemonics[in.op];
+  switch (in.op) {
+  case ASM_LABEL:
+    return label(in.label) << ":\n";
+  case ASM_LW: case ASM_SW:
+    return *this << r1 << " " << in.imm << "(" << r2 << ")\n";
+  case ASM_LI:
+    return *this << r1 << " " << in.imm << "\n";
+  case ASM_LA:
+    return (*this << r1 << " ").label(in.label) << "\n";
+  case ASM_MOVE: case ASM_NEG:
+    return *this << r1 << " " << r2 << "\n";
+  case ASM_ADD: case ASM_ADDU: case ASM_DIV: case ASM_MUL: case ASM_SUB:
+    return *this << r1 << " " << r2 << " " << reg_names[in.r3] << "\n";
+  case ASM_ADDI: case ASM_ADDIU: case ASM_SLL: case ASM_SRL: case ASM_SRA:
+  case ASM_SLTIU:
+    return *this << r1 << " " << r2 << " " << in.imm << "\n";
+  case ASM_JALR:
+    return *this << "\t" << r1 << "\n";
+  case ASM_JAL: case ASM_B:
+    return label(in.label) << "\n";
+  case ASM_RET:
+    return *this << "\n";
+  case ASM_BEQZ:
+    return (*this << r1 << " ").label(in.label) << "\n";
+  case ASM_BEQ: case ASM_BNE: case ASM_BLE: case ASM_BLT:
+    return (*this << r1 << " " << r2 << " ").label(in.label) << "\n";
+  case ASM_BNEI: case ASM_BLTI: case ASM_BGTI:
+    return (*this << r1 << " " << in.imm << " ").label(in.label) << "\n";
+  }
+  assert(!"unknown instruction");
+  return *this;
+}
+
+//
+// Buffers.
+//
+AsmBuffer::AsmBuffer(size_t size) : text(size), text_start(0)
+{
+  setp(&text[0], &text[0] + size);
+}
+
+void AsmBuffer::grow(size_t need)
+{
+  size_t used = pptr() - pbase();
+  size_t size = text.size() * 2;
+  if (size < used + need)
+    size = used + need;
+  text.resize(size);
+  setp(&text[0], &text[0] + text.size());
+  pbump((int) used);
+}
+
+AsmBuffer::int_type AsmBuffer::overflow(int_type c)
+{
+  if (traits_type::eq_int_type(c, traits_type::eof()))
+    return traits_type::not_eof(c);
+  grow(1);
+  *pptr() = traits_type::to_char_type(c);
+  pbump(1);
+  return c;
+}
+
+std::streamsize AsmBuffer::xsputn(const char *p, std::streamsize n)
+{
+  if (epptr() - pptr() < n)
+    grow(n);
+  memcpy(pptr(), p, n);
+  pbump((int) n);
+  return n;
+}
+
+// the text written since the last instruction becomes a record
+void AsmBuffer::end_text()
+{
+  size_t end = pptr() - pbase();
+  if (end == text_start)
+    return;
+  AsmInsn t = { ASM_TEXT, 0, 0, 0, (int) text_start, (int) (end - text_start) };
+  code.push_back(t);
+  text_start = end;
+}
+
+//
+// Appends other's code; its label<n> become label<n + labels> and its
+// inline cache n becomes cache n + caches, for code numbered apart
+// from this (see CgenClassTable::code_classes).
+//
+void AsmBuffer::append(AsmBuffer &other, int labels, int caches)
+{
+  end_text();
+  other.end_text();
+  for (size_t i = 0; i < other.code.size(); i++) {
+    AsmInsn in = other.code[i];
+    if (in.op == ASM_TEXT) {
+      xsputn(&other.text[in.imm], in.label);
+      end_text();
+      continue;
+    }
+    if (asm_has_label(in.op)) {
+      if (ASM_LABEL_KIND(in.label) == LABEL_LOCAL)
+        in.label += labels;
+      else if (ASM_LABEL_KIND(in.label) == LABEL_INLINE_CACHE)
+        in.label += caches;
+    }
+    code.push_back(in);
+  }
+}
+
+void AsmBuffer::clear()
+{
+  code.clear();
+  setp(&text[0], &text[0] + text.size());
+  text_start = 0;
+}
+
+void AsmBuffer::write_to(ostream &s)
+{
+  end_text();
+  AsmWriter w(s);
+  for (size_t i = 0; i < code.size(); i++)
+    if (code[i].op == ASM_TEXT)
+      s.rdbuf()->sputn(&text[code[i].imm], code[i].label);
+    else
+      w.insn(code[i]);
+}
@@ -0,0 +1,149 @@
+//
+// Assembly code as the MIPS code generator builds it.
+//
+// The emit_* helpers of cgen.cc do not write text: each appends an
+// AsmInsn -- an opcode, register numbers, an immediate and a label --
+// to the AsmBuffer behind their stream.  Anything else written to the
+// stream with << (directives, data, comments) is kept as text between
+// the instructions.  Code is rendered to text in one pass at the end,
+// so passes in between can look at instructions rather than strings.
+//
+// AsmWriter formats the pieces of a line -- strings, register names,
+// labels, offsets and immediates -- straight into the buffer of a
+// stream, without the sentry and locale of ostream's inserters.  Lines
+// end in '\n', not endl, which would flush.
+//
+#ifndef ASM_WRITER_H
+#define ASM_WRITER_H
+
+#include <string.h>
+#include <vector>
+#include "stringtab.h"
+
+enum AsmOp {
+  ASM_TEXT,                     // text written with <<: offset, length
+  ASM_LABEL,                    // label:
+  ASM_LW, ASM_SW,               // r1 imm(r2)
+  ASM_LI,                       // r1 imm
+  ASM_LA,                       // r1 label
+  ASM_MOVE, ASM_NEG,            // r1 r2
+  ASM_ADD, ASM_ADDU, ASM_DIV, ASM_MUL, ASM_SUB,         // r1 r2 r3
+  ASM_ADDI, ASM_ADDIU, ASM_SLL, ASM_SRL, ASM_SRA,       // r1 r2 imm
+  ASM_SLTIU,
+  ASM_JALR,                     // r1
+  ASM_JAL,                      // label
+  ASM_RET,
+  ASM_B,                        // label
+  ASM_BEQZ,                     // r1 label
+  ASM_BEQ, ASM_BNE, ASM_BLE, ASM_BLT,                   // r1 r2 label
+  ASM_BNEI, ASM_BLTI, ASM_BGTI                          // r1 imm label
+};
+
+//
+// A label is its kind in the top four bits and a number: label<n>,
+// the name with asm_name number n, a constant, or inline cache n.
+//
+enum AsmLabelKind {
+  LABEL_LOCAL, LABEL_NAME, LABEL_INT_CONST, LABEL_STR_CONST,
+  LABEL_BOOL_CONST, LABEL_INLINE_CACHE
+};
+
+#define ASM_LABEL_BITS     28
+#define ASM_LABEL_ID(k, n) (((k) << ASM_LABEL_BITS) | (n))
+#define ASM_LABEL_KIND(l)  ((l) >> ASM_LABEL_BITS)
+#define ASM_LABEL_NUM(l)   ((l) & ((1 << ASM_LABEL_BITS) - 1))
+
+struct AsmInsn {
+  unsigned char op, r1, r2, r3;
+  int imm;
+  int label;
+};
+static_assert(sizeof(AsmInsn) == 12, "AsmInsn should stay 12 bytes");
+
+// the instructions whose label field is a label
+inline bool asm_has_label(int op)
+{
+  return op == ASM_LABEL || op == ASM_LA || op == ASM_JAL || op >= ASM_B;
+}
+
+// number of the register called name ("$a0"), and its name
+int asm_reg(const char *name);
+const char *asm_reg_name(int reg);
+
+//
+// The label table.  Every named label is interned once and numbered,
+// and its text made then, so a reference to it is one copy into the
+// buffer and labels compare by number.  Both are safe to call from
+// several threads.
+//
+// number of a name that outlives the code generator, such as a
+// runtime routine's
+int asm_name(const char *name);
+// number of the label sym followed by suffix, as in Foo_dispTab, or by
+// sep and sym2, as in Foo.bar
+int asm_symbol(Symbol sym, const char *suffix, Symbol sym2 = NULL);
+
+class AsmWriter {
+  std::streambuf *buf;
+
+public:
+  AsmWriter(ostream &s) : buf(s.rdbuf()) { }
+
+  AsmWriter &operator<<(const char *str) { buf->sputn(str, strlen(str)); return *this; }
+  AsmWriter &operator<<(char c) { buf->sputc(c); return *this; }
+  AsmWriter &operator<<(Symbol sym) { buf->sputn(sym->get_string(), sym->get_len()); return *this; }
+
+  AsmWriter &operator<<(int n)
+  {
+    char text[12], *p = text + sizeof text;
+    unsigned u = n < 0 ? 0u - (unsigned) n : (unsigned) n;
+    do
+      *--p = '0' + u % 10;
+    while (u /= 10);
+    if (n < 0)
+      *--p = '-';
+    buf->sputn(p, text + sizeof text - p);
+    return *this;
+  }
+
+  AsmWriter &label(int l);
+  AsmWriter &insn(const AsmInsn &in);
+};
+
+//
+// Instructions, and the text written between them, which is kept in a
+// contiguous block that grows as needed and is never flushed.
+//
+class AsmBuffer : public std::streambuf {
+  std::vector<AsmInsn> code;
+  std::vector<char> text;
+  size_t text_start;                // of text not yet in code
+
+  void grow(size_t need);
+  void end_text();
+
+protected:
+  int_type overflow(int_type c);
+  std::streamsize xsputn(const char *p, std::streamsize n);
+  int sync() { return 0; }
+
+public:
+  AsmBuffer(size_t size = 256);
+
+  void append(const AsmInsn &in) { end_text(); code.push_back(in); }
+  void append(AsmBuffer &other, int labels = 0, int caches = 0);
+  void clear();
+  const std::vector<AsmInsn> &insns() { end_text(); return code; }
+  void write_to(ostream &s);
+};
+
+// an output string stream that keeps instructions
+class AsmStream : public ostream {
+  AsmBuffer buf;
+
+public:
+  AsmStream() : ostream(0) { rdbuf(&buf); }
+  AsmBuffer &buffer() { return buf; }
+};
+
+#endif
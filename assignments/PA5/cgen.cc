@@ -22,11 +22,26 @@
 //
 //**************************************************************
 
+#include <climits>
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <map>
+#include <thread>
 #include "cgen.h"
 #include "cgen_gc.h"
 
 extern void emit_string_constant(ostream& str, char *s);
 extern int cgen_debug;
+extern int cgen_optimize;
+extern int cgen_compact_disptabs;
+extern int cgen_inline_caches;
+extern int cgen_reg_args;
+extern int cgen_profile_generate;
+extern char *cgen_profile_use;
+extern int cgen_jobs;
+extern int cgen_int_cache_min;
+extern int cgen_int_cache_max;
 
 //
 // Three symbols from the semantic analyzer (semant.cc) are used.
@@ -105,10 +120,14 @@ static void initialize_constants(void)
   val         = idtable.add_string("_val");
 }
 
+//
+// With -G the initializer is a stub in the program text that hands the
+// stack maps to the generational collector (see code_global_text).
+//
 static char *gc_init_names[] =
-  { "_NoGC_Init", "_GenGC_Init", "_ScnGC_Init" };
+  { "_NoGC_Init", "_GenGC_Init", "_ScnGC_Init", "_PrecGC_Init" };
 static char *gc_collect_names[] =
-  { "_NoGC_Collect", "_GenGC_Collect", "_ScnGC_Collect" };
+  { "_NoGC_Collect", "_GenGC_Collect", "_ScnGC_Collect", "_GenGC_Collect" };
 
 
 //  BoolConst is a class that implements code generation for operations
@@ -116,6 +135,99 @@ static char *gc_collect_names[] =
 BoolConst falsebool(FALSE);
 BoolConst truebool(TRUE);
 
+//
+// State of the code generator while emitting the body of a method.
+// Temporaries live in the frame at 0($fp), 4($fp), ...; a leaf method
+// (one that calls nothing, compiled with -O) has no frame at all and
+// keeps its temporaries in registers and self in $t0.  With -j each
+// thread coding classes has its own (see CgenClassTable::code_classes).
+//
+static CgenClassTableP codegen_classtable = NULL;
+thread_local CgenNodeP curr_class = NULL;  // also read by numTemps() for cgen_x86.cc
+static thread_local SymbolTable<Symbol,VarLoc> *var_env = NULL;
+static thread_local int curr_formals;      // formals passed on the stack
+static thread_local int curr_temps;        // temporaries reserved by the frame
+static thread_local int next_temp;         // first free temporary
+static thread_local bool leaf_method;      // method runs without a frame
+static thread_local char *self_reg = SELF; // register holding self
+static thread_local int next_label = 0;
+static thread_local int gc_barriers = 0;   // attribute stores through _GenGC_Assign
+static thread_local int gc_barriers_elided = 0;
+static thread_local int inline_caches = 0; // dispatch sites with a cache (-I)
+
+// with -fprofile-generate and -fprofile-use, the counters numbered so
+// far and the counts read from the profile; code the profile says
+// rarely runs goes after its method, and methods that never ran after
+// all the others
+static thread_local int profile_counters = 0;
+static std::vector<int> profile;
+static thread_local AsmStream cold_code;
+static thread_local AsmStream cold_methods;
+
+// with -G, the return label and frame map of each call that may
+// collect, the distinct frame maps, and the calls of the current method
+static thread_local std::vector<std::pair<int, int> > stack_maps;
+static thread_local std::vector<std::vector<int> > frame_maps;
+static thread_local std::map<std::vector<int>, int> frame_map_index;
+static thread_local std::vector<std::pair<int, int> > method_calls;
+
+// with -O, evaluations whose value is kept in a temporary for reuse,
+// and the evaluations replaced by a load of it
+static thread_local std::map<Expression, int> value_slot;
+static thread_local std::map<Expression, int> reused_slot;
+// loop-invariant evaluations, kept the first time round their loop,
+// and the temporaries each loop clears on entry
+static thread_local std::map<Expression, int> invariant_slot;
+static thread_local std::map<Expression, int> invariant_label;
+static thread_local std::map<Expression, std::vector<int> > loop_slots;
+static thread_local int value_slots;       // temporaries used by all of these
+static thread_local int value_base;        // temporary of the first kept value
+
+//
+// Values available at a point of a method body during value numbering:
+// pure arithmetic already evaluated on every path to that point, keyed
+// by its form, with the variables it reads.
+//
+struct AvailValue {
+  Expression def;
+  std::vector<Symbol> vars;
+};
+
+// what the predicate and body of a loop may change
+struct LoopKills {
+  Expression loop;
+  std::vector<Symbol> vars;         // variables assigned or rebound
+  bool calls;                       // runs code that may assign attributes
+  LoopKills(Expression l) : loop(l), calls(false) { }
+};
+
+class ValueNumbering {
+  std::map<std::string, AvailValue> avail;
+  std::map<Symbol, int> locals;     // formals, let and case variables
+public:
+  bool dry;                         // only learning what a loop kills
+  LoopKills *kills;                 // where a dry walk records kills
+
+  ValueNumbering() : dry(false), kills(NULL) { }
+  bool reuse(Expression e);
+  bool invariant(Expression e);
+  void add(Expression e);
+  void kill(Symbol name);
+  void killAttrs();
+  void bind(Symbol name) { kill(name); locals[name]++; }
+  void unbind(Symbol name) { kill(name); locals[name]--; }
+  void meet(const ValueNumbering &other);
+};
+
+static int number_values(Expression body, Formals formals);
+
+#define LEAF_TEMPS 6
+static char *leaf_temp_regs[LEAF_TEMPS] =
+  { "$t3", "$t4", "$t5", "$t6", "$t7", "$t8" };
+
+#define REG_ARGS 3
+static char *arg_regs[REG_ARGS] = { A1, A2, A3 };
+
 //*********************************************************
 //
 // Define method for code generation
@@ -131,13 +243,32 @@ BoolConst truebool(TRUE);
 
 void program_class::cgen(ostream &os) 
 {
+  initialize_constants();
+  if (cgen_target == TARGET_C) {
+    CClassTable(classes,os).code();
+    return;
+  }
+  if (cgen_target == TARGET_BYTECODE) {
+    BytecodeClassTable(classes,os).code();
+    return;
+  }
+
+  // the assembly is collected in one buffer and written out at the end,
+  // except with -c, whose trace on cout goes between the lines of code
+  AsmBuffer buf(1 << 20);
+  ostream out(&buf);
+  ostream &s = cgen_debug ? os : out;
+
   // spim wants comments to start with '#'
-  os << "# start of generated code\n";
+  s << "# start of generated code\n";
 
-  initialize_constants();
-  CgenClassTable *codegen_classtable = new CgenClassTable(classes,os);
+  CgenClassTableP table = cgen_target == TARGET_X86_64 ?
+    new X86ClassTable(classes,s) : new CgenClassTable(classes,s);
+  table->code();
 
-  os << "\n# end of generated code\n";
+  s << "\n# end of generated code\n";
+  if (!cgen_debug)
+    buf.write_to(os);
 }
 
 
@@ -155,163 +286,183 @@ void program_class::cgen(ostream &os)
 //
 //////////////////////////////////////////////////////////////////////////////
 
-static void emit_load(char *dest_reg, int offset, char *source_reg, ostream& s)
+//
+// Every instruction goes through emit_insn: it is appended to the
+// AsmBuffer behind s, or written out as text if s has none.
+//
+static void emit_insn(AsmOp op, char *r1, char *r2, char *r3, int imm, int label,
+                      ostream &s)
 {
-  s << LW << dest_reg << " " << offset * WORD_SIZE << "(" << source_reg << ")" 
-    << endl;
+  AsmInsn in = { (unsigned char) op,
+                 (unsigned char) (r1 ? asm_reg(r1) : 0),
+                 (unsigned char) (r2 ? asm_reg(r2) : 0),
+                 (unsigned char) (r3 ? asm_reg(r3) : 0),
+                 imm, label };
+  AsmBuffer *buf = dynamic_cast<AsmBuffer*>(s.rdbuf());
+  if (buf)
+    buf->append(in);
+  else
+    AsmWriter(s).insn(in);
+}
+
+// what code collected in from is appended to s
+static void emit_code(AsmStream &from, ostream &s)
+{
+  AsmBuffer *buf = dynamic_cast<AsmBuffer*>(s.rdbuf());
+  if (buf)
+    buf->append(from.buffer());
+  else
+    from.buffer().write_to(s);
 }
 
-static void emit_store(char *source_reg, int offset, char *dest_reg, ostream& s)
+static int local_label(int l)
+{ return ASM_LABEL_ID(LABEL_LOCAL, l); }
+
+static int name_label(char *name)
+{ return ASM_LABEL_ID(LABEL_NAME, asm_name(name)); }
+
+// Class_dispTab, Class_init, Class_protObj and Class.method
+static int disptable_label(Symbol sym)
+{ return ASM_LABEL_ID(LABEL_NAME, asm_symbol(sym, DISPTAB_SUFFIX)); }
+
+static int init_label(Symbol sym)
+{ return ASM_LABEL_ID(LABEL_NAME, asm_symbol(sym, CLASSINIT_SUFFIX)); }
+
+static int protobj_label(Symbol sym)
+{ return ASM_LABEL_ID(LABEL_NAME, asm_symbol(sym, PROTOBJ_SUFFIX)); }
+
+static int method_label(Symbol classname, Symbol methodname)
 {
-  s << SW << source_reg << " " << offset * WORD_SIZE << "(" << dest_reg << ")"
-      << endl;
+  return ASM_LABEL_ID(LABEL_NAME, asm_symbol(classname, METHOD_SEP, methodname));
 }
 
+static void emit_load(char *dest_reg, int offset, char *source_reg, ostream& s)
+{ emit_insn(ASM_LW, dest_reg, source_reg, NULL, offset * WORD_SIZE, 0, s); }
+
+static void emit_store(char *source_reg, int offset, char *dest_reg, ostream& s)
+{ emit_insn(ASM_SW, source_reg, dest_reg, NULL, offset * WORD_SIZE, 0, s); }
+
 static void emit_load_imm(char *dest_reg, int val, ostream& s)
-{ s << LI << dest_reg << " " << val << endl; }
+{ emit_insn(ASM_LI, dest_reg, NULL, NULL, val, 0, s); }
 
 static void emit_load_address(char *dest_reg, char *address, ostream& s)
-{ s << LA << dest_reg << " " << address << endl; }
+{ emit_insn(ASM_LA, dest_reg, NULL, NULL, 0, name_label(address), s); }
 
-static void emit_partial_load_address(char *dest_reg, ostream& s)
-{ s << LA << dest_reg << " "; }
+static void emit_load_label(char *dest_reg, int label, ostream& s)
+{ emit_insn(ASM_LA, dest_reg, NULL, NULL, 0, label, s); }
 
 static void emit_load_bool(char *dest, const BoolConst& b, ostream& s)
-{
-  emit_partial_load_address(dest,s);
-  b.code_ref(s);
-  s << endl;
-}
+{ emit_insn(ASM_LA, dest, NULL, NULL, 0, b.code_label(), s); }
 
 static void emit_load_string(char *dest, StringEntry *str, ostream& s)
-{
-  emit_partial_load_address(dest,s);
-  str->code_ref(s);
-  s << endl;
-}
+{ emit_insn(ASM_LA, dest, NULL, NULL, 0, str->code_label(), s); }
 
 static void emit_load_int(char *dest, IntEntry *i, ostream& s)
-{
-  emit_partial_load_address(dest,s);
-  i->code_ref(s);
-  s << endl;
-}
+{ emit_insn(ASM_LA, dest, NULL, NULL, 0, i->code_label(), s); }
 
 static void emit_move(char *dest_reg, char *source_reg, ostream& s)
-{ s << MOVE << dest_reg << " " << source_reg << endl; }
+{ emit_insn(ASM_MOVE, dest_reg, source_reg, NULL, 0, 0, s); }
 
 static void emit_neg(char *dest, char *src1, ostream& s)
-{ s << NEG << dest << " " << src1 << endl; }
+{ emit_insn(ASM_NEG, dest, src1, NULL, 0, 0, s); }
 
 static void emit_add(char *dest, char *src1, char *src2, ostream& s)
-{ s << ADD << dest << " " << src1 << " " << src2 << endl; }
+{ emit_insn(ASM_ADD, dest, src1, src2, 0, 0, s); }
 
 static void emit_addu(char *dest, char *src1, char *src2, ostream& s)
-{ s << ADDU << dest << " " << src1 << " " << src2 << endl; }
+{ emit_insn(ASM_ADDU, dest, src1, src2, 0, 0, s); }
+
+static void emit_addi(char *dest, char *src1, int imm, ostream& s)
+{ emit_insn(ASM_ADDI, dest, src1, NULL, imm, 0, s); }
 
 static void emit_addiu(char *dest, char *src1, int imm, ostream& s)
-{ s << ADDIU << dest << " " << src1 << " " << imm << endl; }
+{ emit_insn(ASM_ADDIU, dest, src1, NULL, imm, 0, s); }
 
 static void emit_div(char *dest, char *src1, char *src2, ostream& s)
-{ s << DIV << dest << " " << src1 << " " << src2 << endl; }
+{ emit_insn(ASM_DIV, dest, src1, src2, 0, 0, s); }
 
 static void emit_mul(char *dest, char *src1, char *src2, ostream& s)
-{ s << MUL << dest << " " << src1 << " " << src2 << endl; }
+{ emit_insn(ASM_MUL, dest, src1, src2, 0, 0, s); }
 
 static void emit_sub(char *dest, char *src1, char *src2, ostream& s)
-{ s << SUB << dest << " " << src1 << " " << src2 << endl; }
+{ emit_insn(ASM_SUB, dest, src1, src2, 0, 0, s); }
 
 static void emit_sll(char *dest, char *src1, int num, ostream& s)
-{ s << SLL << dest << " " << src1 << " " << num << endl; }
+{ emit_insn(ASM_SLL, dest, src1, NULL, num, 0, s); }
+
+static void emit_srl(char *dest, char *src1, int num, ostream& s)
+{ emit_insn(ASM_SRL, dest, src1, NULL, num, 0, s); }
+
+static void emit_sra(char *dest, char *src1, int num, ostream& s)
+{ emit_insn(ASM_SRA, dest, src1, NULL, num, 0, s); }
+
+static void emit_sltiu(char *dest, char *src1, int imm, ostream& s)
+{ emit_insn(ASM_SLTIU, dest, src1, NULL, imm, 0, s); }
 
 static void emit_jalr(char *dest, ostream& s)
-{ s << JALR << "\t" << dest << endl; }
+{ emit_insn(ASM_JALR, dest, NULL, NULL, 0, 0, s); }
 
 static void emit_jal(char *address,ostream &s)
-{ s << JAL << address << endl; }
+{ emit_insn(ASM_JAL, NULL, NULL, NULL, 0, name_label(address), s); }
 
 static void emit_return(ostream& s)
-{ s << RET << endl; }
+{ emit_insn(ASM_RET, NULL, NULL, NULL, 0, 0, s); }
+
+static void emit_gc_point(ostream &s);
 
 static void emit_gc_assign(ostream& s)
-{ s << JAL << "_GenGC_Assign" << endl; }
+{ emit_jal("_GenGC_Assign", s); emit_gc_point(s); }
 
 static void emit_disptable_ref(Symbol sym, ostream& s)
-{  s << sym << DISPTAB_SUFFIX; }
+{ AsmWriter(s).label(disptable_label(sym)); }
 
 static void emit_init_ref(Symbol sym, ostream& s)
-{ s << sym << CLASSINIT_SUFFIX; }
+{ AsmWriter(s).label(init_label(sym)); }
 
 static void emit_label_ref(int l, ostream &s)
-{ s << "label" << l; }
+{ AsmWriter(s).label(local_label(l)); }
 
 static void emit_protobj_ref(Symbol sym, ostream& s)
-{ s << sym << PROTOBJ_SUFFIX; }
+{ AsmWriter(s).label(protobj_label(sym)); }
 
 static void emit_method_ref(Symbol classname, Symbol methodname, ostream& s)
-{ s << classname << METHOD_SEP << methodname; }
+{ AsmWriter(s).label(method_label(classname, methodname)); }
 
 static void emit_label_def(int l, ostream &s)
-{
-  emit_label_ref(l,s);
-  s << ":" << endl;
-}
+{ emit_insn(ASM_LABEL, NULL, NULL, NULL, 0, local_label(l), s); }
+
+static void emit_name_def(int label, ostream &s)
+{ emit_insn(ASM_LABEL, NULL, NULL, NULL, 0, label, s); }
+
+static void emit_call(int label, ostream &s)
+{ emit_insn(ASM_JAL, NULL, NULL, NULL, 0, label, s); }
 
 static void emit_beqz(char *source, int label, ostream &s)
-{
-  s << BEQZ << source << " ";
-  emit_label_ref(label,s);
-  s << endl;
-}
+{ emit_insn(ASM_BEQZ, source, NULL, NULL, 0, local_label(label), s); }
 
 static void emit_beq(char *src1, char *src2, int label, ostream &s)
-{
-  s << BEQ << src1 << " " << src2 << " ";
-  emit_label_ref(label,s);
-  s << endl;
-}
+{ emit_insn(ASM_BEQ, src1, src2, NULL, 0, local_label(label), s); }
 
 static void emit_bne(char *src1, char *src2, int label, ostream &s)
-{
-  s << BNE << src1 << " " << src2 << " ";
-  emit_label_ref(label,s);
-  s << endl;
-}
+{ emit_insn(ASM_BNE, src1, src2, NULL, 0, local_label(label), s); }
 
 static void emit_bleq(char *src1, char *src2, int label, ostream &s)
-{
-  s << BLEQ << src1 << " " << src2 << " ";
-  emit_label_ref(label,s);
-  s << endl;
-}
+{ emit_insn(ASM_BLE, src1, src2, NULL, 0, local_label(label), s); }
 
 static void emit_blt(char *src1, char *src2, int label, ostream &s)
-{
-  s << BLT << src1 << " " << src2 << " ";
-  emit_label_ref(label,s);
-  s << endl;
-}
+{ emit_insn(ASM_BLT, src1, src2, NULL, 0, local_label(label), s); }
 
 static void emit_blti(char *src1, int imm, int label, ostream &s)
-{
-  s << BLT << src1 << " " << imm << " ";
-  emit_label_ref(label,s);
-  s << endl;
-}
+{ emit_insn(ASM_BLTI, src1, NULL, NULL, imm, local_label(label), s); }
+
+static void emit_bnei(char *src1, int imm, int label, ostream &s)
+{ emit_insn(ASM_BNEI, src1, NULL, NULL, imm, local_label(label), s); }
 
 static void emit_bgti(char *src1, int imm, int label, ostream &s)
-{
-  s << BGT << src1 << " " << imm << " ";
-  emit_label_ref(label,s);
-  s << endl;
-}
+{ emit_insn(ASM_BGTI, src1, NULL, NULL, imm, local_label(label), s); }
 
 static void emit_branch(int l, ostream& s)
-{
-  s << BRANCH;
-  emit_label_ref(l,s);
-  s << endl;
-}
+{ emit_insn(ASM_B, NULL, NULL, NULL, 0, local_label(l), s); }
 
 //
 // Push a register on the stack. The stack grows towards smaller addresses.
@@ -343,7 +494,7 @@ static void emit_test_collector(ostream &s)
   emit_push(ACC, s);
   emit_move(ACC, SP, s); // stack end
   emit_move(A1, ZERO, s); // allocate nothing
-  s << JAL << gc_collect_names[cgen_Memmgr] << endl;
+  emit_jal(gc_collect_names[cgen_Memmgr], s);
   emit_addiu(SP,SP,4,s);
   emit_load(ACC,0,SP,s);
 }
@@ -351,7 +502,332 @@ static void emit_test_collector(ostream &s)
 static void emit_gc_check(char *source, ostream &s)
 {
   if (source != (char*)A1) emit_move(A1, source, s);
-  s << JAL << "_gc_check" << endl;
+  emit_jal("_gc_check", s);
+}
+
+//
+// Temporaries of the current method.
+//
+static void emit_temp_store(char *source, int t, ostream &s)
+{
+  if (leaf_method)
+    emit_move(leaf_temp_regs[t], source, s);
+  else
+    emit_store(source, t, FP, s);
+}
+
+static void emit_temp_load(char *dest, int t, ostream &s)
+{
+  if (leaf_method)
+    emit_move(dest, leaf_temp_regs[t], s);
+  else
+    emit_load(dest, t, FP, s);
+}
+
+//
+// Stack formal i of n is pushed i-th by the caller, so the last one
+// is nearest to the callee's frame.
+//
+static int formal_offset(int i)
+{
+  if (leaf_method)
+    return curr_formals - i;
+  return curr_temps + 3 + (curr_formals - 1 - i);
+}
+
+static char *formal_base()
+{
+  return leaf_method ? (char *) SP : (char *) FP;
+}
+
+static void emit_var_load(char *dest, VarLoc *loc, ostream &s)
+{
+  loc->used = true;
+  switch (loc->kind) {
+  case VarAttr:
+    emit_load(dest, DEFAULT_OBJFIELDS + loc->index, self_reg, s);
+    break;
+  case VarFormal:
+    emit_load(dest, formal_offset(loc->index), formal_base(), s);
+    break;
+  case VarTemp:
+    emit_temp_load(dest, loc->index, s);
+    break;
+  case VarArgReg:
+    emit_move(dest, arg_regs[loc->index], s);
+    break;
+  }
+}
+
+//
+// An attribute store tells the generational collector about the
+// assignment unless barrier is false (see needs_barrier).
+//
+static void emit_var_store(char *source, VarLoc *loc, ostream &s,
+                           bool barrier = true)
+{
+  loc->used = true;
+  switch (loc->kind) {
+  case VarAttr:
+    emit_store(source, DEFAULT_OBJFIELDS + loc->index, self_reg, s);
+    if (cgen_Memmgr != GC_NOGC && barrier) {
+      emit_addiu(A1, self_reg, (DEFAULT_OBJFIELDS + loc->index) * WORD_SIZE, s);
+      emit_gc_assign(s);
+      gc_barriers++;
+    } else if (cgen_Memmgr != GC_NOGC)
+      gc_barriers_elided++;
+    break;
+  case VarFormal:
+    emit_store(source, formal_offset(loc->index), formal_base(), s);
+    break;
+  case VarTemp:
+    emit_temp_store(source, loc->index, s);
+    break;
+  case VarArgReg:
+    emit_move(arg_regs[loc->index], source, s);
+    break;
+  }
+}
+
+//
+// The write barrier records stores that may make an old object point
+// into the young generation.  With -O it is left out when the stored
+// value is not in the heap at all -- a constant, or the Bool constant
+// a comparison, not or isvoid leaves -- and in an initializer while
+// self is still young: nothing since Object.copy made it may have
+// collected, so the collector has not yet moved it to the old area.
+//
+static bool is_static_value(Expression e)
+{
+  return dynamic_cast<int_const_class*>(e) != NULL ||
+         dynamic_cast<string_const_class*>(e) != NULL ||
+         dynamic_cast<bool_const_class*>(e) != NULL ||
+         dynamic_cast<lt_class*>(e) != NULL ||
+         dynamic_cast<leq_class*>(e) != NULL ||
+         dynamic_cast<eq_class*>(e) != NULL ||
+         dynamic_cast<comp_class*>(e) != NULL ||
+         dynamic_cast<isvoid_class*>(e) != NULL;
+}
+
+static bool needs_barrier(Expression e, bool young)
+{
+  return cgen_Memmgr != GC_NOGC && !(cgen_optimize && (young || is_static_value(e)));
+}
+
+//
+// A method may run without a frame if nothing in its body returns to
+// it through $ra and its temporaries fit in registers.  The abort
+// routines of the runtime never return, so they do not count as calls.
+//
+static bool is_leaf(int temps, bool calls)
+{
+  return cgen_optimize && !calls && temps <= LEAF_TEMPS;
+}
+
+//
+// Number of the nargs arguments of a call to method name of class nd
+// that are passed in $a1-$a3 (with -freg-args).  Methods of the basic
+// classes are implemented in the runtime system, so they and every
+// method overriding them keep the stack convention.
+//
+static int reg_args(CgenNodeP nd, Symbol name, int nargs)
+{
+  if (!cgen_reg_args)
+    return 0;
+  while (!nd->basic())
+    nd = nd->get_parentnd();
+  if (nd->methodOffset(name) >= 0)
+    return 0;
+  return std::min(nargs, REG_ARGS);
+}
+
+//
+// Method entry and exit.  The frame is
+//
+//      old $fp         <- $sp on entry
+//      self ($s0)
+//      $ra
+//      spilled register argument r-1
+//      ...
+//      spilled register argument 0
+//      temporary n-1
+//      ...
+//      temporary 0     <- $fp
+//
+// and the callee pops its stack arguments on return.  Register
+// arguments get a slot since any call clobbers them (see
+// CgenNode::code_methods); a leaf method reads them from $a1-$a3.
+//
+static void emit_method_entry(int temps, int formals, int reg_formals, bool leaf,
+                              ostream &s)
+{
+  curr_temps = leaf ? temps : temps + reg_formals;
+  curr_formals = formals;
+  next_temp = 0;
+  leaf_method = leaf;
+
+  if (leaf) {
+    self_reg = T0;
+    emit_move(T0, ACC, s);
+    return;
+  }
+
+  self_reg = SELF;
+  emit_addiu(SP, SP, -WORD_SIZE * (curr_temps + 3), s);
+  emit_store(FP, curr_temps + 3, SP, s);
+  emit_store(SELF, curr_temps + 2, SP, s);
+  emit_store(RA, curr_temps + 1, SP, s);
+  emit_addiu(FP, SP, WORD_SIZE, s);
+  emit_move(SELF, ACC, s);
+
+  // the collector scans the stack, so stale words must not look live;
+  // with stack maps only the kept values are live before being written
+  if (cgen_Memmgr != GC_NOGC)
+    for (int i = cgen_Memmgr == GC_PRECISE ? value_base : 0; i < temps; i++)
+      emit_store(ZERO, i, FP, s);
+}
+
+static void emit_method_exit(ostream &s)
+{
+  if (leaf_method) {
+    if (curr_formals > 0)
+      emit_addiu(SP, SP, WORD_SIZE * curr_formals, s);
+    emit_return(s);
+    return;
+  }
+
+  emit_load(FP, curr_temps + 3, SP, s);
+  emit_load(SELF, curr_temps + 2, SP, s);
+  emit_load(RA, curr_temps + 1, SP, s);
+  emit_addiu(SP, SP, WORD_SIZE * (curr_temps + 3 + curr_formals), s);
+  emit_return(s);
+}
+
+//
+// With -G the collector finds the roots in a frame from the stack map
+// of the call the frame is waiting on, looked up by its return address.
+// The map gives the number of temporaries and stack formals and which
+// temporaries hold objects: those in use at the call -- let and case
+// bindings, operands and arguments held across it -- and, throughout
+// the method, the kept values and the spilled register arguments.
+// Saved self and the stack formals are always live.
+//
+static void emit_gc_point(ostream &s)
+{
+  if (cgen_Memmgr != GC_PRECISE)
+    return;
+  int l = next_label++;
+  emit_label_def(l, s);
+  method_calls.push_back(std::make_pair(l, next_temp));
+}
+
+// the number of a frame map, the first time it is seen the next one
+static int frame_map_number(const std::vector<int> &map)
+{
+  std::map<std::vector<int>, int>::iterator f = frame_map_index.find(map);
+  if (f == frame_map_index.end()) {
+    f = frame_map_index.insert(
+          std::make_pair(map, (int) frame_maps.size())).first;
+    frame_maps.push_back(map);
+  }
+  return f->second;
+}
+
+//
+// Make the stack maps of the calls of a method once its code is
+// complete; live marks the temporaries live at every call.
+//
+static void end_stack_maps(const std::vector<bool> &live)
+{
+  for (size_t k = 0; k < method_calls.size(); k++) {
+    std::vector<int> map(2 + (curr_temps + 31) / 32, 0);
+    map[0] = curr_temps;
+    map[1] = curr_formals;
+    for (int i = 0; i < curr_temps; i++)
+      if (i < method_calls[k].second || live[i])
+        map[2 + i / 32] |= (int) (1u << (i % 32));
+    stack_maps.push_back(std::make_pair(method_calls[k].first,
+                                        frame_map_number(map)));
+  }
+  method_calls.clear();
+}
+
+//
+// Profiles.  Every method, dynamic dispatch, conditional and loop gets
+// counters, numbered in the order the code is generated, so a program
+// compiled again with the same flags numbers them the same way.  With
+// -fprofile-generate the code counts method entries, the receiver
+// classes of each dispatch, the arms taken by each conditional, and
+// the iterations and exits of each loop.
+//
+static int new_counters(int n)
+{
+  int c = profile_counters;
+  profile_counters += n;
+  return c;
+}
+
+static int profile_count(int c)
+{
+  return c < (int) profile.size() ? profile[c] : 0;
+}
+
+// n is less than a sixteenth of m in the profile
+static bool rarely(int n, int m)
+{
+  return !profile.empty() && n * 16LL < m;
+}
+
+static void emit_count(int c, ostream &s)
+{
+  if (!cgen_profile_generate)
+    return;
+  emit_load_address(T1, PROFILE_COUNTERS, s);
+  emit_load(T2, c, T1, s);
+  emit_addiu(T2, T2, 1, s);
+  emit_store(T2, c, T1, s);
+}
+
+static void flush_cold_code(ostream &s)
+{
+  emit_code(cold_code, s);
+  cold_code.buffer().clear();
+}
+
+//
+// The profile is the output of a run of the program compiled with
+// -fprofile-generate: what the program printed, then PROFILE_MARK, the
+// number of counters and the counts.
+//
+static void read_profile(char *filename)
+{
+  std::ifstream in(filename);
+  std::string word;
+  while (in >> word && word != PROFILE_MARK)
+    ;
+  int n = 0;
+  if (!(in >> n) || n < 0) {
+    cerr << "warning: no profile in " << filename << endl;
+    return;
+  }
+  profile.resize(n);
+  for (int i = 0; i < n; i++)
+    if (!(in >> profile[i])) {
+      cerr << "warning: truncated profile in " << filename << endl;
+      profile.clear();
+      return;
+    }
+}
+
+//
+// Code to abort with the file name and line number of an expression.
+//
+static void emit_abort(char *routine, int line, ostream &s)
+{
+  emit_load_string(ACC,
+      stringtable.lookup_string(curr_class->get_filename()->get_string()), s);
+  emit_load_imm(T1, line, s);
+  emit_jal(routine, s);
 }
 
 
@@ -384,6 +860,11 @@ void StringEntry::code_ref(ostream& s)
   s << STRCONST_PREFIX << index;
 }
 
+int StringEntry::code_label() const
+{
+  return ASM_LABEL_ID(LABEL_STR_CONST, index);
+}
+
 //
 // Emit code for a constant String.
 // You should fill in the code naming the dispatch table.
@@ -394,18 +875,18 @@ void StringEntry::code_def(ostream& s, int stringclasstag)
   IntEntryP lensym = inttable.add_int(len);
 
   // Add -1 eye catcher
-  s << WORD << "-1" << endl;
+  s << WORD << "-1\n";
 
   code_ref(s);  s  << LABEL                                             // label
-      << WORD << stringclasstag << endl                                 // tag
-      << WORD << (DEFAULT_OBJFIELDS + STRING_SLOTS + (len+4)/4) << endl // size
+      << WORD << stringclasstag << "\n"                                 // tag
+      << WORD << (DEFAULT_OBJFIELDS + STRING_SLOTS + (len+4)/4) << "\n" // size
       << WORD;
 
 
  /***** Add dispatch information for class String ******/
 
-      s << endl;                                              // dispatch table
-      s << WORD;  lensym->code_ref(s);  s << endl;            // string length
+      emit_disptable_ref(Str, s);  s << "\n";                 // dispatch table
+      s << WORD;  lensym->code_ref(s);  s << "\n";            // string length
   emit_string_constant(s,str);                                // ascii string
   s << ALIGN;                                                 // align to word
 }
@@ -429,6 +910,11 @@ void IntEntry::code_ref(ostream &s)
   s << INTCONST_PREFIX << index;
 }
 
+int IntEntry::code_label() const
+{
+  return ASM_LABEL_ID(LABEL_INT_CONST, index);
+}
+
 //
 // Emit code for a constant Integer.
 // You should fill in the code naming the dispatch table.
@@ -437,17 +923,17 @@ void IntEntry::code_ref(ostream &s)
 void IntEntry::code_def(ostream &s, int intclasstag)
 {
   // Add -1 eye catcher
-  s << WORD << "-1" << endl;
+  s << WORD << "-1\n";
 
   code_ref(s);  s << LABEL                                // label
-      << WORD << intclasstag << endl                      // class tag
-      << WORD << (DEFAULT_OBJFIELDS + INT_SLOTS) << endl  // object size
+      << WORD << intclasstag << "\n"                      // class tag
+      << WORD << (DEFAULT_OBJFIELDS + INT_SLOTS) << "\n"  // object size
       << WORD; 
 
  /***** Add dispatch information for class Int ******/
 
-      s << endl;                                          // dispatch table
-      s << WORD << str << endl;                           // integer value
+      emit_disptable_ref(Int, s);  s << "\n";             // dispatch table
+      s << WORD << str << "\n";                           // integer value
 }
 
 
@@ -472,6 +958,11 @@ void BoolConst::code_ref(ostream& s) const
 {
   s << BOOLCONST_PREFIX << val;
 }
+
+int BoolConst::code_label() const
+{
+  return ASM_LABEL_ID(LABEL_BOOL_CONST, val);
+}
   
 //
 // Emit code for a constant Bool.
@@ -481,17 +972,17 @@ void BoolConst::code_ref(ostream& s) const
 void BoolConst::code_def(ostream& s, int boolclasstag)
 {
   // Add -1 eye catcher
-  s << WORD << "-1" << endl;
+  s << WORD << "-1\n";
 
   code_ref(s);  s << LABEL                                  // label
-      << WORD << boolclasstag << endl                       // class tag
-      << WORD << (DEFAULT_OBJFIELDS + BOOL_SLOTS) << endl   // object size
+      << WORD << boolclasstag << "\n"                       // class tag
+      << WORD << (DEFAULT_OBJFIELDS + BOOL_SLOTS) << "\n"   // object size
       << WORD;
 
  /***** Add dispatch information for class Bool ******/
 
-      s << endl;                                            // dispatch table
-      s << WORD << val << endl;                             // value (0 or 1)
+      emit_disptable_ref(Bool, s);  s << "\n";              // dispatch table
+      s << WORD << val << "\n";                             // value (0 or 1)
 }
 
 //////////////////////////////////////////////////////////////////////////////
@@ -518,26 +1009,26 @@ void CgenClassTable::code_global_data()
   //
   // The following global names must be defined first.
   //
-  str << GLOBAL << CLASSNAMETAB << endl;
-  str << GLOBAL; emit_protobj_ref(main,str);    str << endl;
-  str << GLOBAL; emit_protobj_ref(integer,str); str << endl;
-  str << GLOBAL; emit_protobj_ref(string,str);  str << endl;
-  str << GLOBAL; falsebool.code_ref(str);  str << endl;
-  str << GLOBAL; truebool.code_ref(str);   str << endl;
-  str << GLOBAL << INTTAG << endl;
-  str << GLOBAL << BOOLTAG << endl;
-  str << GLOBAL << STRINGTAG << endl;
+  str << GLOBAL << CLASSNAMETAB << "\n";
+  str << GLOBAL; emit_protobj_ref(main,str);    str << "\n";
+  str << GLOBAL; emit_protobj_ref(integer,str); str << "\n";
+  str << GLOBAL; emit_protobj_ref(string,str);  str << "\n";
+  str << GLOBAL; falsebool.code_ref(str);  str << "\n";
+  str << GLOBAL; truebool.code_ref(str);   str << "\n";
+  str << GLOBAL << INTTAG << "\n";
+  str << GLOBAL << BOOLTAG << "\n";
+  str << GLOBAL << STRINGTAG << "\n";
 
   //
   // We also need to know the tag of the Int, String, and Bool classes
   // during code generation.
   //
   str << INTTAG << LABEL
-      << WORD << intclasstag << endl;
+      << WORD << intclasstag << "\n";
   str << BOOLTAG << LABEL 
-      << WORD << boolclasstag << endl;
+      << WORD << boolclasstag << "\n";
   str << STRINGTAG << LABEL 
-      << WORD << stringclasstag << endl;    
+      << WORD << stringclasstag << "\n";    
 }
 
 
@@ -550,21 +1041,133 @@ void CgenClassTable::code_global_data()
 
 void CgenClassTable::code_global_text()
 {
-  str << GLOBAL << HEAP_START << endl
+  str << GLOBAL << HEAP_START << "\n"
       << HEAP_START << LABEL 
-      << WORD << 0 << endl
-      << "\t.text" << endl
+      << WORD << 0 << "\n"
+      << "\t.text\n"
       << GLOBAL;
   emit_init_ref(idtable.add_string("Main"), str);
-  str << endl << GLOBAL;
+  str << "\n" << GLOBAL;
   emit_init_ref(idtable.add_string("Int"),str);
-  str << endl << GLOBAL;
+  str << "\n" << GLOBAL;
   emit_init_ref(idtable.add_string("String"),str);
-  str << endl << GLOBAL;
+  str << "\n" << GLOBAL;
   emit_init_ref(idtable.add_string("Bool"),str);
-  str << endl << GLOBAL;
+  str << "\n" << GLOBAL;
   emit_method_ref(idtable.add_string("Main"), idtable.add_string("main"), str);
-  str << endl;
+  str << "\n";
+
+  if (cgen_Memmgr == GC_PRECISE) {
+    str << gc_init_names[cgen_Memmgr] << LABEL;
+    emit_load_address(A3, STACKMAPTAB, str);
+    str << JUMP << "_GenGC_InitMaps\n";
+  }
+
+  if (cgen_profile_generate)
+    code_profile_dump();
+}
+
+//
+// With -fprofile-generate the memory manager's initializer is a stub
+// that first makes the runtime run PROFILE_DUMP at exit.  PROFILE_DUMP
+// prints PROFILE_MARK, the number of counters and the counters, one
+// per line, after the program's output.
+//
+void CgenClassTable::code_profile_dump()
+{
+  str << PROFILE_INIT << LABEL;
+  emit_load_address(T0, PROFILE_DUMP, str);
+  emit_load_address(T1, EXIT_HOOK, str);
+  emit_store(T0, 0, T1, str);
+  str << JUMP << gc_init_names[cgen_Memmgr] << "\n";
+
+  int loop = next_label++;
+  int done = next_label++;
+  str << PROFILE_DUMP << LABEL;
+  emit_load_address(ACC, PROFILE_MSG, str);
+  emit_load_imm("$v0", 4, str);
+  str << SYSCALL;
+  emit_load_imm(ACC, profile_counters, str);
+  emit_load_imm("$v0", 1, str);
+  str << SYSCALL;
+  emit_load_address(T1, PROFILE_COUNTERS, str);
+  emit_load_imm(T2, profile_counters * WORD_SIZE, str);
+  emit_addu(T2, T1, T2, str);
+  emit_label_def(loop, str);
+  emit_load_address(ACC, PROFILE_NL, str);
+  emit_load_imm("$v0", 4, str);
+  str << SYSCALL;
+  emit_beq(T1, T2, done, str);
+  emit_load(ACC, 0, T1, str);
+  emit_load_imm("$v0", 1, str);
+  str << SYSCALL;
+  emit_addiu(T1, T1, WORD_SIZE, str);
+  emit_branch(loop, str);
+  emit_label_def(done, str);
+  emit_return(str);
+}
+
+void CgenClassTable::code_profile_counters()
+{
+  str << PROFILE_MSG << LABEL
+      << "\t.asciiz\t\"\\n" << PROFILE_MARK << " \"\n"
+      << PROFILE_NL << LABEL
+      << "\t.asciiz\t\"\\n\"\n"
+      << ALIGN
+      << PROFILE_COUNTERS << LABEL
+      << "\t.space\t" << profile_counters * WORD_SIZE << "\n";
+}
+
+//
+// Orders stack maps by where their return label is defined in the code.
+//
+struct ByPosition {
+  std::map<int, int> *line;
+  bool operator()(const std::pair<int, int> &a,
+                  const std::pair<int, int> &b) const
+  { return (*line)[a.first] < (*line)[b.first]; }
+};
+
+//
+// The stack maps, sorted by return address as the code is laid out:
+// their number, then (return address, frame map) pairs.  A frame map
+// holds the number of temporaries, the number of stack formals, and a
+// bitmap of the live temporaries.  Code a profile finds cold is laid
+// out after the rest, so the maps are sorted by the position of their
+// labels in text.
+//
+void CgenClassTable::code_stack_maps(AsmBuffer &text)
+{
+  std::map<int, int> line;
+  const std::vector<AsmInsn> &insns = text.insns();
+  for (size_t n = 0; n < insns.size(); n++)
+    if (insns[n].op == ASM_LABEL && ASM_LABEL_KIND(insns[n].label) == LABEL_LOCAL)
+      line[ASM_LABEL_NUM(insns[n].label)] = n;
+  ByPosition by_position = { &line };
+  std::stable_sort(stack_maps.begin(), stack_maps.end(), by_position);
+
+  str << STACKMAPTAB << LABEL
+      << WORD << stack_maps.size() << "\n";
+  for (size_t i = 0; i < stack_maps.size(); i++) {
+    str << WORD;  emit_label_ref(stack_maps[i].first, str);  str << "\n";
+    str << WORD << FRAMEMAP_PREFIX << stack_maps[i].second << "\n";
+  }
+  for (size_t i = 0; i < frame_maps.size(); i++) {
+    str << FRAMEMAP_PREFIX << i << LABEL;
+    for (size_t j = 0; j < frame_maps[i].size(); j++)
+      str << WORD << frame_maps[i][j] << "\n";
+  }
+}
+
+//
+// The inline caches start out empty: no dispatch table is at address 0.
+//
+void CgenClassTable::code_inline_caches()
+{
+  for (int i = 0; i < inline_caches; i++)
+    str << INLINECACHE_PREFIX << i << LABEL
+        << WORD << EMPTYSLOT << "\n"
+        << WORD << EMPTYSLOT << "\n";
 }
 
 void CgenClassTable::code_bools(int boolclasstag)
@@ -573,20 +1176,41 @@ void CgenClassTable::code_bools(int boolclasstag)
   truebool.code_def(str,boolclasstag);
 }
 
+//
+// With -O the Ints of the small-integer cache follow the constants,
+// one object per line, each preceded by its eyecatcher.  int_cache
+// labels the Int of the smallest value: -128 unless -fint-cache says
+// otherwise.  The default range, -128..1023, takes 23 KB.
+//
+void CgenClassTable::code_int_cache(int intclasstag)
+{
+  str << WORD << "-1\n";
+  str << INTCACHE << LABEL;
+  for (int i = cgen_int_cache_min; i <= cgen_int_cache_max; i++) {
+    if (i != cgen_int_cache_min)
+      str << WORD << "-1\n";
+    str << WORD << intclasstag << ", " << (DEFAULT_OBJFIELDS + INT_SLOTS)
+        << ", ";
+    emit_disptable_ref(Int, str);
+    str << ", " << i << "\n";
+  }
+}
+
 void CgenClassTable::code_select_gc()
 {
   //
   // Generate GC choice constants (pointers to GC functions)
   //
-  str << GLOBAL << "_MemMgr_INITIALIZER" << endl;
-  str << "_MemMgr_INITIALIZER:" << endl;
-  str << WORD << gc_init_names[cgen_Memmgr] << endl;
-  str << GLOBAL << "_MemMgr_COLLECTOR" << endl;
-  str << "_MemMgr_COLLECTOR:" << endl;
-  str << WORD << gc_collect_names[cgen_Memmgr] << endl;
-  str << GLOBAL << "_MemMgr_TEST" << endl;
-  str << "_MemMgr_TEST:" << endl;
-  str << WORD << (cgen_Memmgr_Test == GC_TEST) << endl;
+  str << GLOBAL << "_MemMgr_INITIALIZER\n";
+  str << "_MemMgr_INITIALIZER:\n";
+  str << WORD << (cgen_profile_generate ? PROFILE_INIT
+                                        : gc_init_names[cgen_Memmgr]) << "\n";
+  str << GLOBAL << "_MemMgr_COLLECTOR\n";
+  str << "_MemMgr_COLLECTOR:\n";
+  str << WORD << gc_collect_names[cgen_Memmgr] << "\n";
+  str << GLOBAL << "_MemMgr_TEST\n";
+  str << "_MemMgr_TEST:\n";
+  str << WORD << (cgen_Memmgr_Test == GC_TEST) << "\n";
 }
 
 
@@ -613,15 +1237,15 @@ void CgenClassTable::code_constants()
 
   stringtable.code_string_table(str,stringclasstag);
   inttable.code_string_table(str,intclasstag);
+  if (cgen_optimize)
+    code_int_cache(intclasstag);
   code_bools(boolclasstag);
 }
 
 
 CgenClassTable::CgenClassTable(Classes classes, ostream& s) : nds(NULL) , str(s)
 {
-   stringclasstag = 0 /* Change to your String class tag here */;
-   intclasstag =    0 /* Change to your Int class tag here */;
-   boolclasstag =   0 /* Change to your Bool class tag here */;
+   codegen_classtable = this;
 
    enterscope();
    if (cgen_debug) cout << "Building CgenClassTable" << endl;
@@ -629,8 +1253,20 @@ CgenClassTable::CgenClassTable(Classes classes, ostream& s) : nds(NULL) , str(s)
    install_classes(classes);
    build_inheritance_tree();
 
-   code();
-   exitscope();
+   int next_tag = 0;
+   root()->setTags(next_tag, tag_order);
+   if (cgen_optimize)
+     root()->countAttrUses();
+   root()->buildLayout();
+
+   if (cgen_optimize)
+     for (size_t i = 0; i < tag_order.size(); i++)
+       if (!tag_order[i]->basic())
+         tag_order[i]->simplify();
+
+   stringclasstag = probe(Str)->getTag();
+   intclasstag =    probe(Int)->getTag();
+   boolclasstag =   probe(Bool)->getTag();
 }
 
 void CgenClassTable::install_basic_classes()
@@ -817,121 +1453,1740 @@ void CgenNode::set_parentnd(CgenNodeP p)
 
 
 
-void CgenClassTable::code()
-{
-  if (cgen_debug) cout << "coding global data" << endl;
-  code_global_data();
-
-  if (cgen_debug) cout << "choosing gc" << endl;
-  code_select_gc();
-
-  if (cgen_debug) cout << "coding constants" << endl;
-  code_constants();
-
-//                 Add your code to emit
-//                   - prototype objects
-//                   - class_nameTab
-//                   - dispatch tables
 //
-
-  if (cgen_debug) cout << "coding global text" << endl;
-  code_global_text();
-
-//                 Add your code to emit
-//                   - object initializer
-//                   - the class methods
-//                   - etc...
-
+// CgenNode::setTags
+//
+// Classes are numbered in preorder, so the tags of a class and all of
+// its descendants form the range [tag, max_tag].
+//
+void CgenNode::setTags(int &next, std::vector<CgenNodeP> &order)
+{
+  tag = next++;
+  order.push_back(this);
+  for (List<CgenNode> *l = children; l; l = l->tl())
+    l->hd()->setTags(next, order);
+  max_tag = next - 1;
 }
 
-
-CgenNodeP CgenClassTable::root()
+void SlotTable::set(Symbol name, int slot)
 {
-   return probe(Object);
-}
+  if (2 * (count + 1) > (int) slots.size()) {
+    std::vector<std::pair<Symbol, int> > old;
+    old.swap(slots);
+    slots.assign(old.empty() ? 8 : 2 * old.size(),
+                 std::make_pair((Symbol) NULL, 0));
+    count = 0;
+    for (size_t i = 0; i < old.size(); i++)
+      if (old[i].first)
+        set(old[i].first, old[i].second);
+  }
+  size_t i = home(name);
+  while (slots[i].first && slots[i].first != name)
+    i = (i + 1) & (slots.size() - 1);
+  if (!slots[i].first)
+    count++;
+  slots[i] = std::make_pair(name, slot);
+}
+
+//
+// CgenNode::buildLayout
+//
+// A class starts from the attributes and dispatch table of its parent.
+// Its own attributes are appended; its methods either replace the
+// inherited slot of the same name or are appended.  The layout is
+// built once, from Object down, and every back end reads it.
+//
+void CgenNode::buildLayout()
+{
+  if (name != Object) {
+    attrs = parentnd->attrs;
+    methods = parentnd->methods;
+    method_owners = parentnd->method_owners;
+    attr_slots = parentnd->attr_slots;
+    method_slots = parentnd->method_slots;
+  }
+
+  std::vector<attr_class *> own;
+  for (int i = features->first(); features->more(i); i = features->next(i)) {
+    Feature f = features->nth(i);
+    if (f->isAttr()) {
+      own.push_back(static_cast<attr_class*>(f));
+      continue;
+    }
+    method_class *m = static_cast<method_class*>(f);
+    int slot = methodOffset(m->getName());
+    if (slot < 0) {
+      method_slots.set(m->getName(), methods.size());
+      methods.push_back(m);
+      method_owners.push_back(name);
+    } else {
+      methods[slot] = m;
+      method_owners[slot] = name;
+    }
+  }
 
+  if (cgen_optimize && !basic())
+    orderAttrs(own);
+  for (size_t i = 0; i < own.size(); i++) {
+    attr_slots.set(own[i]->getName(), attrs.size());
+    attrs.push_back(own[i]);
+  }
+  size = DEFAULT_OBJFIELDS + attrs.size();
+
+  for (List<CgenNode> *l = children; l; l = l->tl())
+    l->hd()->buildLayout();
+}
 
-///////////////////////////////////////////////////////////////////////
 //
-// CgenNode methods
+// CgenNode::countAttrUses
 //
-///////////////////////////////////////////////////////////////////////
+// The static uses of attributes in the code of each class and of its
+// descendants, which are the code that reads its attributes.  Children
+// are counted first and added to their parent.
+//
+void CgenNode::countAttrUses()
+{
+  AttrUses uses;
+  for (int i = features->first(); features->more(i); i = features->next(i)) {
+    Feature f = features->nth(i);
+    if (f->isAttr()) {
+      static_cast<attr_class*>(f)->getInitExpr()->countUses(uses);
+      continue;
+    }
+    method_class *m = static_cast<method_class*>(f);
+    Formals formals = m->getFormals();
+    for (int j = formals->first(); formals->more(j); j = formals->next(j))
+      uses.bind(formals->nth(j)->getName());
+    m->getExpr()->countUses(uses);
+    for (int j = formals->first(); formals->more(j); j = formals->next(j))
+      uses.unbind(formals->nth(j)->getName());
+  }
+  attr_uses.swap(uses.counts);
 
-CgenNode::CgenNode(Class_ nd, Basicness bstatus, CgenClassTableP ct) :
-   class__class((const class__class &) *nd),
-   parentnd(NULL),
-   children(NULL),
-   basic_status(bstatus)
-{ 
-   stringtable.add_string(name->get_string());          // Add class name to string table
+  for (List<CgenNode> *l = children; l; l = l->tl()) {
+    CgenNodeP child = l->hd();
+    child->countAttrUses();
+    std::map<Symbol, int>::iterator u;
+    for (u = child->attr_uses.begin(); u != child->attr_uses.end(); ++u)
+      attr_uses[u->first] += u->second;
+  }
 }
 
-
-//******************************************************************
 //
-//   Fill in the following methods to produce code for the
-//   appropriate expression.  You may add or remove parameters
-//   as you wish, but if you do, remember to change the parameters
-//   of the declarations in `cool-tree.h'  Sample code for
-//   constant integers, strings, and booleans are provided.
+// Bytes of the fields of a C object (see cgen_c.cc) up to the end of
+// attrs: the header is 16, Int and Bool attributes are unboxed ints of
+// 4 bytes and the others pointers of 8, each aligned to its size.
 //
-//*****************************************************************
+#define C_HEADER_SIZE 16
 
-void assign_class::code(ostream &s) {
+static bool c_unboxed(attr_class *a)
+{
+  return a->getType() == Int || a->getType() == Bool;
 }
 
-void static_dispatch_class::code(ostream &s) {
+static int c_field_end(int end, attr_class *a)
+{
+  int n = c_unboxed(a) ? 4 : 8;
+  return (end + n - 1) / n * n + n;
 }
 
-void dispatch_class::code(ostream &s) {
+static int c_object_size(const std::vector<attr_class *> &attrs)
+{
+  int end = C_HEADER_SIZE;
+  for (size_t i = 0; i < attrs.size(); i++)
+    end = c_field_end(end, attrs[i]);
+  return (end + 7) / 8 * 8;
 }
 
-void cond_class::code(ostream &s) {
+// the attributes of nd and its ancestors in the order they are declared
+static void declared_attrs(CgenNodeP nd, std::vector<attr_class *> &attrs)
+{
+  if (nd->get_name() != Object)
+    declared_attrs(nd->get_parentnd(), attrs);
+  Features features = nd->features;
+  for (int i = features->first(); features->more(i); i = features->next(i))
+    if (features->nth(i)->isAttr())
+      attrs.push_back(static_cast<attr_class*>(features->nth(i)));
+}
+
+struct ByUses {
+  const std::map<Symbol, int> *uses;
+  int count(attr_class *a) const
+  {
+    std::map<Symbol, int>::const_iterator u = uses->find(a->getName());
+    return u == uses->end() ? 0 : u->second;
+  }
+  bool operator()(attr_class *a, attr_class *b) const
+  { return count(a) > count(b); }
+};
+
+//
+// With -O the attributes a class declares are laid out most used
+// first, so that those its code uses most are together and near the
+// header, which every dispatch on the object reads.  Inherited
+// attributes keep their places, which the parent's code relies on.
+// In C, where Int and Bool attributes are unboxed, an int is put
+// wherever the field before leaves half a word free, so that ints
+// share words rather than each padding one out.  With -c the layouts
+// are reported on cerr.
+//
+void CgenNode::orderAttrs(std::vector<attr_class *> &own)
+{
+  ByUses by_uses = { &attr_uses };
+  std::stable_sort(own.begin(), own.end(), by_uses);
+
+  if (cgen_target == TARGET_C) {
+    int end = C_HEADER_SIZE;
+    for (size_t i = 0; i < attrs.size(); i++)
+      end = c_field_end(end, attrs[i]);
+    std::vector<attr_class *> packed;
+    while (!own.empty()) {
+      size_t k = 0;
+      if (end % 8 != 0) {
+        while (k < own.size() && !c_unboxed(own[k]))
+          k++;
+        if (k == own.size())
+          k = 0;
+      }
+      end = c_field_end(end, own[k]);
+      packed.push_back(own[k]);
+      own.erase(own.begin() + k);
+    }
+    own.swap(packed);
+  }
+
+  if (cgen_debug && !own.empty()) {
+    std::vector<attr_class *> laid_out(attrs), declared;
+    laid_out.insert(laid_out.end(), own.begin(), own.end());
+    declared_attrs(this, declared);
+    cerr << "# layout " << name << ": "
+         << DEFAULT_OBJFIELDS + laid_out.size() << " words; C "
+         << c_object_size(laid_out) << " bytes, "
+         << c_object_size(declared) << " as declared;";
+    for (size_t i = 0; i < own.size(); i++)
+      cerr << " " << own[i]->getName() << " " << by_uses.count(own[i]);
+    cerr << endl;
+  }
+}
+
+//
+// True if a collection may happen while X_init runs: the class or an
+// ancestor initializes an attribute with an expression that calls.
+// Until then the new object is still young, so with -O code_init
+// leaves out the write barrier on the attributes it stores.
+//
+bool CgenNode::initMayCollect()
+{
+  if (name != Object && parentnd->initMayCollect())
+    return true;
+  for (int i = features->first(); features->more(i); i = features->next(i)) {
+    Feature f = features->nth(i);
+    if (f->isAttr() && static_cast<attr_class*>(f)->getInitExpr()->hasCall())
+      return true;
+  }
+  return false;
 }
 
-void loop_class::code(ostream &s) {
+//
+// True if X_init does nothing but return self: neither the class nor
+// any ancestor initializes an attribute explicitly.
+//
+bool CgenNode::hasTrivialInit()
+{
+  if (name != Object && !parentnd->hasTrivialInit())
+    return false;
+  for (int i = features->first(); features->more(i); i = features->next(i)) {
+    Feature f = features->nth(i);
+    if (f->isAttr() && !static_cast<attr_class*>(f)->getInitExpr()->isNoExpr())
+      return false;
+  }
+  return true;
 }
 
-void typcase_class::code(ostream &s) {
-}
 
-void block_class::code(ostream &s) {
+void CgenClassTable::code_class_nametab()
+{
+  str << CLASSNAMETAB << LABEL;
+  for (size_t i = 0; i < tag_order.size(); i++) {
+    str << WORD;
+    stringtable.lookup_string(tag_order[i]->get_name()->get_string())->code_ref(str);
+    str << "\n";
+  }
 }
 
-void let_class::code(ostream &s) {
+void CgenClassTable::code_class_objtab()
+{
+  str << CLASSOBJTAB << LABEL;
+  for (size_t i = 0; i < tag_order.size(); i++) {
+    Symbol name = tag_order[i]->get_name();
+    str << WORD; emit_protobj_ref(name, str); str << "\n";
+    str << WORD; emit_init_ref(name, str);    str << "\n";
+  }
 }
 
-void plus_class::code(ostream &s) {
+void CgenClassTable::code_dispatch_tables()
+{
+  int words = 0;
+  for (size_t i = 0; i < tag_order.size(); i++)
+    words += tag_order[i]->numMethods();
+  if (cgen_debug)
+    cout << "# dispatch tables: " << words << " words, "
+         << (words * WORD_SIZE + 31) / 32 << " 32-byte lines" << endl;
+
+  if (cgen_compact_disptabs) {
+    code_compact_dispatch_tables();
+    return;
+  }
+  for (size_t i = 0; i < tag_order.size(); i++) {
+    CgenNodeP nd = tag_order[i];
+    emit_disptable_ref(nd->get_name(), str); str << LABEL;
+    for (int j = 0; j < nd->numMethods(); j++) {
+      str << WORD;
+      emit_method_ref(nd->getMethodOwner(j), nd->getMethod(j)->getName(), str);
+      str << "\n";
+    }
+  }
 }
 
-void sub_class::code(ostream &s) {
-}
+//
+// With -D the dispatch tables share one table.  Every class keeps its
+// slot numbering, and its _dispTab label marks where its row starts,
+// so objects and dispatch code are as before.  Rows are placed in tag
+// order at the first offset where each slot they cover is past the end
+// of the table or already holds the same method: a class that only
+// adds methods extends the row of the class placed just before it,
+// and classes with identical rows share one.
+//
+void CgenClassTable::code_compact_dispatch_tables()
+{
+  typedef std::pair<Symbol,Symbol> Entry;     // owner, method name
+  std::vector<Entry> table;
+  std::vector<std::vector<CgenNodeP> > starts;
+
+  for (size_t i = 0; i < tag_order.size(); i++) {
+    CgenNodeP nd = tag_order[i];
+    std::vector<Entry> row;
+    for (int j = 0; j < nd->numMethods(); j++)
+      row.push_back(Entry(nd->getMethodOwner(j), nd->getMethod(j)->getName()));
+
+    size_t o = 0;
+    for (;; o++) {
+      size_t j = 0;
+      while (j < row.size() && (o + j >= table.size() || table[o + j] == row[j]))
+        j++;
+      if (j == row.size())
+        break;
+    }
+    for (size_t j = 0; j < row.size(); j++)
+      if (o + j >= table.size())
+        table.push_back(row[j]);
+    starts.resize(table.size() + 1);
+    starts[o].push_back(nd);
+  }
+
+  for (size_t i = 0; i < table.size(); i++) {
+    for (size_t j = 0; j < starts[i].size(); j++) {
+      emit_disptable_ref(starts[i][j]->get_name(), str);
+      str << LABEL;
+    }
+    str << WORD;
+    emit_method_ref(table[i].first, table[i].second, str);
+    str << "\n";
+  }
 
-void mul_class::code(ostream &s) {
+  if (cgen_debug)
+    cout << "# compact dispatch table: " << table.size() << " words, "
+         << (table.size() * WORD_SIZE + 31) / 32 << " 32-byte lines" << endl;
 }
 
-void divide_class::code(ostream &s) {
+//
+// Prototype objects.  Attributes of the basic value classes start out
+// as the default constant of their class; everything else is void.
+//
+void CgenClassTable::code_prototypes()
+{
+  for (size_t i = 0; i < tag_order.size(); i++) {
+    CgenNodeP nd = tag_order[i];
+
+    str << WORD << "-1\n";                                  // eye catcher
+    emit_protobj_ref(nd->get_name(), str);  str << LABEL;        // label
+    str << WORD << nd->getTag() << "\n"                           // class tag
+        << WORD << nd->getSize() << "\n"                        // object size
+        << WORD;
+    emit_disptable_ref(nd->get_name(), str);  str << "\n";       // dispatch table
+
+    for (int j = 0; j < nd->numAttrs(); j++) {
+      Symbol type = nd->getAttr(j)->getType();
+      str << WORD;
+      if (type == Int)
+        inttable.lookup_string("0")->code_ref(str);
+      else if (type == Bool)
+        falsebool.code_ref(str);
+      else if (type == Str)
+        stringtable.lookup_string("")->code_ref(str);
+      else
+        str << EMPTYSLOT;
+      str << "\n";
+    }
+  }
 }
 
-void neg_class::code(ostream &s) {
-}
+//
+// var_env holds the formals and the let and case variables of the code
+// being generated; a name not bound there is an attribute of the
+// current class, found in its layout.  attr_locs[i] is attribute i.
+//
+static thread_local std::vector<VarLoc> attr_locs;
 
-void lt_class::code(ostream &s) {
+static void enter_class(CgenNodeP nd)
+{
+  curr_class = nd;
+  var_env->enterscope();
+  while ((int) attr_locs.size() < nd->numAttrs())
+    attr_locs.push_back(VarLoc(VarAttr, attr_locs.size()));
 }
 
-void eq_class::code(ostream &s) {
+static VarLoc *lookup_var(Symbol name)
+{
+  VarLoc *loc = var_env->lookup(name);
+  if (loc)
+    return loc;
+  int i = curr_class->attrOffset(name);
+  return i >= 0 ? &attr_locs[i] : NULL;
 }
 
-void leq_class::code(ostream &s) {
+static void exit_class()
+{
+  var_env->exitscope();
 }
 
-void comp_class::code(ostream &s) {
+void CgenClassTable::code_inits(ostream &s)
+{
+  for (size_t i = 0; i < tag_order.size(); i++) {
+    enter_class(tag_order[i]);
+    tag_order[i]->code_init(s);
+    exit_class();
+  }
 }
 
-void int_const_class::code(ostream& s)  
+void CgenClassTable::code_methods(ostream &s)
 {
-  //
-  // Need to be sure we have an IntEntry *, not an arbitrary Symbol
+  for (size_t i = 0; i < tag_order.size(); i++) {
+    if (tag_order[i]->basic())
+      continue;
+    enter_class(tag_order[i]);
+    tag_order[i]->code_methods(s);
+    exit_class();
+  }
+}
+
+//
+// With -j N the initializer and the methods of each class are coded by
+// N threads into buffers of their own, which are then appended in the
+// order code_inits and code_methods would have written them.  A class
+// numbers its labels, inline caches and frame maps from 0; appending
+// its code adds the number of those of the classes before it, so the
+// output is the same as the serial one.
+//
+struct ClassCode {
+  CgenNodeP nd;
+  bool init;                            // X_init, or else the methods
+  AsmStream code;
+  int labels;
+  int caches;
+  int counters;
+  int barriers, barriers_elided;
+  std::vector<std::pair<int, std::vector<int> > > stack_maps;
+};
+
+static void code_class(ClassCode *c)
+{
+  next_label = 0;
+  inline_caches = 0;
+  profile_counters = 0;
+  gc_barriers = gc_barriers_elided = 0;
+  stack_maps.clear();
+  frame_maps.clear();
+  frame_map_index.clear();
+
+  enter_class(c->nd);
+  if (c->init)
+    c->nd->code_init(c->code);
+  else
+    c->nd->code_methods(c->code);
+  exit_class();
+
+  c->labels = next_label;
+  c->caches = inline_caches;
+  c->counters = profile_counters;
+  c->barriers = gc_barriers;
+  c->barriers_elided = gc_barriers_elided;
+  for (size_t i = 0; i < stack_maps.size(); i++)
+    c->stack_maps.push_back(std::make_pair(stack_maps[i].first,
+                                           frame_maps[stack_maps[i].second]));
+}
+
+static void code_classes_thread(std::vector<ClassCode*> *classes,
+                                std::atomic<size_t> *next)
+{
+  if (!var_env)
+    var_env = new SymbolTable<Symbol,VarLoc>();
+  for (size_t i; (i = (*next)++) < classes->size(); )
+    code_class((*classes)[i]);
+}
+
+void CgenClassTable::code_classes(AsmBuffer &text)
+{
+  std::vector<ClassCode*> classes;
+  for (size_t i = 0; i < tag_order.size(); i++) {
+    ClassCode *c = new ClassCode();
+    c->nd = tag_order[i];
+    c->init = true;
+    classes.push_back(c);
+  }
+  for (size_t i = 0; i < tag_order.size(); i++)
+    if (!tag_order[i]->basic()) {
+      ClassCode *c = new ClassCode();
+      c->nd = tag_order[i];
+      c->init = false;
+      classes.push_back(c);
+    }
+
+  std::atomic<size_t> next(0);
+  std::vector<std::thread> threads;
+  for (int i = 1; i < cgen_jobs; i++)
+    threads.push_back(std::thread(code_classes_thread, &classes, &next));
+  code_classes_thread(&classes, &next);
+  for (size_t i = 0; i < threads.size(); i++)
+    threads[i].join();
+
+  int labels = 0, caches = 0, counters = 0, barriers = 0, elided = 0;
+  stack_maps.clear();
+  frame_maps.clear();
+  frame_map_index.clear();
+  for (size_t i = 0; i < classes.size(); i++) {
+    ClassCode *c = classes[i];
+    text.append(c->code.buffer(), labels, caches);
+    for (size_t j = 0; j < c->stack_maps.size(); j++)
+      stack_maps.push_back(
+        std::make_pair(labels + c->stack_maps[j].first,
+                       frame_map_number(c->stack_maps[j].second)));
+    labels += c->labels;
+    caches += c->caches;
+    counters += c->counters;
+    barriers += c->barriers;
+    elided += c->barriers_elided;
+    delete c;
+  }
+  next_label = labels;
+  inline_caches = caches;
+  profile_counters = counters;
+  gc_barriers = barriers;
+  gc_barriers_elided = elided;
+}
+
+void CgenClassTable::code()
+{
+  if (cgen_debug) cout << "coding global data" << endl;
+  code_global_data();
+
+  if (cgen_debug) cout << "choosing gc" << endl;
+  code_select_gc();
+
+  if (cgen_debug) cout << "coding constants" << endl;
+  code_constants();
+
+  if (cgen_debug) cout << "coding class tables" << endl;
+  code_class_nametab();
+  code_class_objtab();
+  code_dispatch_tables();
+  code_prototypes();
+
+  var_env = new SymbolTable<Symbol,VarLoc>();
+  if (cgen_profile_use)
+    read_profile(cgen_profile_use);
+
+  // the code is generated ahead of the global text so that its stack
+  // maps can go with the static data, which ends at heap_start
+  AsmStream text;
+
+  // classes are coded in parallel unless a profile numbers counters or
+  // lays out code across them, or the trace would interleave
+  if (cgen_jobs > 1 && !cgen_debug && !cgen_profile_generate &&
+      !cgen_profile_use)
+    code_classes(text.buffer());
+  else {
+    if (cgen_debug) cout << "coding initializers" << endl;
+    code_inits(text);
+
+    if (cgen_debug) cout << "coding methods" << endl;
+    code_methods(text);
+  }
+  emit_code(cold_methods, text);
+
+  if (cgen_Memmgr == GC_PRECISE) {
+    if (cgen_debug) cout << "coding stack maps" << endl;
+    code_stack_maps(text.buffer());
+  }
+
+  if (cgen_profile_generate) {
+    if (cgen_debug) cout << "coding profile counters" << endl;
+    code_profile_counters();
+  }
+
+  if (cgen_inline_caches) {
+    if (cgen_debug) cout << "coding inline caches" << endl;
+    code_inline_caches();
+  }
+
+  if (cgen_debug) cout << "coding global text" << endl;
+  code_global_text();
+  emit_code(text, str);
+
+  if (cgen_debug && cgen_Memmgr != GC_NOGC)
+    cout << "# write barriers: " << gc_barriers << " emitted, "
+         << gc_barriers_elided << " elided" << endl;
+  if (cgen_profile_use && !profile.empty() &&
+      (int) profile.size() != profile_counters)
+    cerr << "warning: " << cgen_profile_use << " has " << profile.size()
+         << " counters, the program " << profile_counters
+         << "; was it made with other code or flags?" << endl;
+}
+
+
+CgenNodeP CgenClassTable::root()
+{
+   return probe(Object);
+}
+
+CgenNodeP CgenClassTable::lookupClass(Symbol type, CgenNodeP curr)
+{
+   return probe(type == SELF_TYPE ? curr->get_name() : type);
+}
+
+
+///////////////////////////////////////////////////////////////////////
+//
+// CgenNode methods
+//
+///////////////////////////////////////////////////////////////////////
+
+CgenNode::CgenNode(Class_ nd, Basicness bstatus, CgenClassTableP ct) :
+   class__class((const class__class &) *nd),
+   parentnd(NULL),
+   children(NULL),
+   basic_status(bstatus),
+   tag(0),
+   max_tag(0)
+{ 
+   stringtable.add_string(name->get_string());          // Add class name to string table
+}
+
+//
+// X_init runs the parent's initializer and then the initializers of
+// the attributes X declares, in order.  With -O a call to an
+// initializer that would only return self is left out.
+//
+void CgenNode::code_init(ostream &s)
+{
+  bool call_parent = name != Object &&
+    !(cgen_optimize && parentnd->hasTrivialInit());
+  bool calls = call_parent;
+  bool young = name == Object || !parentnd->initMayCollect();
+  std::vector<bool> barriers;
+  int temps = 0;
+
+  for (int i = features->first(); features->more(i); i = features->next(i)) {
+    Feature f = features->nth(i);
+    if (!f->isAttr())
+      continue;
+    Expression init = static_cast<attr_class*>(f)->getInitExpr();
+    if (init->isNoExpr())
+      continue;
+    young = young && !init->hasCall();
+    barriers.push_back(needs_barrier(init, young));
+    temps = std::max(temps, init->numTemps());
+    calls = calls || init->hasCall() || barriers.back();
+  }
+
+  value_base = temps;                   // initializers keep no values
+  emit_name_def(init_label(name), s);
+  emit_method_entry(temps, 0, 0, is_leaf(temps, calls), s);
+
+  if (call_parent) {
+    emit_call(init_label(parentnd->get_name()), s);
+    emit_gc_point(s);
+  }
+
+  size_t next = 0;
+  for (int i = features->first(); features->more(i); i = features->next(i)) {
+    Feature f = features->nth(i);
+    if (!f->isAttr())
+      continue;
+    attr_class *a = static_cast<attr_class*>(f);
+    if (a->getInitExpr()->isNoExpr())
+      continue;
+    a->getInitExpr()->code(s);
+    emit_var_store(ACC, lookup_var(a->getName()), s, barriers[next++]);
+  }
+
+  emit_move(ACC, self_reg, s);
+  emit_method_exit(s);
+  flush_cold_code(s);
+  end_stack_maps(std::vector<bool>(curr_temps, false));
+}
+
+void CgenNode::code_methods(ostream &s)
+{
+  for (int i = features->first(); features->more(i); i = features->next(i)) {
+    Feature f = features->nth(i);
+    if (!f->isMethod())
+      continue;
+    method_class *m = static_cast<method_class*>(f);
+    Formals formals = m->getFormals();
+    Expression body = m->getExpr();
+    int slots = number_values(body, formals);
+    value_base = body->numTemps();
+    int temps = value_base + slots;
+    int nregs = reg_args(this, m->getName(), formals->len());
+    bool leaf = is_leaf(temps, body->hasCall());
+
+    var_env->enterscope();
+    std::vector<VarLoc*> locs;
+    for (int j = formals->first(); formals->more(j); j = formals->next(j)) {
+      if (j >= nregs)
+        locs.push_back(new VarLoc(VarFormal, j - nregs));
+      else if (leaf)
+        locs.push_back(new VarLoc(VarArgReg, j));
+      else
+        locs.push_back(new VarLoc(VarTemp, temps + j));
+      var_env->addid(formals->nth(j)->getName(), locs.back());
+    }
+
+    int entry = new_counters(1);
+    ostream &out = !profile.empty() && profile_count(entry) == 0 ?
+                   cold_methods : s;
+
+    // the body is generated first to learn which register arguments
+    // it actually reads and so must be spilled
+    AsmStream body_code;
+    emit_name_def(method_label(name, m->getName()), out);
+    emit_method_entry(temps, formals->len() - nregs, nregs, leaf, out);
+    emit_count(entry, out);
+    body->code(body_code);
+    // a slot left unspilled is still scanned by the collector, unless
+    // the stack maps of -G already mark it dead
+    for (int j = 0; j < nregs && !leaf; j++)
+      if (locs[j]->used)
+        emit_store(arg_regs[j], temps + j, FP, out);
+      else if (cgen_Memmgr != GC_NOGC && cgen_Memmgr != GC_PRECISE)
+        emit_store(ZERO, temps + j, FP, out);
+    emit_code(body_code, out);
+    emit_method_exit(out);
+    flush_cold_code(out);
+
+    std::vector<bool> live(curr_temps, false);
+    for (int j = value_base; j < temps; j++)
+      live[j] = true;
+    for (int j = 0; j < nregs && !leaf; j++)
+      live[temps + j] = locs[j]->used;
+    end_stack_maps(live);
+
+    if (cgen_debug && slots > 0)
+      cout << "# " << name << "." << m->getName() << ": "
+           << reused_slot.size() << " evaluations reused from "
+           << slots << " temporaries" << endl;
+    value_slot.clear();
+    reused_slot.clear();
+    invariant_slot.clear();
+    invariant_label.clear();
+    loop_slots.clear();
+    var_env->exitscope();
+  }
+}
+
+
+//******************************************************************
+//
+//   Fill in the following methods to produce code for the
+//   appropriate expression.  You may add or remove parameters
+//   as you wish, but if you do, remember to change the parameters
+//   of the declarations in `cool-tree.h'  Sample code for
+//   constant integers, strings, and booleans are provided.
+//
+//*****************************************************************
+
+static int new_label()
+{
+  return next_label++;
+}
+
+//
+// Load the value of a variable that is declared without an initializer.
+//
+static void emit_default_value(char *dest, Symbol type, ostream &s)
+{
+  if (type == Int)
+    emit_load_int(dest, inttable.lookup_string("0"), s);
+  else if (type == Bool)
+    emit_load_bool(dest, falsebool, s);
+  else if (type == Str)
+    emit_load_string(dest, stringtable.lookup_string(""), s);
+  else
+    emit_move(dest, ZERO, s);
+}
+
+//
+// Load the lengths of the Strings in T1 and T2 into ACC and A1.
+//
+static void emit_string_lengths(ostream &s)
+{
+  emit_load(ACC, DEFAULT_OBJFIELDS, T1, s);
+  emit_load(A1, DEFAULT_OBJFIELDS, T2, s);
+  emit_fetch_int(ACC, ACC, s);
+  emit_fetch_int(A1, A1, s);
+}
+
+//
+// Evaluate e1 and e2 of a binary operation, leaving e2 in ACC and
+// e1 in a temporary.  Returns the temporary.
+//
+static int code_operands(Expression e1, Expression e2, ostream &s)
+{
+  e1->code(s);
+  int t = next_temp++;
+  emit_temp_store(ACC, t, s);
+  e2->code(s);
+  next_temp--;
+  return t;
+}
+
+//
+// Integer arithmetic: the result is a fresh copy of the Int in e2.
+// The temporary holding e1 stays live across the copy.
+//
+static void code_arith(Expression e1, Expression e2,
+                       void (*emit_op)(char *, char *, char *, ostream &),
+                       ostream &s)
+{
+  e1->code(s);
+  int t = next_temp++;
+  emit_temp_store(ACC, t, s);
+  e2->code(s);
+  emit_call(method_label(Object, ::copy), s);
+  emit_gc_point(s);
+  next_temp--;
+  emit_temp_load(T1, t, s);
+  emit_fetch_int(T1, T1, s);
+  emit_fetch_int(T2, ACC, s);
+  emit_op(T1, T1, T2, s);
+  emit_store_int(T1, ACC, s);
+}
+
+//
+// With -O, arithmetic with a constant operand leaves the constant out
+// of the evaluation: additions become an addi (which traps on overflow
+// just like add), and multiplication and division by a power of two
+// become shifts.
+//
+static bool int_const_value(Expression e, int &value)
+{
+  int_const_class *c = dynamic_cast<int_const_class*>(e);
+  if (c == NULL)
+    return false;
+  value = atoi(c->token->get_string());
+  return true;
+}
+
+static bool fits_imm16(int value)
+{
+  return value >= -32768 && value <= 32767;
+}
+
+// k if value is 2^k for some k >= 1, else -1
+static int power_of_two(int value)
+{
+  if (value < 2 || (value & (value - 1)) != 0)
+    return -1;
+  int k = 0;
+  while ((1 << k) != value)
+    k++;
+  return k;
+}
+
+//
+// An evaluation found redundant by value numbering loads the value kept
+// by the first one instead.
+//
+// A loop-invariant evaluation skips to the end once its loop has kept
+// the value.
+//
+static bool code_reused(Expression e, ostream &s)
+{
+  std::map<Expression, int>::iterator i = reused_slot.find(e);
+  if (i != reused_slot.end()) {
+    emit_temp_load(ACC, value_base + i->second, s);
+    return true;
+  }
+  i = invariant_slot.find(e);
+  if (i != invariant_slot.end()) {
+    int label = new_label();
+    invariant_label[e] = label;
+    emit_temp_load(ACC, value_base + i->second, s);
+    emit_bne(ACC, ZERO, label, s);
+  }
+  return false;
+}
+
+static void keep_value(Expression e, ostream &s)
+{
+  std::map<Expression, int>::iterator i = value_slot.find(e);
+  if (i != value_slot.end())
+    emit_temp_store(ACC, value_base + i->second, s);
+  i = invariant_slot.find(e);
+  if (i != invariant_slot.end()) {
+    emit_temp_store(ACC, value_base + i->second, s);
+    emit_label_def(invariant_label[e], s);
+  }
+}
+
+//
+// With -O an Int that is only an operand of arithmetic or of a
+// comparison does not escape, so it is never boxed: code_int() leaves
+// the integer itself in ACC, and only the outermost arithmetic boxes
+// its result.
+//
+// While the second operand is evaluated the first is held in one of
+// $t5-$t7, which neither the runtime nor the collector touch.  If the
+// second operand may call, the first is held boxed in a temporary
+// instead: a collection scans the frame for pointers and must not
+// meet a bare integer there.  In a leaf method temporaries are
+// registers, and nothing collects anyway.
+//
+#define RAW_REGS 3
+static char *raw_regs[RAW_REGS] = { "$t5", "$t6", "$t7" };
+static thread_local int raw_depth = 0;
+
+// e is kept in or loaded from a temporary by value numbering
+static bool keeps_value(Expression e)
+{
+  return value_slot.count(e) || reused_slot.count(e) || invariant_slot.count(e);
+}
+
+// e is arithmetic that code_int() computes without boxing
+static bool unboxed(Expression e)
+{
+  return cgen_optimize && !keeps_value(e) &&
+         (dynamic_cast<plus_class*>(e) != NULL ||
+          dynamic_cast<sub_class*>(e) != NULL ||
+          dynamic_cast<mul_class*>(e) != NULL ||
+          dynamic_cast<divide_class*>(e) != NULL ||
+          dynamic_cast<neg_class*>(e) != NULL);
+}
+
+void Expression_class::code_int(ostream &s) {
+  code(s);
+  emit_fetch_int(ACC, ACC, s);
+}
+
+void int_const_class::code_int(ostream &s) {
+  emit_load_imm(ACC, atoi(token->get_string()), s);
+}
+
+//
+// Evaluate e1 and e2 as integers, leaving e2 in ACC.  Returns the
+// register holding e1.
+//
+static char *code_int_operands(Expression e1, Expression e2, ostream &s)
+{
+  if (!leaf_method && !e2->intHasCall() && raw_depth < RAW_REGS) {
+    e1->code_int(s);
+    char *r = raw_regs[raw_depth++];
+    emit_move(r, ACC, s);
+    e2->code_int(s);
+    raw_depth--;
+    return r;
+  }
+  if (leaf_method)
+    e1->code_int(s);
+  else
+    e1->code(s);
+  int t = next_temp++;
+  emit_temp_store(ACC, t, s);
+  e2->code_int(s);
+  emit_temp_load(T1, t, s);
+  if (!leaf_method)
+    emit_fetch_int(T1, T1, s);
+  next_temp--;
+  return T1;
+}
+
+static void code_int_arith(char op, Expression e1, Expression e2, ostream &s)
+{
+  int c;
+  switch (op) {
+  case '+':
+    if (int_const_value(e2, c) && fits_imm16(c)) {
+      e1->code_int(s);
+      emit_addi(ACC, ACC, c, s);
+    } else if (int_const_value(e1, c) && fits_imm16(c)) {
+      e2->code_int(s);
+      emit_addi(ACC, ACC, c, s);
+    } else
+      emit_add(ACC, code_int_operands(e1, e2, s), ACC, s);
+    break;
+  case '-':
+    if (int_const_value(e2, c) && fits_imm16(c) && fits_imm16(-c)) {
+      e1->code_int(s);
+      emit_addi(ACC, ACC, -c, s);
+    } else
+      emit_sub(ACC, code_int_operands(e1, e2, s), ACC, s);
+    break;
+  case '*':
+    if (int_const_value(e2, c) && power_of_two(c) > 0) {
+      e1->code_int(s);
+      emit_sll(ACC, ACC, power_of_two(c), s);
+    } else if (int_const_value(e1, c) && power_of_two(c) > 0) {
+      e2->code_int(s);
+      emit_sll(ACC, ACC, power_of_two(c), s);
+    } else
+      emit_mul(ACC, code_int_operands(e1, e2, s), ACC, s);
+    break;
+  case '/':
+    if (int_const_value(e2, c) && power_of_two(c) > 0) {
+      int k = power_of_two(c);
+      e1->code_int(s);
+      emit_sra(T1, ACC, 31, s);
+      emit_srl(T1, T1, 32 - k, s);
+      emit_addu(ACC, ACC, T1, s);
+      emit_sra(ACC, ACC, k, s);
+    } else
+      emit_div(ACC, code_int_operands(e1, e2, s), ACC, s);
+    break;
+  case '~':
+    e1->code_int(s);
+    emit_neg(ACC, ACC, s);
+    break;
+  }
+}
+
+//
+// Box the integer in ACC.  Nothing is boxed while raw registers hold
+// operands, since an operand that may call is held boxed.
+//
+// Integers in the range of -fint-cache are not allocated: the
+// box is the preallocated Int in int_cache, found from the value by
+// scaling with the 5 words each cached Int and its eyecatcher take.
+// Others copy Int_protObj.
+//
+static void emit_box_int(ostream &s)
+{
+  char *r = raw_regs[raw_depth];
+  int alloc = new_label();
+  int done = new_label();
+  emit_move(r, ACC, s);
+  emit_addiu(T2, ACC, -cgen_int_cache_min, s);
+  emit_sltiu(ACC, T2, cgen_int_cache_max - cgen_int_cache_min + 1, s);
+  emit_beqz(ACC, alloc, s);
+  emit_sll(ACC, T2, 4, s);
+  emit_sll(T2, T2, 2, s);
+  emit_addu(T2, T2, ACC, s);
+  emit_load_address(ACC, INTCACHE, s);
+  emit_addu(ACC, ACC, T2, s);
+  emit_branch(done, s);
+  emit_label_def(alloc, s);
+  emit_load_label(ACC, protobj_label(Int), s);
+  emit_call(method_label(Object, ::copy), s);
+  emit_gc_point(s);
+  emit_store_int(r, ACC, s);
+  emit_label_def(done, s);
+}
+
+void plus_class::code_int(ostream &s) {
+  if (keeps_value(this))
+    Expression_class::code_int(s);
+  else
+    code_int_arith('+', e1, e2, s);
+}
+
+void sub_class::code_int(ostream &s) {
+  if (keeps_value(this))
+    Expression_class::code_int(s);
+  else
+    code_int_arith('-', e1, e2, s);
+}
+
+void mul_class::code_int(ostream &s) {
+  if (keeps_value(this))
+    Expression_class::code_int(s);
+  else
+    code_int_arith('*', e1, e2, s);
+}
+
+void divide_class::code_int(ostream &s) {
+  if (keeps_value(this))
+    Expression_class::code_int(s);
+  else
+    code_int_arith('/', e1, e2, s);
+}
+
+void neg_class::code_int(ostream &s) {
+  if (keeps_value(this))
+    Expression_class::code_int(s);
+  else
+    code_int_arith('~', e1, NULL, s);
+}
+
+void assign_class::code(ostream &s) {
+  expr->code(s);
+  emit_var_store(ACC, lookup_var(name), s, needs_barrier(expr, false));
+}
+
+//
+// Arguments are evaluated left to right, then the receiver.  Of the
+// first nregs arguments, which go in $a1-$a3, an argument followed
+// by a call would have its register clobbered, so it is held in a
+// temporary and loaded once the receiver is known; the others are
+// moved to their register at once.  The rest are pushed.
+//
+static int held_args(Expression expr, Expressions actual, int nregs)
+{
+  if (expr->hasCall())
+    return nregs;
+  int held = 0;
+  for (int i = actual->first(); actual->more(i); i = actual->next(i))
+    if (actual->nth(i)->hasCall())
+      held = std::min(i, nregs);
+  return held;
+}
+
+static void code_actuals(Expressions actual, int nregs, int nheld, ostream &s)
+{
+  for (int i = actual->first(); actual->more(i); i = actual->next(i)) {
+    actual->nth(i)->code(s);
+    if (i < nheld)
+      emit_temp_store(ACC, next_temp++, s);
+    else if (i < nregs)
+      emit_move(arg_regs[i], ACC, s);
+    else
+      emit_push(ACC, s);
+  }
+}
+
+static void load_held_actuals(int nheld, ostream &s)
+{
+  next_temp -= nheld;
+  for (int i = 0; i < nheld; i++)
+    emit_temp_load(arg_regs[i], next_temp + i, s);
+}
+
+static void code_void_check(int line, ostream &s)
+{
+  int ok = new_label();
+  emit_bne(ACC, ZERO, ok, s);
+  emit_abort("_dispatch_abort", line, s);
+  emit_label_def(ok, s);
+}
+
+void static_dispatch_class::code(ostream &s) {
+  CgenNodeP nd = codegen_classtable->lookupClass(type_name, curr_class);
+  int nregs = reg_args(nd, name, actual->len());
+  int nheld = held_args(expr, actual, nregs);
+
+  code_actuals(actual, nregs, nheld, s);
+  expr->code(s);
+  code_void_check(get_line_number(), s);
+  load_held_actuals(nheld, s);
+
+  emit_load_label(T1, disptable_label(type_name), s);
+  emit_load(T1, nd->methodOffset(name), T1, s);
+  emit_jalr(T1, s);
+  emit_gc_point(s);
+}
+
+//
+// With -I every dynamic dispatch site has an inline cache: two words
+// holding the dispatch table of the last receiver and the method found
+// in it.  The dispatch table stands for the receiver's class tag (with
+// -D classes may share one, but then they have the same methods).  On
+// a hit the target is loaded from the cache; on a miss it is looked up
+// in the table and both words are replaced.  Expects the receiver's
+// dispatch table in T1 and leaves the target there.
+//
+static void code_inline_cache(int offset, ostream &s)
+{
+  int hit = new_label();
+  int call = new_label();
+  emit_insn(ASM_LA, T3, NULL, NULL, 0,
+            ASM_LABEL_ID(LABEL_INLINE_CACHE, inline_caches++), s);
+  emit_load(T2, 0, T3, s);
+  emit_beq(T1, T2, hit, s);
+  emit_store(T1, 0, T3, s);
+  emit_load(T1, offset, T1, s);
+  emit_store(T1, 1, T3, s);
+  emit_branch(call, s);
+  emit_label_def(hit, s);
+  emit_load(T1, 1, T3, s);
+  emit_label_def(call, s);
+}
+
+static void emit_dispatch(CgenNodeP nd, Symbol name, ostream &s)
+{
+  emit_load(T1, DISPTABLE_OFFSET, ACC, s);
+  if (cgen_inline_caches)
+    code_inline_cache(nd->methodOffset(name), s);
+  else
+    emit_load(T1, nd->methodOffset(name), T1, s);
+  emit_jalr(T1, s);
+  emit_gc_point(s);
+}
+
+//
+// A dispatch on a receiver of static class nd counts the classes in
+// nd's subtree, whose tags are consecutive.
+//
+static void emit_count_receiver(int c, CgenNodeP nd, ostream &s)
+{
+  if (!cgen_profile_generate)
+    return;
+  emit_load(T1, TAG_OFFSET, ACC, s);
+  emit_sll(T1, T1, LOG_WORD_SIZE, s);
+  emit_load_address(T2, PROFILE_COUNTERS, s);
+  emit_addu(T2, T2, T1, s);
+  emit_load(T1, c - nd->getTag(), T2, s);
+  emit_addiu(T1, T1, 1, s);
+  emit_store(T1, c - nd->getTag(), T2, s);
+}
+
+// the class of at least 9 in 10 receivers counted from c on, if any
+static CgenNodeP dominant_receiver(int c, CgenNodeP nd)
+{
+  long long total = 0;
+  int best = 0;
+  for (int k = 0; k <= nd->getMaxTag() - nd->getTag(); k++) {
+    total += profile_count(c + k);
+    if (profile_count(c + k) > profile_count(c + best))
+      best = k;
+  }
+  if (total == 0 || profile_count(c + best) * 10LL < total * 9)
+    return NULL;
+  return codegen_classtable->lookupTag(nd->getTag() + best);
+}
+
+//
+// A method of no arguments whose body is self, an attribute or a
+// constant is inlined where the receiver is known; the receiver is in
+// ACC.
+//
+static bool code_inline_method(CgenNodeP nd, method_class *m, ostream &s)
+{
+  if (m->getFormals()->len() > 0)
+    return false;
+  Expression e = m->getExpr();
+  object_class *o = dynamic_cast<object_class*>(e);
+  if (o != NULL) {
+    if (o->name == self)
+      return true;
+    emit_load(ACC, DEFAULT_OBJFIELDS + nd->attrOffset(o->name), ACC, s);
+    return true;
+  }
+  if (dynamic_cast<int_const_class*>(e) != NULL ||
+      dynamic_cast<string_const_class*>(e) != NULL ||
+      dynamic_cast<bool_const_class*>(e) != NULL) {
+    e->code(s);
+    return true;
+  }
+  return false;
+}
+
+//
+// With -fprofile-use a dispatch whose receivers nearly all had one
+// class tests for it and calls its method directly, or inlines it.
+// The dispatch for the other classes is laid out after the method.
+//
+void dispatch_class::code(ostream &s) {
+  CgenNodeP nd = codegen_classtable->lookupClass(expr->get_type(), curr_class);
+  int nregs = reg_args(nd, name, actual->len());
+  int nheld = held_args(expr, actual, nregs);
+
+  code_actuals(actual, nregs, nheld, s);
+  expr->code(s);
+  code_void_check(get_line_number(), s);
+  load_held_actuals(nheld, s);
+
+  int c = new_counters(nd->getMaxTag() - nd->getTag() + 1);
+  emit_count_receiver(c, nd, s);
+  CgenNodeP target = dominant_receiver(c, nd);
+  if (target == NULL) {
+    emit_dispatch(nd, name, s);
+    return;
+  }
+
+  int other = new_label();
+  int done = new_label();
+  int slot = target->methodOffset(name);
+  emit_load(T1, TAG_OFFSET, ACC, s);
+  emit_bnei(T1, target->getTag(), other, s);
+  if (!code_inline_method(target, target->getMethod(slot), s)) {
+    emit_call(method_label(target->getMethodOwner(slot), name), s);
+    emit_gc_point(s);
+  }
+  emit_label_def(done, s);
+
+  AsmStream cold;
+  emit_label_def(other, cold);
+  emit_dispatch(nd, name, cold);
+  emit_branch(done, cold);
+  emit_code(cold, cold_code);
+}
+
+//
+// code_branch jumps to label if the expression evaluates to sense and
+// falls through otherwise.  In general that means testing the Bool
+// object it evaluates to; with -O comparisons, not, isvoid and
+// constants branch directly without making a Bool.
+//
+void Expression_class::code_branch(ostream &s, bool sense, int label) {
+  code(s);
+  emit_fetch_int(T1, ACC, s);
+  if (sense)
+    emit_bne(T1, ZERO, label, s);
+  else
+    emit_beqz(T1, label, s);
+}
+
+//
+// With -fprofile-use an arm that rarely runs is laid out after the
+// method, so the other falls through.
+//
+void cond_class::code(ostream &s) {
+  int else_label = new_label();
+  int end_label = new_label();
+  int c = new_counters(2);
+  AsmStream cold;
+
+  if (rarely(profile_count(c + 1), profile_count(c))) {
+    pred->code_branch(s, false, else_label);
+    emit_count(c, s);
+    then_exp->code(s);
+    emit_label_def(end_label, s);
+    emit_label_def(else_label, cold);
+    emit_count(c + 1, cold);
+    else_exp->code(cold);
+    emit_branch(end_label, cold);
+  } else if (rarely(profile_count(c), profile_count(c + 1))) {
+    int then_label = new_label();
+    pred->code_branch(s, true, then_label);
+    emit_label_def(then_label, cold);
+    emit_count(c, cold);
+    then_exp->code(cold);
+    emit_branch(end_label, cold);
+    emit_count(c + 1, s);
+    else_exp->code(s);
+    emit_label_def(end_label, s);
+  } else {
+    pred->code_branch(s, false, else_label);
+    emit_count(c, s);
+    then_exp->code(s);
+    emit_branch(end_label, s);
+    emit_label_def(else_label, s);
+    emit_count(c + 1, s);
+    else_exp->code(s);
+    emit_label_def(end_label, s);
+  }
+  emit_code(cold, cold_code);
+}
+
+//
+// With -O, or with a profile, the test is placed after the body, so an
+// iteration takes one branch instead of two.  If the profile says the
+// body rarely runs, the test comes first and the body is laid out
+// after the method.
+//
+void loop_class::code(ostream &s) {
+  int top_label = new_label();
+  int end_label = new_label();
+  int c = new_counters(2);
+
+  if (!cgen_optimize && profile.empty()) {
+    emit_label_def(top_label, s);
+    pred->code(s);
+    emit_fetch_int(T1, ACC, s);
+    emit_beqz(T1, end_label, s);
+    emit_count(c, s);
+    body->code(s);
+    emit_branch(top_label, s);
+    emit_label_def(end_label, s);
+    emit_count(c + 1, s);
+    emit_move(ACC, ZERO, s);
+    return;
+  }
+
+  if (cgen_optimize) {
+    std::vector<int> &slots = loop_slots[this];
+    for (size_t i = 0; i < slots.size(); i++)
+      emit_temp_store(ZERO, value_base + slots[i], s);
+  }
+
+  // generated in the same order as without a profile
+  AsmStream body_code, test_code;
+  emit_count(c, body_code);
+  if (cgen_optimize) {
+    body->code(body_code);
+    pred->code_branch(test_code, true, top_label);
+  } else {
+    pred->code_branch(test_code, true, top_label);
+    body->code(body_code);
+  }
+
+  if (rarely(profile_count(c), profile_count(c + 1))) {
+    emit_label_def(end_label, s);
+    emit_code(test_code, s);
+    AsmStream cold;
+    emit_label_def(top_label, cold);
+    emit_code(body_code, cold);
+    emit_branch(end_label, cold);
+    emit_code(cold, cold_code);
+  } else {
+    emit_branch(end_label, s);
+    emit_label_def(top_label, s);
+    emit_code(body_code, s);
+    emit_label_def(end_label, s);
+    emit_code(test_code, s);
+  }
+  emit_count(c + 1, s);
+  emit_move(ACC, ZERO, s);
+}
+
+//
+// Branches are tried from the most specific class (largest tag) to
+// the least, so the first whose tag range holds the object's tag is
+// the closest ancestor.
+//
+static bool by_tag_desc(branch_class *a, branch_class *b)
+{
+  return codegen_classtable->lookupClass(a->get_type_decl(), curr_class)->getTag() >
+         codegen_classtable->lookupClass(b->get_type_decl(), curr_class)->getTag();
+}
+
+void typcase_class::code(ostream &s) {
+  int end_label = new_label();
+  int ok = new_label();
+
+  expr->code(s);
+  emit_bne(ACC, ZERO, ok, s);
+  emit_abort("_case_abort2", get_line_number(), s);
+  emit_label_def(ok, s);
+
+  int t = next_temp++;
+  emit_temp_store(ACC, t, s);
+  emit_load(T2, TAG_OFFSET, ACC, s);
+
+  std::vector<branch_class*> branches;
+  for (int i = cases->first(); cases->more(i); i = cases->next(i))
+    branches.push_back(static_cast<branch_class*>(cases->nth(i)));
+  std::sort(branches.begin(), branches.end(), by_tag_desc);
+
+  for (size_t i = 0; i < branches.size(); i++) {
+    branch_class *b = branches[i];
+    CgenNodeP nd = codegen_classtable->lookupClass(b->get_type_decl(), curr_class);
+    int next = new_label();
+
+    emit_blti(T2, nd->getTag(), next, s);
+    emit_bgti(T2, nd->getMaxTag(), next, s);
+    var_env->enterscope();
+    var_env->addid(b->getName(), new VarLoc(VarTemp, t));
+    b->getExpr()->code(s);
+    var_env->exitscope();
+    emit_branch(end_label, s);
+    emit_label_def(next, s);
+  }
+
+  emit_jal("_case_abort", s);
+  emit_label_def(end_label, s);
+  next_temp--;
+}
+
+void block_class::code(ostream &s) {
+  for (int i = body->first(); body->more(i); i = body->next(i))
+    body->nth(i)->code(s);
+}
+
+void let_class::code(ostream &s) {
+  if (init->isNoExpr())
+    emit_default_value(ACC, type_decl, s);
+  else
+    init->code(s);
+
+  int t = next_temp++;
+  emit_temp_store(ACC, t, s);
+  var_env->enterscope();
+  var_env->addid(identifier, new VarLoc(VarTemp, t));
+  body->code(s);
+  var_env->exitscope();
+  next_temp--;
+}
+
+void plus_class::code(ostream &s) {
+  if (code_reused(this, s))
+    return;
+  if (cgen_optimize) {
+    code_int_arith('+', e1, e2, s);
+    emit_box_int(s);
+  } else
+    code_arith(e1, e2, emit_add, s);
+  keep_value(this, s);
+}
+
+void sub_class::code(ostream &s) {
+  if (code_reused(this, s))
+    return;
+  if (cgen_optimize) {
+    code_int_arith('-', e1, e2, s);
+    emit_box_int(s);
+  } else
+    code_arith(e1, e2, emit_sub, s);
+  keep_value(this, s);
+}
+
+void mul_class::code(ostream &s) {
+  if (code_reused(this, s))
+    return;
+  if (cgen_optimize) {
+    code_int_arith('*', e1, e2, s);
+    emit_box_int(s);
+  } else
+    code_arith(e1, e2, emit_mul, s);
+  keep_value(this, s);
+}
+
+void divide_class::code(ostream &s) {
+  if (code_reused(this, s))
+    return;
+  if (cgen_optimize) {
+    code_int_arith('/', e1, e2, s);
+    emit_box_int(s);
+  } else
+    code_arith(e1, e2, emit_div, s);
+  keep_value(this, s);
+}
+
+void neg_class::code(ostream &s) {
+  if (code_reused(this, s))
+    return;
+  if (cgen_optimize) {
+    code_int_arith('~', e1, NULL, s);
+    emit_box_int(s);
+  } else {
+    e1->code(s);
+    emit_call(method_label(Object, ::copy), s);
+    emit_gc_point(s);
+    emit_fetch_int(T1, ACC, s);
+    emit_neg(T1, T1, s);
+    emit_store_int(T1, ACC, s);
+  }
+  keep_value(this, s);
+}
+
+void lt_class::code(ostream &s) {
+  char *r1 = T1, *r2 = T2;
+
+  if (cgen_optimize) {
+    r1 = code_int_operands(e1, e2, s);
+    emit_move(r2, ACC, s);
+  } else {
+    int t = code_operands(e1, e2, s);
+    emit_temp_load(T1, t, s);
+    emit_fetch_int(T1, T1, s);
+    emit_fetch_int(T2, ACC, s);
+  }
+  int done = new_label();
+  emit_load_bool(ACC, truebool, s);
+  emit_blt(r1, r2, done, s);
+  emit_load_bool(ACC, falsebool, s);
+  emit_label_def(done, s);
+}
+
+// a < b is false when b <= a
+void lt_class::code_branch(ostream &s, bool sense, int label) {
+  if (!cgen_optimize) {
+    Expression_class::code_branch(s, sense, label);
+    return;
+  }
+  char *r = code_int_operands(e1, e2, s);
+  if (sense)
+    emit_blt(r, ACC, label, s);
+  else
+    emit_bleq(ACC, r, label, s);
+}
+
+//
+// Pointer equality is tested inline; otherwise equality_test compares
+// Int, Bool and String values.
+//
+void eq_class::code(ostream &s) {
+  Symbol type = e1->get_type();
+  if (cgen_optimize && type == Int) {
+    char *r = code_int_operands(e1, e2, s);
+    int done = new_label();
+    emit_move(T2, ACC, s);
+    emit_load_bool(ACC, truebool, s);
+    emit_beq(r, T2, done, s);
+    emit_load_bool(ACC, falsebool, s);
+    emit_label_def(done, s);
+    return;
+  }
+
+  int t = code_operands(e1, e2, s);
+  int done = new_label();
+
+  emit_move(T2, ACC, s);
+  emit_temp_load(T1, t, s);
+
+  //
+  // Values with static type Int or Bool are never void, so with -O
+  // they are compared inline.  Strings of different lengths are
+  // unequal without a call.
+  //
+  if (cgen_optimize && type == Bool) {
+    emit_fetch_int(T1, T1, s);
+    emit_fetch_int(T2, T2, s);
+    emit_load_bool(ACC, truebool, s);
+    emit_beq(T1, T2, done, s);
+    emit_load_bool(ACC, falsebool, s);
+    emit_label_def(done, s);
+    return;
+  }
+
+  emit_load_bool(ACC, truebool, s);
+  emit_beq(T1, T2, done, s);
+  if (cgen_optimize && type == Str) {
+    int differ = new_label();
+    emit_string_lengths(s);
+    emit_bne(ACC, A1, differ, s);
+    emit_load_bool(ACC, truebool, s);
+    emit_load_bool(A1, falsebool, s);
+    emit_jal("equality_test", s);
+    emit_branch(done, s);
+    emit_label_def(differ, s);
+    emit_load_bool(ACC, falsebool, s);
+    emit_label_def(done, s);
+    return;
+  }
+  emit_load_bool(A1, falsebool, s);
+  emit_jal("equality_test", s);
+  emit_label_def(done, s);
+}
+
+//
+// equality_test hands back whichever of $a0 and $a1 it was given, so
+// plain 1 and 0 are enough to branch on.
+//
+void eq_class::code_branch(ostream &s, bool sense, int label) {
+  if (!cgen_optimize) {
+    Expression_class::code_branch(s, sense, label);
+    return;
+  }
+  Symbol type = e1->get_type();
+  if (type == Int) {
+    char *r = code_int_operands(e1, e2, s);
+    if (sense)
+      emit_beq(r, ACC, label, s);
+    else
+      emit_bne(r, ACC, label, s);
+    return;
+  }
+
+  int t = code_operands(e1, e2, s);
+  int done = sense ? label : new_label();
+  int differ = sense ? new_label() : label;
+
+  emit_move(T2, ACC, s);
+  emit_temp_load(T1, t, s);
+
+  if (type == Bool) {
+    emit_fetch_int(T1, T1, s);
+    emit_fetch_int(T2, T2, s);
+    if (sense)
+      emit_beq(T1, T2, label, s);
+    else
+      emit_bne(T1, T2, label, s);
+    return;
+  }
+
+  emit_beq(T1, T2, done, s);
+  if (type == Str) {
+    emit_string_lengths(s);
+    emit_bne(ACC, A1, differ, s);
+  }
+  emit_load_imm(ACC, 1, s);
+  emit_load_imm(A1, 0, s);
+  emit_jal("equality_test", s);
+  if (sense) {
+    emit_bne(ACC, ZERO, label, s);
+    if (type == Str)
+      emit_label_def(differ, s);
+  } else {
+    emit_beqz(ACC, label, s);
+    emit_label_def(done, s);
+  }
+}
+
+void leq_class::code(ostream &s) {
+  char *r1 = T1, *r2 = T2;
+
+  if (cgen_optimize) {
+    r1 = code_int_operands(e1, e2, s);
+    emit_move(r2, ACC, s);
+  } else {
+    int t = code_operands(e1, e2, s);
+    emit_temp_load(T1, t, s);
+    emit_fetch_int(T1, T1, s);
+    emit_fetch_int(T2, ACC, s);
+  }
+  int done = new_label();
+  emit_load_bool(ACC, truebool, s);
+  emit_bleq(r1, r2, done, s);
+  emit_load_bool(ACC, falsebool, s);
+  emit_label_def(done, s);
+}
+
+// a <= b is false when b < a
+void leq_class::code_branch(ostream &s, bool sense, int label) {
+  if (!cgen_optimize) {
+    Expression_class::code_branch(s, sense, label);
+    return;
+  }
+  char *r = code_int_operands(e1, e2, s);
+  if (sense)
+    emit_bleq(r, ACC, label, s);
+  else
+    emit_blt(ACC, r, label, s);
+}
+
+void comp_class::code(ostream &s) {
+  int done = new_label();
+
+  e1->code(s);
+  emit_fetch_int(T1, ACC, s);
+  emit_load_bool(ACC, truebool, s);
+  emit_beqz(T1, done, s);
+  emit_load_bool(ACC, falsebool, s);
+  emit_label_def(done, s);
+}
+
+void comp_class::code_branch(ostream &s, bool sense, int label) {
+  if (!cgen_optimize) {
+    Expression_class::code_branch(s, sense, label);
+    return;
+  }
+  e1->code_branch(s, !sense, label);
+}
+
+void int_const_class::code(ostream& s)  
+{
+  //
+  // Need to be sure we have an IntEntry *, not an arbitrary Symbol
   //
   emit_load_int(ACC,inttable.lookup_string(token->get_string()),s);
 }
@@ -946,16 +3201,866 @@ void bool_const_class::code(ostream& s)
   emit_load_bool(ACC, BoolConst(val), s);
 }
 
+void bool_const_class::code_branch(ostream &s, bool sense, int label) {
+  if (!cgen_optimize) {
+    Expression_class::code_branch(s, sense, label);
+    return;
+  }
+  if (val == sense)
+    emit_branch(label, s);
+}
+
+//
+// new SELF_TYPE finds the prototype and initializer of self's class
+// in class_objTab.
+//
 void new__class::code(ostream &s) {
+  if (type_name != SELF_TYPE) {
+    emit_load_label(ACC, protobj_label(type_name), s);
+    emit_call(method_label(Object, ::copy), s);
+    emit_gc_point(s);
+    emit_call(init_label(type_name), s);
+    emit_gc_point(s);
+    return;
+  }
+
+  emit_load_address(T1, CLASSOBJTAB, s);
+  emit_load(T2, TAG_OFFSET, self_reg, s);
+  emit_sll(T2, T2, 3, s);
+  emit_addu(T1, T1, T2, s);
+  emit_push(T1, s);
+  emit_load(ACC, 0, T1, s);
+  emit_call(method_label(Object, ::copy), s);
+  emit_gc_point(s);
+  emit_load(T1, 1, SP, s);
+  emit_addiu(SP, SP, WORD_SIZE, s);
+  emit_load(T1, 1, T1, s);
+  emit_jalr(T1, s);
+  emit_gc_point(s);
 }
 
 void isvoid_class::code(ostream &s) {
+  int done = new_label();
+
+  e1->code(s);
+  emit_move(T1, ACC, s);
+  emit_load_bool(ACC, truebool, s);
+  emit_beqz(T1, done, s);
+  emit_load_bool(ACC, falsebool, s);
+  emit_label_def(done, s);
+}
+
+void isvoid_class::code_branch(ostream &s, bool sense, int label) {
+  if (!cgen_optimize) {
+    Expression_class::code_branch(s, sense, label);
+    return;
+  }
+  e1->code(s);
+  if (sense)
+    emit_beqz(ACC, label, s);
+  else
+    emit_bne(ACC, ZERO, label, s);
 }
 
 void no_expr_class::code(ostream &s) {
 }
 
 void object_class::code(ostream &s) {
+  if (name == self)
+    emit_move(ACC, self_reg, s);
+  else
+    emit_var_load(ACC, lookup_var(name), s);
+}
+
+
+//******************************************************************
+//
+//   simplify() folds constant integer arithmetic and comparisons and
+//   removes arithmetic identities, returning the expression to use in
+//   place of this one.  It runs under -O before any code is emitted so
+//   that folded constants make it into the constant table.
+//
+//   Folding never hides a runtime error: sums, differences and
+//   negations that overflow (which trap in add, sub and neg) and
+//   division by zero are left alone, and operands are only dropped
+//   when evaluating them has no effect.  In particular ~~x is not x:
+//   the inner negation traps when x is the smallest Int.
+//
+//*****************************************************************
+
+void CgenNode::simplify()
+{
+  for (int i = features->first(); features->more(i); i = features->next(i))
+    features->nth(i)->simplify();
+}
+
+void method_class::simplify() { expr = expr->simplify(); }
+void attr_class::simplify() { init = init->simplify(); }
+void branch_class::simplify() { expr = expr->simplify(); }
+
+static Expressions simplify_all(Expressions es)
+{
+  Expressions result = nil_Expressions();
+  for (int i = es->first(); es->more(i); i = es->next(i))
+    result = append_Expressions(result, single_Expressions(es->nth(i)->simplify()));
+  return result;
+}
+
+static bool fits_int(long long value)
+{
+  return value >= INT_MIN && value <= INT_MAX;
+}
+
+static Expression int_result(int value, Expression e)
+{
+  Expression c = int_const(inttable.add_int(value));
+  c->set(e);
+  return c->set_type(Int);
+}
+
+static Expression bool_result(bool value, Expression e)
+{
+  Expression c = bool_const(value);
+  c->set(e);
+  return c->set_type(Bool);
 }
 
+static bool bool_const_value(Expression e, bool &value)
+{
+  bool_const_class *c = dynamic_cast<bool_const_class*>(e);
+  if (c == NULL)
+    return false;
+  value = c->val;
+  return true;
+}
+
+// evaluating e has no effect and cannot fail
+static bool is_pure(Expression e)
+{
+  return dynamic_cast<object_class*>(e) != NULL ||
+         dynamic_cast<int_const_class*>(e) != NULL ||
+         dynamic_cast<bool_const_class*>(e) != NULL ||
+         dynamic_cast<string_const_class*>(e) != NULL;
+}
+
+static bool same_variable(Expression a, Expression b)
+{
+  object_class *x = dynamic_cast<object_class*>(a);
+  object_class *y = dynamic_cast<object_class*>(b);
+  return x != NULL && y != NULL && x->name == y->name;
+}
+
+Expression assign_class::simplify()
+{
+  expr = expr->simplify();
+  return this;
+}
+
+Expression static_dispatch_class::simplify()
+{
+  expr = expr->simplify();
+  actual = simplify_all(actual);
+  return this;
+}
 
+Expression dispatch_class::simplify()
+{
+  expr = expr->simplify();
+  actual = simplify_all(actual);
+  return this;
+}
+
+Expression cond_class::simplify()
+{
+  pred = pred->simplify();
+  then_exp = then_exp->simplify();
+  else_exp = else_exp->simplify();
+  bool p;
+  if (bool_const_value(pred, p))
+    return p ? then_exp : else_exp;
+  return this;
+}
+
+Expression loop_class::simplify()
+{
+  pred = pred->simplify();
+  body = body->simplify();
+  return this;
+}
+
+Expression typcase_class::simplify()
+{
+  expr = expr->simplify();
+  for (int i = cases->first(); cases->more(i); i = cases->next(i))
+    cases->nth(i)->simplify();
+  return this;
+}
+
+Expression block_class::simplify()
+{
+  body = simplify_all(body);
+  return this;
+}
+
+Expression let_class::simplify()
+{
+  init = init->simplify();
+  body = body->simplify();
+  return this;
+}
+
+Expression plus_class::simplify()
+{
+  e1 = e1->simplify();
+  e2 = e2->simplify();
+  int a, b;
+  bool c1 = int_const_value(e1, a), c2 = int_const_value(e2, b);
+  if (c1 && c2 && fits_int((long long) a + b))
+    return int_result(a + b, this);
+  if (c2 && b == 0)
+    return e1;
+  if (c1 && a == 0)
+    return e2;
+  return this;
+}
+
+Expression sub_class::simplify()
+{
+  e1 = e1->simplify();
+  e2 = e2->simplify();
+  int a, b;
+  bool c1 = int_const_value(e1, a), c2 = int_const_value(e2, b);
+  if (c1 && c2 && fits_int((long long) a - b))
+    return int_result(a - b, this);
+  if (c2 && b == 0)
+    return e1;
+  if (same_variable(e1, e2))
+    return int_result(0, this);
+  return this;
+}
+
+// mul wraps around, so any product can be folded
+Expression mul_class::simplify()
+{
+  e1 = e1->simplify();
+  e2 = e2->simplify();
+  int a, b;
+  bool c1 = int_const_value(e1, a), c2 = int_const_value(e2, b);
+  if (c1 && c2)
+    return int_result((int) ((unsigned) a * (unsigned) b), this);
+  if (c2 && b == 1)
+    return e1;
+  if (c1 && a == 1)
+    return e2;
+  if ((c2 && b == 0 && is_pure(e1)) || (c1 && a == 0 && is_pure(e2)))
+    return int_result(0, this);
+  return this;
+}
+
+Expression divide_class::simplify()
+{
+  e1 = e1->simplify();
+  e2 = e2->simplify();
+  int a, b;
+  bool c1 = int_const_value(e1, a), c2 = int_const_value(e2, b);
+  if (c1 && c2 && b != 0 && !(a == INT_MIN && b == -1))
+    return int_result(a / b, this);
+  if (c2 && b == 1)
+    return e1;
+  return this;
+}
+
+Expression neg_class::simplify()
+{
+  e1 = e1->simplify();
+  int a;
+  if (int_const_value(e1, a) && a != INT_MIN)
+    return int_result(-a, this);
+  return this;
+}
+
+Expression lt_class::simplify()
+{
+  e1 = e1->simplify();
+  e2 = e2->simplify();
+  int a, b;
+  if (int_const_value(e1, a) && int_const_value(e2, b))
+    return bool_result(a < b, this);
+  return this;
+}
+
+Expression eq_class::simplify()
+{
+  e1 = e1->simplify();
+  e2 = e2->simplify();
+  int a, b;
+  bool p, q;
+  if (int_const_value(e1, a) && int_const_value(e2, b))
+    return bool_result(a == b, this);
+  if (bool_const_value(e1, p) && bool_const_value(e2, q))
+    return bool_result(p == q, this);
+  return this;
+}
+
+Expression leq_class::simplify()
+{
+  e1 = e1->simplify();
+  e2 = e2->simplify();
+  int a, b;
+  if (int_const_value(e1, a) && int_const_value(e2, b))
+    return bool_result(a <= b, this);
+  return this;
+}
+
+Expression comp_class::simplify()
+{
+  e1 = e1->simplify();
+  bool p;
+  if (bool_const_value(e1, p))
+    return bool_result(!p, this);
+  comp_class *inner = dynamic_cast<comp_class*>(e1);
+  if (inner != NULL)
+    return inner->e1;
+  return this;
+}
+
+Expression isvoid_class::simplify()
+{
+  e1 = e1->simplify();
+  return this;
+}
+
+Expression int_const_class::simplify() { return this; }
+Expression string_const_class::simplify() { return this; }
+Expression bool_const_class::simplify() { return this; }
+Expression new__class::simplify() { return this; }
+Expression no_expr_class::simplify() { return this; }
+Expression object_class::simplify() { return this; }
+
+
+//******************************************************************
+//
+//   numberValues() runs under -O before a method is coded.  It walks
+//   the body in evaluation order, keeping the pure integer arithmetic
+//   (+ - * / ~ over variables and constants) already evaluated on
+//   every path, and marks an evaluation that repeats one of these as
+//   reused.  The first evaluation then keeps its value in a temporary
+//   of the frame and later ones load it from there.
+//
+//   A value is forgotten when a variable it reads is assigned or
+//   rebound, and when a call or new runs code that may assign
+//   attributes.  At the join after if and case only the values kept
+//   by every branch survive; a loop keeps only what its body and
+//   predicate do not kill.
+//
+//*****************************************************************
+
+// loops enclosing the point of the walk, outermost first
+static thread_local std::vector<LoopKills> loops;
+
+//
+// valueKey() gives the form of a pure integer expression, "" if it is
+// not one, and adds the variables it reads to vars.
+//
+static std::string value_key(const char *op, Expression a, Expression b,
+                             std::vector<Symbol> &vars)
+{
+  std::string k1 = a->valueKey(vars);
+  std::string k2 = b == NULL ? "" : b->valueKey(vars);
+  if (k1.empty() || (b != NULL && k2.empty()))
+    return "";
+  return std::string("(") + op + " " + k1 + (b == NULL ? "" : " " + k2) + ")";
+}
+
+std::string plus_class::valueKey(std::vector<Symbol> &vars)
+{ return value_key("+", e1, e2, vars); }
+std::string sub_class::valueKey(std::vector<Symbol> &vars)
+{ return value_key("-", e1, e2, vars); }
+std::string mul_class::valueKey(std::vector<Symbol> &vars)
+{ return value_key("*", e1, e2, vars); }
+std::string divide_class::valueKey(std::vector<Symbol> &vars)
+{ return value_key("/", e1, e2, vars); }
+std::string neg_class::valueKey(std::vector<Symbol> &vars)
+{ return value_key("~", e1, NULL, vars); }
+
+std::string int_const_class::valueKey(std::vector<Symbol> &)
+{
+  return std::string("#") + token->get_string();
+}
+
+std::string object_class::valueKey(std::vector<Symbol> &vars)
+{
+  if (name == self)
+    return "self";
+  vars.push_back(name);
+  return name->get_string();
+}
+
+bool ValueNumbering::reuse(Expression e)
+{
+  std::vector<Symbol> vars;
+  std::map<std::string, AvailValue>::iterator i = avail.find(e->valueKey(vars));
+  if (i == avail.end())
+    return false;
+  if (!dry) {
+    Expression def = i->second.def;
+    if (value_slot.find(def) == value_slot.end())
+      value_slot[def] = value_slots++;
+    reused_slot[e] = value_slot[def];
+  }
+  return true;
+}
+
+//
+// An evaluation that reads nothing its loop changes is kept the first
+// time round the outermost such loop.  Evaluating it where it stands
+// rather than before the loop keeps any overflow or division by zero
+// where the program would meet it.
+//
+bool ValueNumbering::invariant(Expression e)
+{
+  std::vector<Symbol> vars;
+  if (dry || e->valueKey(vars).empty())
+    return false;
+  for (size_t i = 0; i < loops.size(); i++) {
+    bool changed = false;
+    for (size_t j = 0; j < vars.size(); j++) {
+      std::vector<Symbol> &killed = loops[i].vars;
+      if (std::find(killed.begin(), killed.end(), vars[j]) != killed.end() ||
+          (locals[vars[j]] == 0 && loops[i].calls))
+        changed = true;
+    }
+    if (!changed) {
+      invariant_slot[e] = value_slots;
+      loop_slots[loops[i].loop].push_back(value_slots++);
+      return true;
+    }
+  }
+  return false;
+}
+
+void ValueNumbering::add(Expression e)
+{
+  AvailValue v;
+  v.def = e;
+  std::string key = e->valueKey(v.vars);
+  if (!key.empty())
+    avail[key] = v;
+}
+
+void ValueNumbering::kill(Symbol name)
+{
+  if (kills != NULL)
+    kills->vars.push_back(name);
+  std::map<std::string, AvailValue>::iterator i = avail.begin();
+  while (i != avail.end()) {
+    std::vector<Symbol> &vars = i->second.vars;
+    if (std::find(vars.begin(), vars.end(), name) != vars.end())
+      avail.erase(i++);
+    else
+      ++i;
+  }
+}
+
+void ValueNumbering::killAttrs()
+{
+  if (kills != NULL)
+    kills->calls = true;
+  std::map<std::string, AvailValue>::iterator i = avail.begin();
+  while (i != avail.end()) {
+    std::vector<Symbol> &vars = i->second.vars;
+    bool attr = false;
+    for (size_t j = 0; j < vars.size(); j++)
+      if (locals[vars[j]] == 0)
+        attr = true;
+    if (attr)
+      avail.erase(i++);
+    else
+      ++i;
+  }
+}
+
+void ValueNumbering::meet(const ValueNumbering &other)
+{
+  std::map<std::string, AvailValue>::iterator i = avail.begin();
+  while (i != avail.end()) {
+    std::map<std::string, AvailValue>::const_iterator j = other.avail.find(i->first);
+    if (j == other.avail.end() || j->second.def != i->second.def)
+      avail.erase(i++);
+    else
+      ++i;
+  }
+}
+
+// the number of temporaries needed to keep reused values
+static int number_values(Expression body, Formals formals)
+{
+  if (!cgen_optimize)
+    return 0;
+  value_slots = 0;
+  ValueNumbering vn;
+  for (int i = formals->first(); formals->more(i); i = formals->next(i))
+    vn.bind(formals->nth(i)->getName());
+  body->numberValues(vn);
+  return value_slots;
+}
+
+static void number_values(Expressions es, ValueNumbering &vn)
+{
+  for (int i = es->first(); es->more(i); i = es->next(i))
+    es->nth(i)->numberValues(vn);
+}
+
+void assign_class::numberValues(ValueNumbering &vn)
+{
+  expr->numberValues(vn);
+  vn.kill(name);
+}
+
+// arguments are evaluated before the receiver
+void static_dispatch_class::numberValues(ValueNumbering &vn)
+{
+  number_values(actual, vn);
+  expr->numberValues(vn);
+  vn.killAttrs();
+}
+
+void dispatch_class::numberValues(ValueNumbering &vn)
+{
+  number_values(actual, vn);
+  expr->numberValues(vn);
+  vn.killAttrs();
+}
+
+void cond_class::numberValues(ValueNumbering &vn)
+{
+  pred->numberValues(vn);
+  ValueNumbering then_vn = vn, else_vn = vn;
+  then_exp->numberValues(then_vn);
+  else_exp->numberValues(else_vn);
+  vn.meet(then_vn);
+  vn.meet(else_vn);
+}
+
+void loop_class::numberValues(ValueNumbering &vn)
+{
+  LoopKills loop_kills(this);
+  ValueNumbering loop_vn = vn;
+  loop_vn.dry = true;
+  loop_vn.kills = &loop_kills;
+  pred->numberValues(loop_vn);
+  body->numberValues(loop_vn);
+  vn.meet(loop_vn);
+
+  if (!vn.dry)
+    loops.push_back(loop_kills);
+  pred->numberValues(vn);
+  ValueNumbering body_vn = vn;
+  body->numberValues(body_vn);
+  if (!vn.dry)
+    loops.pop_back();
+}
+
+void typcase_class::numberValues(ValueNumbering &vn)
+{
+  expr->numberValues(vn);
+  ValueNumbering after = vn;
+  for (int i = cases->first(); cases->more(i); i = cases->next(i)) {
+    branch_class *b = static_cast<branch_class*>(cases->nth(i));
+    ValueNumbering branch_vn = vn;
+    branch_vn.bind(b->getName());
+    b->getExpr()->numberValues(branch_vn);
+    branch_vn.unbind(b->getName());
+    after.meet(branch_vn);
+  }
+  vn = after;
+}
+
+void block_class::numberValues(ValueNumbering &vn) { number_values(body, vn); }
+
+void let_class::numberValues(ValueNumbering &vn)
+{
+  init->numberValues(vn);
+  vn.bind(identifier);
+  body->numberValues(vn);
+  vn.unbind(identifier);
+}
+
+static void number_arith(Expression e, Expression e1, Expression e2,
+                         ValueNumbering &vn)
+{
+  if (vn.reuse(e) || vn.invariant(e))
+    return;
+  e1->numberValues(vn);
+  if (e2 != NULL)
+    e2->numberValues(vn);
+  vn.add(e);
+}
+
+void plus_class::numberValues(ValueNumbering &vn) { number_arith(this, e1, e2, vn); }
+void sub_class::numberValues(ValueNumbering &vn) { number_arith(this, e1, e2, vn); }
+void mul_class::numberValues(ValueNumbering &vn) { number_arith(this, e1, e2, vn); }
+void divide_class::numberValues(ValueNumbering &vn) { number_arith(this, e1, e2, vn); }
+void neg_class::numberValues(ValueNumbering &vn) { number_arith(this, e1, NULL, vn); }
+
+void lt_class::numberValues(ValueNumbering &vn)
+{
+  e1->numberValues(vn);
+  e2->numberValues(vn);
+}
+
+void eq_class::numberValues(ValueNumbering &vn)
+{
+  e1->numberValues(vn);
+  e2->numberValues(vn);
+}
+
+void leq_class::numberValues(ValueNumbering &vn)
+{
+  e1->numberValues(vn);
+  e2->numberValues(vn);
+}
+
+void comp_class::numberValues(ValueNumbering &vn) { e1->numberValues(vn); }
+void isvoid_class::numberValues(ValueNumbering &vn) { e1->numberValues(vn); }
+
+// the initializer of the new object may assign attributes of others
+void new__class::numberValues(ValueNumbering &vn) { vn.killAttrs(); }
+
+void int_const_class::numberValues(ValueNumbering &) { }
+void string_const_class::numberValues(ValueNumbering &) { }
+void bool_const_class::numberValues(ValueNumbering &) { }
+void no_expr_class::numberValues(ValueNumbering &) { }
+void object_class::numberValues(ValueNumbering &) { }
+
+//******************************************************************
+//
+//   numTemps() is the number of temporaries an expression needs in
+//   the frame of its method.  hasCall() is true if evaluating it may
+//   jump to code that returns through $ra; methods whose body has no
+//   such call are compiled as leaves under -O.
+//
+//*****************************************************************
+
+static int max_temps(Expressions es)
+{
+  int n = 0;
+  for (int i = es->first(); es->more(i); i = es->next(i))
+    n = std::max(n, es->nth(i)->numTemps());
+  return n;
+}
+
+// held register arguments take a temporary each until the call
+static int dispatch_temps(Expression expr, Expressions actual, int nregs)
+{
+  int nheld = held_args(expr, actual, nregs);
+  int n = nheld + expr->numTemps();
+  for (int i = actual->first(); actual->more(i); i = actual->next(i))
+    n = std::max(n, std::min(i, nheld) + actual->nth(i)->numTemps());
+  return n;
+}
+
+static bool any_call(Expressions es)
+{
+  for (int i = es->first(); es->more(i); i = es->next(i))
+    if (es->nth(i)->hasCall())
+      return true;
+  return false;
+}
+
+int assign_class::numTemps() { return expr->numTemps(); }
+int static_dispatch_class::numTemps()
+{
+  CgenNodeP nd = codegen_classtable->lookupClass(type_name, curr_class);
+  return dispatch_temps(expr, actual, reg_args(nd, name, actual->len()));
+}
+int dispatch_class::numTemps()
+{
+  CgenNodeP nd = codegen_classtable->lookupClass(expr->get_type(), curr_class);
+  return dispatch_temps(expr, actual, reg_args(nd, name, actual->len()));
+}
+int cond_class::numTemps()
+{
+  return std::max(pred->numTemps(), std::max(then_exp->numTemps(), else_exp->numTemps()));
+}
+int loop_class::numTemps() { return std::max(pred->numTemps(), body->numTemps()); }
+int typcase_class::numTemps()
+{
+  int n = 0;
+  for (int i = cases->first(); cases->more(i); i = cases->next(i))
+    n = std::max(n, static_cast<branch_class*>(cases->nth(i))->getExpr()->numTemps());
+  return std::max(expr->numTemps(), 1 + n);
+}
+int block_class::numTemps() { return max_temps(body); }
+int let_class::numTemps() { return std::max(init->numTemps(), 1 + body->numTemps()); }
+int plus_class::numTemps() { return std::max(e1->numTemps(), 1 + e2->numTemps()); }
+int sub_class::numTemps() { return std::max(e1->numTemps(), 1 + e2->numTemps()); }
+int mul_class::numTemps() { return std::max(e1->numTemps(), 1 + e2->numTemps()); }
+int divide_class::numTemps() { return std::max(e1->numTemps(), 1 + e2->numTemps()); }
+int neg_class::numTemps() { return e1->numTemps(); }
+int lt_class::numTemps() { return std::max(e1->numTemps(), 1 + e2->numTemps()); }
+int eq_class::numTemps() { return std::max(e1->numTemps(), 1 + e2->numTemps()); }
+int leq_class::numTemps() { return std::max(e1->numTemps(), 1 + e2->numTemps()); }
+int comp_class::numTemps() { return e1->numTemps(); }
+int int_const_class::numTemps() { return 0; }
+int string_const_class::numTemps() { return 0; }
+int bool_const_class::numTemps() { return 0; }
+int new__class::numTemps() { return 0; }
+int isvoid_class::numTemps() { return e1->numTemps(); }
+int no_expr_class::numTemps() { return 0; }
+int object_class::numTemps() { return 0; }
+
+// assignments to attributes go through _GenGC_Assign when GC is on
+bool assign_class::hasCall() { return needs_barrier(expr, false) || expr->hasCall(); }
+bool static_dispatch_class::hasCall() { return true; }
+bool dispatch_class::hasCall() { return true; }
+bool cond_class::hasCall()
+{
+  return pred->hasCall() || then_exp->hasCall() || else_exp->hasCall();
+}
+bool loop_class::hasCall() { return pred->hasCall() || body->hasCall(); }
+bool typcase_class::hasCall()
+{
+  for (int i = cases->first(); cases->more(i); i = cases->next(i))
+    if (static_cast<branch_class*>(cases->nth(i))->getExpr()->hasCall())
+      return true;
+  return expr->hasCall();
+}
+bool block_class::hasCall() { return any_call(body); }
+bool let_class::hasCall() { return init->hasCall() || body->hasCall(); }
+bool plus_class::hasCall() { return true; }
+bool sub_class::hasCall() { return true; }
+bool mul_class::hasCall() { return true; }
+bool divide_class::hasCall() { return true; }
+bool neg_class::hasCall() { return true; }
+bool lt_class::hasCall() { return e1->hasCall() || e2->hasCall(); }
+bool eq_class::hasCall()
+{
+  Symbol type = e1->get_type();
+  if (cgen_optimize && (type == Int || type == Bool))
+    return e1->hasCall() || e2->hasCall();
+  return true;
+}
+bool leq_class::hasCall() { return e1->hasCall() || e2->hasCall(); }
+bool comp_class::hasCall() { return e1->hasCall(); }
+bool int_const_class::hasCall() { return false; }
+bool string_const_class::hasCall() { return false; }
+bool bool_const_class::hasCall() { return false; }
+bool new__class::hasCall() { return true; }
+bool isvoid_class::hasCall() { return e1->hasCall(); }
+bool no_expr_class::hasCall() { return false; }
+bool object_class::hasCall() { return false; }
+
+// evaluated unboxed, arithmetic only calls if its operands do
+bool plus_class::intHasCall()
+{
+  return unboxed(this) ? e1->intHasCall() || e2->intHasCall() : hasCall();
+}
+bool sub_class::intHasCall()
+{
+  return unboxed(this) ? e1->intHasCall() || e2->intHasCall() : hasCall();
+}
+bool mul_class::intHasCall()
+{
+  return unboxed(this) ? e1->intHasCall() || e2->intHasCall() : hasCall();
+}
+bool divide_class::intHasCall()
+{
+  return unboxed(this) ? e1->intHasCall() || e2->intHasCall() : hasCall();
+}
+bool neg_class::intHasCall() { return unboxed(this) ? e1->intHasCall() : hasCall(); }
+
+//******************************************************************
+//
+//   countUses() adds the static uses of attributes in an expression
+//   to uses (see CgenNode::orderAttrs).
+//
+//*****************************************************************
+
+void AttrUses::use(Symbol name)
+{
+  std::map<Symbol, int>::iterator l = locals.find(name);
+  if (name == self || (l != locals.end() && l->second > 0))
+    return;
+  int weight = 1;
+  for (int i = 0; i < loops && i < 8; i++)
+    weight *= LOOP_WEIGHT;
+  counts[name] += weight;
+}
+
+static void count_uses(Expressions es, AttrUses &uses)
+{
+  for (int i = es->first(); es->more(i); i = es->next(i))
+    es->nth(i)->countUses(uses);
+}
+
+void assign_class::countUses(AttrUses &uses)
+{
+  uses.use(name);
+  expr->countUses(uses);
+}
+
+void static_dispatch_class::countUses(AttrUses &uses)
+{
+  expr->countUses(uses);
+  count_uses(actual, uses);
+}
+
+void dispatch_class::countUses(AttrUses &uses)
+{
+  expr->countUses(uses);
+  count_uses(actual, uses);
+}
+
+void cond_class::countUses(AttrUses &uses)
+{
+  pred->countUses(uses);
+  then_exp->countUses(uses);
+  else_exp->countUses(uses);
+}
+
+void loop_class::countUses(AttrUses &uses)
+{
+  uses.enterLoop();
+  pred->countUses(uses);
+  body->countUses(uses);
+  uses.exitLoop();
+}
+
+void typcase_class::countUses(AttrUses &uses)
+{
+  expr->countUses(uses);
+  for (int i = cases->first(); cases->more(i); i = cases->next(i)) {
+    branch_class *b = static_cast<branch_class*>(cases->nth(i));
+    uses.bind(b->getName());
+    b->getExpr()->countUses(uses);
+    uses.unbind(b->getName());
+  }
+}
+
+void block_class::countUses(AttrUses &uses) { count_uses(body, uses); }
+
+void let_class::countUses(AttrUses &uses)
+{
+  init->countUses(uses);
+  uses.bind(identifier);
+  body->countUses(uses);
+  uses.unbind(identifier);
+}
+
+void plus_class::countUses(AttrUses &uses) { e1->countUses(uses); e2->countUses(uses); }
+void sub_class::countUses(AttrUses &uses) { e1->countUses(uses); e2->countUses(uses); }
+void mul_class::countUses(AttrUses &uses) { e1->countUses(uses); e2->countUses(uses); }
+void divide_class::countUses(AttrUses &uses) { e1->countUses(uses); e2->countUses(uses); }
+void neg_class::countUses(AttrUses &uses) { e1->countUses(uses); }
+void lt_class::countUses(AttrUses &uses) { e1->countUses(uses); e2->countUses(uses); }
+void eq_class::countUses(AttrUses &uses) { e1->countUses(uses); e2->countUses(uses); }
+void leq_class::countUses(AttrUses &uses) { e1->countUses(uses); e2->countUses(uses); }
+void comp_class::countUses(AttrUses &uses) { e1->countUses(uses); }
+void int_const_class::countUses(AttrUses &) { }
+void string_const_class::countUses(AttrUses &) { }
+void bool_const_class::countUses(AttrUses &) { }
+void new__class::countUses(AttrUses &) { }
+void isvoid_class::countUses(AttrUses &uses) { e1->countUses(uses); }
+void no_expr_class::countUses(AttrUses &) { }
+void object_class::countUses(AttrUses &uses) { uses.use(name); }
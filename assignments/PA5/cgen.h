@@ -1,5 +1,8 @@
 #include <assert.h>
 #include <stdio.h>
+#include <vector>
+#include <string>
+#include <map>
 #include "emit.h"
 #include "cool-tree.h"
 #include "symtab.h"
@@ -15,7 +18,7 @@ class CgenNode;
 typedef CgenNode *CgenNodeP;
 
 class CgenClassTable : public SymbolTable<Symbol,CgenNode> {
-private:
+protected:
    List<CgenNode> *nds;
    ostream& str;
    int stringclasstag;
@@ -29,8 +32,21 @@ private:
    void code_global_data();
    void code_global_text();
    void code_bools(int);
+   void code_int_cache(int);
    void code_select_gc();
    void code_constants();
+   void code_class_nametab();
+   void code_class_objtab();
+   void code_dispatch_tables();
+   void code_compact_dispatch_tables();
+   void code_prototypes();
+   void code_inits(ostream&);
+   void code_methods(ostream&);
+   void code_classes(AsmBuffer&);
+   void code_stack_maps(AsmBuffer&);
+   void code_profile_counters();
+   void code_profile_dump();
+   void code_inline_caches();
 
 // The following creates an inheritance graph from
 // a list of classes.  The graph is implemented as
@@ -42,12 +58,84 @@ private:
    void install_classes(Classes cs);
    void build_inheritance_tree();
    void set_relations(CgenNodeP nd);
+
+// Classes in tag order; a class's tag is its index here.
+   std::vector<CgenNodeP> tag_order;
 public:
    CgenClassTable(Classes, ostream& str);
-   void code();
+   virtual ~CgenClassTable() { }
+   virtual void code();
    CgenNodeP root();
+   CgenNodeP lookupClass(Symbol type, CgenNodeP curr);
+   CgenNodeP lookupTag(int tag) { return tag_order[tag]; }
+};
+
+
+//
+// Where a variable lives: an attribute of self, a formal parameter
+// passed on the stack, one of the temporaries of the current method
+// (let and case bindings, spilled register arguments), or an argument
+// register that a leaf method never spills.
+//
+enum VarKind { VarAttr, VarFormal, VarTemp, VarArgReg };
+
+struct VarLoc {
+  VarKind kind;
+  int index;
+  bool used;                        // referenced by the code emitted so far
+  VarLoc(VarKind k, int i) : kind(k), index(i), used(false) { }
+};
+
+
+//
+// Static counts of the uses of attributes, for laying them out: the
+// reads and assignments of names that are not bound to a formal or a
+// let or case variable there, each counting LOOP_WEIGHT times more for
+// every loop around it.
+//
+#define LOOP_WEIGHT 8
+
+class AttrUses {
+  std::map<Symbol, int> locals;     // bindings in scope of each name
+  int loops;                        // loops around the walk
+
+public:
+  std::map<Symbol, int> counts;
+
+  AttrUses() : loops(0) { }
+  void use(Symbol name);
+  void bind(Symbol name) { locals[name]++; }
+  void unbind(Symbol name) { locals[name]--; }
+  void enterLoop() { loops++; }
+  void exitLoop() { loops--; }
 };
 
+//
+// Slot numbers by name, for the attribute offsets and dispatch table
+// slots of a class: an open-addressed hash table in one array.
+//
+class SlotTable {
+  std::vector<std::pair<Symbol, int> > slots;   // power of two; empty if NULL
+  int count;
+
+  size_t home(Symbol name) const
+  { return (((size_t) name >> 4) * 2654435761u) & (slots.size() - 1); }
+
+public:
+  SlotTable() : count(0) { }
+  void set(Symbol name, int slot);
+
+  // -1 if there is no slot called name
+  int lookup(Symbol name) const
+  {
+    if (slots.empty())
+      return -1;
+    for (size_t i = home(name); slots[i].first; i = (i + 1) & (slots.size() - 1))
+      if (slots[i].first == name)
+        return slots[i].second;
+    return -1;
+  }
+};
 
 class CgenNode : public class__class {
 private: 
@@ -55,6 +143,17 @@ private:
    List<CgenNode> *children;                  // Children of class
    Basicness basic_status;                    // `Basic' if class is basic
                                               // `NotBasic' otherwise
+   int tag;                                   // class tag (preorder number)
+   int max_tag;                               // largest tag in the subtree
+   std::vector<attr_class *> attrs;           // all attributes, inherited first
+   std::vector<method_class *> methods;       // dispatch table slots
+   std::vector<Symbol> method_owners;         // class defining each slot
+   SlotTable attr_slots;                      // attribute name: index in attrs
+   SlotTable method_slots;                    // method name: index in methods
+   int size;                                  // object size in words
+   std::map<Symbol, int> attr_uses;           // static uses, by this class
+                                              // and its descendants (-O)
+   void orderAttrs(std::vector<attr_class *> &own);
 
 public:
    CgenNode(Class_ c,
@@ -66,6 +165,31 @@ public:
    void set_parentnd(CgenNodeP p);
    CgenNodeP get_parentnd() { return parentnd; }
    int basic() { return (basic_status == Basic); }
+
+   void setTags(int &next, std::vector<CgenNodeP> &order);
+   void countAttrUses();
+   void buildLayout();
+   int getTag() { return tag; }
+   int getMaxTag() { return max_tag; }
+   int numAttrs() { return attrs.size(); }
+   attr_class *getAttr(int i) { return attrs[i]; }
+   int attrOffset(Symbol name) { return attr_slots.lookup(name); }
+   int numMethods() { return methods.size(); }
+   method_class *getMethod(int i) { return methods[i]; }
+   Symbol getMethodOwner(int i) { return method_owners[i]; }
+   int methodOffset(Symbol name) { return method_slots.lookup(name); }
+   int getSize() { return size; }
+   bool initMayCollect();
+   bool hasTrivialInit();
+   void simplify();
+   void code_init(ostream&);
+   void code_methods(ostream&);
+   void code_x86_init(ostream&);
+   void code_x86_methods(ostream&);
+   void code_c_init(ostream&);
+   void code_c_methods(ostream&);
+   void code_bc_init(BcCode&);
+   void code_bc_methods();
 };
 
 class BoolConst 
@@ -76,5 +200,60 @@ class BoolConst
   BoolConst(int);
   void code_def(ostream&, int boolclasstag);
   void code_ref(ostream&) const;
+  int code_label() const;
 };
 
+
+//
+// The x86-64 back end (cgen -m x86-64, see cgen_x86.cc) builds the same
+// class tree, tags and layouts and emits code for them in its own way.
+//
+class X86ClassTable : public CgenClassTable {
+private:
+   void code_global_data();
+   void code_constants();
+   void code_class_nametab();
+   void code_class_objtab();
+   void code_dispatch_tables();
+   void code_prototypes();
+   void code_inits();
+   void code_methods();
+public:
+   X86ClassTable(Classes classes, ostream& str) : CgenClassTable(classes, str) { }
+   void code();
+};
+
+
+//
+// The C back end (cgen -m c, see cgen_c.cc) translates the same class
+// tree to a C program.
+//
+class CClassTable : public CgenClassTable {
+private:
+   void code_structs();
+   void code_declarations();
+   void code_dispatch_tables();
+   void code_constants();
+   void code_prototypes();
+   void code_class_table();
+   void code_functions();
+public:
+   CClassTable(Classes classes, ostream& str) : CgenClassTable(classes, str) { }
+   void code();
+};
+
+
+//
+// The bytecode back end (cgen -m bytecode, see cgen_bc.cc) lowers the
+// same class tree to the bytecode run by lib/vm/coolvm.
+//
+class BytecodeClassTable : public CgenClassTable {
+private:
+   void code_strings();
+   void number_functions();
+   void code_classes();
+   void code_functions();
+public:
+   BytecodeClassTable(Classes classes, ostream& str) : CgenClassTable(classes, str) { }
+   void code();
+};
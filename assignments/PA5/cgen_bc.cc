@@ -0,0 +1,839 @@
+
+//**************************************************************
+//
+// Bytecode generator
+//
+// With -m bytecode, cgen lowers the typed AST to the compact bytecode
+// of lib/vm/bytecode.h instead of assembly, and the virtual machine in
+// lib/vm runs it at once, without an assembler or simulator:
+//
+//     cgen -m bytecode -o foo.bc < foo.ast
+//     coolvm foo.bc
+//
+// Classes keep the tags, attribute layouts and dispatch table slots of
+// the MIPS code.  Each initializer and method becomes a function with
+// two files of registers, one of references and one of ints; as in the
+// C back end, values of static type Int or Bool are held unboxed in int
+// registers and boxed only where they are used as an Object.
+//
+// An expression leaves its value in a register and returns its operand
+// (the register number times two, plus one for an int register).  A
+// variable is read straight from its own register, which is copied
+// only if a later operand of the same expression might assign it.
+//
+//**************************************************************
+
+#include <algorithm>
+#include <map>
+#include <set>
+#include <stdlib.h>
+#include "cgen.h"
+#include "cgen_gc.h"
+#include "bytecode.h"
+
+extern int cgen_debug;
+
+extern Symbol Bool, Int, Str, Main, main_meth, Object, self, SELF_TYPE;
+
+extern thread_local CgenNodeP curr_class;  // shared with numTemps() in cgen.cc
+
+//
+// How a value of some static type is held.
+//
+enum BcRep { BcRef, BcInt, BcBool };
+
+// A variable in scope: its register, or the attribute of self.
+struct BcVar {
+  int operand;
+  bool attr;
+  BcRep rep;
+  BcVar(int o, bool a, BcRep r) : operand(o), attr(a), rep(r) { }
+};
+
+// A function of the program, as it is written out.
+struct BcFunction {
+  std::string name;
+  Symbol file;
+  int native;
+  int nref, nint;                   // registers
+  int nref_formals, nint_formals;
+  BcCode code;
+};
+
+//
+// State of the code generator.
+//
+static CgenClassTableP bc_classtable = NULL;
+static SymbolTable<Symbol,BcVar> *bc_env = NULL;
+static std::map<StringEntry*,int> bc_strings;     // index of each constant
+static std::map<Symbol,int> bc_inits;             // function of X_init
+static std::map<std::pair<Symbol,Symbol>,int> bc_methods;   // of X.m
+static std::vector<BcFunction> bc_functions;
+static std::set<int> bc_homes;      // operands holding variables
+static int next_ref;                // registers used by the function
+static int next_int;
+
+static const int SELF_OPERAND = 0;  // reference register 0
+
+static const char *native_names[] = {
+#define BC_NATIVE_NAME(name, method) method,
+  "", BC_NATIVES(BC_NATIVE_NAME)
+#undef BC_NATIVE_NAME
+};
+
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  Helpers
+//
+//////////////////////////////////////////////////////////////////////////////
+
+static BcRep rep(Symbol type)
+{
+  if (type == Int)
+    return BcInt;
+  if (type == Bool)
+    return BcBool;
+  return BcRef;
+}
+
+static int operand(int reg, BcRep r)
+{
+  return reg << 1 | (r != BcRef);
+}
+
+static int reg(int v)
+{
+  return v >> 1;
+}
+
+static bool is_int(int v)
+{
+  return v & 1;
+}
+
+static int new_temp(BcRep r)
+{
+  if (r == BcRef)
+    return operand(next_ref++, r);
+  return operand(next_int++, r);
+}
+
+static int new_home(BcRep r)
+{
+  int v = new_temp(r);
+  bc_homes.insert(v);
+  return v;
+}
+
+static void emit(BcCode &c, int op)
+{  c.push_back(op); }
+
+static void emit(BcCode &c, int op, int a)
+{  c.push_back(op); c.push_back(a); }
+
+static void emit(BcCode &c, int op, int a, int b)
+{  c.push_back(op); c.push_back(a); c.push_back(b); }
+
+static void emit(BcCode &c, int op, int a, int b, int d)
+{  c.push_back(op); c.push_back(a); c.push_back(b); c.push_back(d); }
+
+static void emit(BcCode &c, int op, int a, int b, int d, int e)
+{  c.push_back(op); c.push_back(a); c.push_back(b); c.push_back(d); c.push_back(e); }
+
+static void emit(BcCode &c, int op, int a, int b, int d, int e, int f)
+{  emit(c, op, a, b, d, e); c.push_back(f); }
+
+// the jump target just emitted, to be set by patch
+static int jump_operand(BcCode &c)
+{
+  return c.size() - 1;
+}
+
+static void patch(BcCode &c, int at)
+{
+  c[at] = c.size();
+}
+
+static void emit_move(int to, int from, BcCode &c)
+{
+  if (to != from)
+    emit(c, is_int(to) ? BC_MOVI : BC_MOVR, reg(to), reg(from));
+}
+
+static int string_index(const char *s)
+{
+  return bc_strings[stringtable.lookup_string((char *) s)];
+}
+
+static int load_default(Symbol type, BcCode &c)
+{
+  int t = new_temp(rep(type));
+  if (type == Int || type == Bool)
+    emit(c, BC_LDI, reg(t), 0);
+  else if (type == Str)
+    emit(c, BC_LDS, reg(t), string_index(""));
+  else
+    emit(c, BC_LDNULL, reg(t));
+  return t;
+}
+
+//
+// The value v, held as from, held as to instead.
+//
+static int coerce(int v, BcRep from, BcRep to, BcCode &c)
+{
+  if (from == to)
+    return v;
+  int t = new_temp(to);
+  if (to == BcRef)
+    emit(c, from == BcInt ? BC_BOXI : BC_BOXB, reg(t), reg(v));
+  else
+    emit(c, BC_UNBOX, reg(t), reg(v));
+  return t;
+}
+
+static int code_value(Expression e, BcRep to, BcCode &c)
+{
+  return coerce(e->code_bc(c), rep(e->get_type()), to, c);
+}
+
+// evaluating e assigns no variable
+static bool assigns_nothing(Expression e)
+{
+  return dynamic_cast<object_class*>(e) || dynamic_cast<int_const_class*>(e) ||
+         dynamic_cast<string_const_class*>(e) || dynamic_cast<bool_const_class*>(e);
+}
+
+//
+// The operand v is read after more operands are evaluated.  If it is
+// a variable that they might assign, it is copied first.
+//
+static int hold(int v, bool later_assign, BcCode &c)
+{
+  if (!later_assign || bc_homes.find(v) == bc_homes.end())
+    return v;
+  int t = new_temp(is_int(v) ? BcInt : BcRef);
+  emit_move(t, v, c);
+  return t;
+}
+
+// Int, Bool and String are laid out by the virtual machine
+static bool runtime_layout(CgenNodeP nd)
+{
+  Symbol name = nd->get_name();
+  return name == Int || name == Bool || name == Str;
+}
+
+//
+// Starts a function; self is in reference register 0.
+//
+static void begin_function()
+{
+  next_ref = 1;
+  next_int = 0;
+  bc_homes.clear();
+  bc_env->enterscope();
+}
+
+static void end_function(int index, int nref_formals, int nint_formals)
+{
+  BcFunction &f = bc_functions[index];
+  f.nref = next_ref;
+  f.nint = next_int;
+  f.nref_formals = nref_formals;
+  f.nint_formals = nint_formals;
+  bc_env->exitscope();
+}
+
+//
+// Classes are entered with their attributes in scope, as fields of
+// self.
+//
+static void enter_class(CgenNodeP nd)
+{
+  curr_class = nd;
+  bc_env->enterscope();
+  for (int i = 0; i < nd->numAttrs(); i++) {
+    attr_class *a = nd->getAttr(i);
+    bc_env->addid(a->getName(), new BcVar(i, true, rep(a->getType())));
+  }
+}
+
+static void exit_class()
+{
+  bc_env->exitscope();
+}
+
+static void emit_word(int w, ostream &s)
+{
+  unsigned u = w;
+  char bytes[4] = { (char) u, (char) (u >> 8), (char) (u >> 16), (char) (u >> 24) };
+  s.write(bytes, 4);
+}
+
+static void emit_bc_string(const char *str, int len, ostream &s)
+{
+  emit_word(len, s);
+  s.write(str, len);
+  for (; len % 4 != 0; len++)
+    s.put('\0');
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  BytecodeClassTable methods
+//
+//////////////////////////////////////////////////////////////////////////////
+
+//
+// Every string constant, class name and file name, numbered in the
+// order they are written.
+//
+void BytecodeClassTable::code_strings()
+{
+  stringtable.add_string("");
+  for (size_t i = 0; i < tag_order.size(); i++)
+    stringtable.add_string(tag_order[i]->get_filename()->get_string());
+
+  int n = 0;
+  for (int i = stringtable.first(); stringtable.more(i); i = stringtable.next(i))
+    n++;
+  emit_word(n, str);
+  for (int i = stringtable.first(); stringtable.more(i); i = stringtable.next(i)) {
+    StringEntry *e = stringtable.lookup(i);
+    bc_strings[e] = i;
+    emit_bc_string(e->get_string(), e->get_len(), str);
+  }
+}
+
+//
+// Numbers the initializers and methods; those of the basic classes
+// are native to the virtual machine.
+//
+void BytecodeClassTable::number_functions()
+{
+  for (size_t i = 0; i < tag_order.size(); i++) {
+    CgenNodeP nd = tag_order[i];
+    BcFunction init;
+    init.name = std::string(nd->get_name()->get_string()) + "_init";
+    init.file = nd->get_filename();
+    init.native = BC_NOT_NATIVE;
+    bc_inits[nd->get_name()] = bc_functions.size();
+    bc_functions.push_back(init);
+
+    Features features = nd->features;
+    for (int j = features->first(); features->more(j); j = features->next(j)) {
+      if (!features->nth(j)->isMethod())
+        continue;
+      method_class *m = static_cast<method_class*>(features->nth(j));
+      BcFunction f;
+      f.name = std::string(nd->get_name()->get_string()) + "." + m->getName()->get_string();
+      f.file = nd->get_filename();
+      f.native = BC_NOT_NATIVE;
+      for (int k = 1; k < BC_NUM_NATIVES && nd->basic(); k++)
+        if (f.name == native_names[k])
+          f.native = k;
+      bc_methods[std::make_pair(nd->get_name(), m->getName())] = bc_functions.size();
+      bc_functions.push_back(f);
+    }
+  }
+}
+
+//
+// A class: its name, initializer (none if it would only return self),
+// the default values of its attributes and its dispatch table.
+//
+void BytecodeClassTable::code_classes()
+{
+  emit_word(tag_order.size(), str);
+  for (size_t i = 0; i < tag_order.size(); i++) {
+    CgenNodeP nd = tag_order[i];
+    emit_word(string_index(nd->get_name()->get_string()), str);
+    emit_word(nd->hasTrivialInit() ? -1 : bc_inits[nd->get_name()], str);
+
+    int nattrs = runtime_layout(nd) ? 0 : nd->numAttrs();
+    emit_word(nattrs, str);
+    for (int j = 0; j < nattrs; j++) {
+      Symbol type = nd->getAttr(j)->getType();
+      if (type == Int || type == Bool)
+        emit_word(BC_INT, str);
+      else if (type == Str)
+        emit_word(string_index(""), str);
+      else
+        emit_word(BC_VOID, str);
+    }
+
+    emit_word(nd->numMethods(), str);
+    for (int j = 0; j < nd->numMethods(); j++)
+      emit_word(bc_methods[std::make_pair(nd->getMethodOwner(j),
+                                          nd->getMethod(j)->getName())], str);
+  }
+}
+
+void BytecodeClassTable::code_functions()
+{
+  bc_env = new SymbolTable<Symbol,BcVar>();
+  for (size_t i = 0; i < tag_order.size(); i++) {
+    enter_class(tag_order[i]);
+    tag_order[i]->code_bc_init(bc_functions[bc_inits[tag_order[i]->get_name()]].code);
+    if (!tag_order[i]->basic())
+      tag_order[i]->code_bc_methods();
+    exit_class();
+  }
+
+  emit_word(bc_functions.size(), str);
+  for (size_t i = 0; i < bc_functions.size(); i++) {
+    BcFunction &f = bc_functions[i];
+    emit_bc_string(f.name.c_str(), f.name.size(), str);
+    emit_word(string_index(f.file->get_string()), str);
+    emit_word(f.native, str);
+    if (f.native != BC_NOT_NATIVE) {
+      for (int j = 0; j < 5; j++)
+        emit_word(0, str);
+      continue;
+    }
+    emit_word(f.nref, str);
+    emit_word(f.nint, str);
+    emit_word(f.nref_formals, str);
+    emit_word(f.nint_formals, str);
+    emit_word(f.code.size(), str);
+    for (size_t j = 0; j < f.code.size(); j++)
+      emit_word(f.code[j], str);
+  }
+}
+
+void BytecodeClassTable::code()
+{
+  bc_classtable = this;
+
+  emit_word(BC_MAGIC, str);
+  emit_word(BC_VERSION, str);
+  emit_word(intclasstag, str);
+  emit_word(boolclasstag, str);
+  emit_word(stringclasstag, str);
+
+  if (cgen_debug) cout << "coding constants" << endl;
+  code_strings();
+
+  if (cgen_debug) cout << "coding classes" << endl;
+  number_functions();
+  code_classes();
+
+  if (cgen_debug) cout << "coding functions" << endl;
+  code_functions();
+
+  // Main.main on a new Main
+  CgenNodeP main_class = probe(Main);
+  emit_word(main_class->getTag(), str);
+  emit_word(bc_methods[std::make_pair(main_class->getMethodOwner(
+                         main_class->methodOffset(main_meth)), main_meth)], str);
+}
+
+
+///////////////////////////////////////////////////////////////////////
+//
+// CgenNode methods
+//
+///////////////////////////////////////////////////////////////////////
+
+//
+// X_init runs the parent's initializer, unless it would only return
+// self, and then the initializers of the attributes X declares.
+//
+void CgenNode::code_bc_init(BcCode &c)
+{
+  begin_function();
+  if (name != Object && !parentnd->hasTrivialInit())
+    emit(c, BC_CALL, SELF_OPERAND, bc_inits[parentnd->get_name()], 0, reg(SELF_OPERAND), 0);
+
+  for (int i = features->first(); features->more(i); i = features->next(i)) {
+    Feature f = features->nth(i);
+    if (!f->isAttr())
+      continue;
+    attr_class *a = static_cast<attr_class*>(f);
+    if (a->getInitExpr()->isNoExpr())
+      continue;
+    BcVar *var = bc_env->lookup(a->getName());
+    int v = code_value(a->getInitExpr(), var->rep, c);
+    emit(c, var->rep == BcRef ? BC_SETR : BC_SETI, var->operand, reg(v));
+  }
+  emit(c, BC_RET, SELF_OPERAND);
+  end_function(bc_inits[name], 0, 0);
+}
+
+//
+// Reference formals are in registers 1, 2, ... and Int and Bool ones
+// in int registers 0, 1, ...
+//
+void CgenNode::code_bc_methods()
+{
+  for (int i = features->first(); features->more(i); i = features->next(i)) {
+    Feature f = features->nth(i);
+    if (!f->isMethod())
+      continue;
+    method_class *m = static_cast<method_class*>(f);
+    Formals formals = m->getFormals();
+    int index = bc_methods[std::make_pair(name, m->getName())];
+    BcCode &c = bc_functions[index].code;
+
+    begin_function();
+    for (int j = formals->first(); formals->more(j); j = formals->next(j)) {
+      Formal formal = formals->nth(j);
+      BcRep r = rep(formal->getType());
+      bc_env->addid(formal->getName(), new BcVar(new_home(r), false, r));
+    }
+    int nref_formals = next_ref - 1, nint_formals = next_int;
+
+    int v = code_value(m->getExpr(), rep(m->getReturnType()), c);
+    emit(c, BC_RET, v);
+    end_function(index, nref_formals, nint_formals);
+  }
+}
+
+
+//******************************************************************
+//
+//   code_bc() for each kind of expression emits the instructions that
+//   compute its value and returns the operand that holds it, as
+//   rep(get_type()) says.
+//
+//   code_bc_branch() emits a jump taken if the expression's value is
+//   sense and returns where its target goes, for patch().
+//
+//*****************************************************************
+
+int Expression_class::code_bc_branch(BcCode &c, bool sense)
+{
+  int v = code_bc(c);
+  emit(c, sense ? BC_JT : BC_JF, reg(v), 0);
+  return jump_operand(c);
+}
+
+//
+// A dispatch on a class with no subclasses calls the method directly;
+// other dynamic dispatches keep an inline cache of the last receiver's
+// class and method, which the virtual machine fills in.
+//
+static int code_call(Expression receiver, CgenNodeP nd, Symbol name,
+                     Expressions actual, Expression e, int line_number,
+                     bool dynamic, BcCode &c)
+{
+  int offset = nd->methodOffset(name);
+  method_class *m = nd->getMethod(offset);
+  Formals formals = m->getFormals();
+
+  int n = actual->len();
+  std::vector<bool> later_assign(n);
+  bool assigns = !assigns_nothing(receiver);
+  for (int i = n - 1; i >= 0; i--) {
+    later_assign[i] = assigns;
+    assigns = assigns || !assigns_nothing(actual->nth(i));
+  }
+
+  std::vector<int> args;
+  for (int i = actual->first(); actual->more(i); i = actual->next(i)) {
+    int v = code_value(actual->nth(i), rep(formals->nth(i)->getType()), c);
+    args.push_back(hold(v, later_assign[i], c));
+  }
+  int obj = code_value(receiver, BcRef, c);
+
+  BcRep result_rep = rep(m->getReturnType());
+  int result = new_temp(result_rep);
+  if (dynamic && nd->getTag() != nd->getMaxTag()) {
+    emit(c, BC_DISPATCH, result, offset, line_number, reg(obj));
+    c.push_back(-1);
+    c.push_back(-1);
+  } else {
+    emit(c, BC_CALL, result,
+         bc_methods[std::make_pair(nd->getMethodOwner(offset), name)],
+         line_number, reg(obj));
+  }
+  c.push_back(args.size());
+  c.insert(c.end(), args.begin(), args.end());
+  return coerce(result, result_rep, rep(e->get_type()), c);
+}
+
+int assign_class::code_bc(BcCode &c) {
+  BcVar *var = bc_env->lookup(name);
+  int v = expr->code_bc(c);
+  int stored = coerce(v, rep(expr->get_type()), var->rep, c);
+  if (var->attr)
+    emit(c, var->rep == BcRef ? BC_SETR : BC_SETI, var->operand, reg(stored));
+  else
+    emit_move(var->operand, stored, c);
+  return v;
+}
+
+int static_dispatch_class::code_bc(BcCode &c) {
+  CgenNodeP nd = bc_classtable->lookupClass(type_name, curr_class);
+  return code_call(expr, nd, name, actual, this, get_line_number(), false, c);
+}
+
+int dispatch_class::code_bc(BcCode &c) {
+  CgenNodeP nd = bc_classtable->lookupClass(expr->get_type(), curr_class);
+  return code_call(expr, nd, name, actual, this, get_line_number(), true, c);
+}
+
+int cond_class::code_bc(BcCode &c) {
+  BcRep r = rep(type);
+  int result = new_temp(r);
+  int to_else = pred->code_bc_branch(c, false);
+  emit_move(result, code_value(then_exp, r, c), c);
+  emit(c, BC_JMP, 0);
+  int to_end = jump_operand(c);
+  patch(c, to_else);
+  emit_move(result, code_value(else_exp, r, c), c);
+  patch(c, to_end);
+  return result;
+}
+
+int loop_class::code_bc(BcCode &c) {
+  int top = c.size();
+  int to_end = pred->code_bc_branch(c, false);
+  body->code_bc(c);
+  emit(c, BC_JMP, top);
+  patch(c, to_end);
+  int t = new_temp(BcRef);
+  emit(c, BC_LDNULL, reg(t));
+  return t;
+}
+
+//
+// Branches are tried from the most specific class (largest tag) to
+// the least, so the first whose tag range holds the object's tag is
+// the closest ancestor.
+//
+static bool by_tag_desc(branch_class *a, branch_class *b)
+{
+  return bc_classtable->lookupClass(a->get_type_decl(), curr_class)->getTag() >
+         bc_classtable->lookupClass(b->get_type_decl(), curr_class)->getTag();
+}
+
+int typcase_class::code_bc(BcCode &c) {
+  BcRep r = rep(type);
+  int obj = code_value(expr, BcRef, c);
+  if (obj == SELF_OPERAND || bc_homes.find(obj) != bc_homes.end()) {
+    int t = new_temp(BcRef);          // the branch variable may be assigned
+    emit_move(t, obj, c);
+    obj = t;
+  }
+  emit(c, BC_CASEVOID, reg(obj), get_line_number());
+  int tag = new_temp(BcInt);
+  emit(c, BC_TAG, reg(tag), reg(obj));
+  int result = new_temp(r);
+
+  std::vector<branch_class*> branches;
+  for (int i = cases->first(); cases->more(i); i = cases->next(i))
+    branches.push_back(static_cast<branch_class*>(cases->nth(i)));
+  std::sort(branches.begin(), branches.end(), by_tag_desc);
+
+  std::vector<int> to_end;
+  for (size_t i = 0; i < branches.size(); i++) {
+    branch_class *b = branches[i];
+    CgenNodeP nd = bc_classtable->lookupClass(b->get_type_decl(), curr_class);
+    BcRep var_rep = rep(b->get_type_decl());
+
+    emit(c, BC_JOUT, reg(tag), nd->getTag(), nd->getMaxTag(), 0);
+    int to_next = jump_operand(c);
+    int var = coerce(obj, BcRef, var_rep, c);
+    bc_homes.insert(var);
+    bc_env->enterscope();
+    bc_env->addid(b->getName(), new BcVar(var, false, var_rep));
+    emit_move(result, code_value(b->getExpr(), r, c), c);
+    bc_env->exitscope();
+    emit(c, BC_JMP, 0);
+    to_end.push_back(jump_operand(c));
+    patch(c, to_next);
+  }
+  emit(c, BC_CASEABORT, reg(obj));
+  for (size_t i = 0; i < to_end.size(); i++)
+    patch(c, to_end[i]);
+  return result;
+}
+
+int block_class::code_bc(BcCode &c) {
+  int v = 0;
+  for (int i = body->first(); body->more(i); i = body->next(i))
+    v = body->nth(i)->code_bc(c);
+  return v;
+}
+
+//
+// The variable takes over the register of its initial value when that
+// is a temporary.
+//
+int let_class::code_bc(BcCode &c) {
+  BcRep r = rep(type_decl);
+  int var;
+  if (init->isNoExpr()) {
+    var = load_default(type_decl, c);
+  } else {
+    var = code_value(init, r, c);
+    if (var == SELF_OPERAND || bc_homes.find(var) != bc_homes.end()) {
+      int t = new_temp(r);
+      emit_move(t, var, c);
+      var = t;
+    }
+  }
+  bc_homes.insert(var);
+
+  bc_env->enterscope();
+  bc_env->addid(identifier, new BcVar(var, false, r));
+  int result = body->code_bc(c);
+  bc_env->exitscope();
+  return result;
+}
+
+static int code_binary(Expression e1, Expression e2, int op, BcCode &c)
+{
+  int a = hold(e1->code_bc(c), !assigns_nothing(e2), c);
+  int b = e2->code_bc(c);
+  int t = new_temp(BcInt);
+  emit(c, op, reg(t), reg(a), reg(b));
+  return t;
+}
+
+static int code_compare_branch(Expression e1, Expression e2, int op_true,
+                               int op_false, bool sense, BcCode &c)
+{
+  int a = hold(e1->code_bc(c), !assigns_nothing(e2), c);
+  int b = e2->code_bc(c);
+  emit(c, sense ? op_true : op_false, reg(a), reg(b), 0);
+  return jump_operand(c);
+}
+
+int plus_class::code_bc(BcCode &c) {
+  return code_binary(e1, e2, BC_ADD, c);
+}
+
+int sub_class::code_bc(BcCode &c) {
+  return code_binary(e1, e2, BC_SUB, c);
+}
+
+int mul_class::code_bc(BcCode &c) {
+  return code_binary(e1, e2, BC_MUL, c);
+}
+
+int divide_class::code_bc(BcCode &c) {
+  return code_binary(e1, e2, BC_DIV, c);
+}
+
+int neg_class::code_bc(BcCode &c) {
+  int a = e1->code_bc(c);
+  int t = new_temp(BcInt);
+  emit(c, BC_NEG, reg(t), reg(a));
+  return t;
+}
+
+int lt_class::code_bc(BcCode &c) {
+  return code_binary(e1, e2, BC_LT, c);
+}
+
+int lt_class::code_bc_branch(BcCode &c, bool sense) {
+  return code_compare_branch(e1, e2, BC_JTLT, BC_JFLT, sense, c);
+}
+
+int leq_class::code_bc(BcCode &c) {
+  return code_binary(e1, e2, BC_LE, c);
+}
+
+int leq_class::code_bc_branch(BcCode &c, bool sense) {
+  return code_compare_branch(e1, e2, BC_JTLE, BC_JFLE, sense, c);
+}
+
+//
+// Ints and Bools held as ints are compared directly; references are
+// compared by the virtual machine, which looks at the values of boxed
+// Ints and Bools and of Strings.
+//
+int eq_class::code_bc(BcCode &c) {
+  BcRep r1 = rep(e1->get_type()), r2 = rep(e2->get_type());
+  if (r1 != BcRef && r1 == r2)
+    return code_binary(e1, e2, BC_EQI, c);
+
+  int a = hold(code_value(e1, BcRef, c), !assigns_nothing(e2), c);
+  int b = code_value(e2, BcRef, c);
+  int t = new_temp(BcBool);
+  emit(c, BC_EQR, reg(t), reg(a), reg(b));
+  return t;
+}
+
+int eq_class::code_bc_branch(BcCode &c, bool sense) {
+  BcRep r1 = rep(e1->get_type()), r2 = rep(e2->get_type());
+  if (r1 != BcRef && r1 == r2)
+    return code_compare_branch(e1, e2, BC_JTEQ, BC_JFEQ, sense, c);
+  return Expression_class::code_bc_branch(c, sense);
+}
+
+int comp_class::code_bc(BcCode &c) {
+  int a = e1->code_bc(c);
+  int t = new_temp(BcBool);
+  emit(c, BC_NOT, reg(t), reg(a));
+  return t;
+}
+
+int comp_class::code_bc_branch(BcCode &c, bool sense) {
+  return e1->code_bc_branch(c, !sense);
+}
+
+int int_const_class::code_bc(BcCode &c)
+{
+  int t = new_temp(BcInt);
+  emit(c, BC_LDI, reg(t), (int) strtoul(token->get_string(), NULL, 10));
+  return t;
+}
+
+int string_const_class::code_bc(BcCode &c)
+{
+  int t = new_temp(BcRef);
+  emit(c, BC_LDS, reg(t), string_index(token->get_string()));
+  return t;
+}
+
+int bool_const_class::code_bc(BcCode &c)
+{
+  int t = new_temp(BcBool);
+  emit(c, BC_LDI, reg(t), val ? 1 : 0);
+  return t;
+}
+
+int new__class::code_bc(BcCode &c) {
+  if (type_name == Int || type_name == Bool || type_name == Str)
+    return load_default(type_name, c);
+
+  int t = new_temp(BcRef);
+  if (type_name == SELF_TYPE)
+    emit(c, BC_NEWSELF, reg(t));
+  else
+    emit(c, BC_NEW, reg(t), bc_classtable->lookupClass(type_name, curr_class)->getTag());
+  return t;
+}
+
+int isvoid_class::code_bc(BcCode &c) {
+  int v = e1->code_bc(c);
+  int t = new_temp(BcBool);
+  if (rep(e1->get_type()) != BcRef)
+    emit(c, BC_LDI, reg(t), 0);
+  else
+    emit(c, BC_ISVOID, reg(t), reg(v));
+  return t;
+}
+
+int no_expr_class::code_bc(BcCode &c) {
+  int t = new_temp(BcRef);
+  emit(c, BC_LDNULL, reg(t));
+  return t;
+}
+
+int object_class::code_bc(BcCode &c) {
+  if (name == self)
+    return SELF_OPERAND;
+  BcVar *var = bc_env->lookup(name);
+  if (!var->attr)
+    return var->operand;
+  int t = new_temp(var->rep);
+  emit(c, var->rep == BcRef ? BC_GETR : BC_GETI, reg(t), var->operand);
+  return t;
+}
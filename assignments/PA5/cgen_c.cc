@@ -0,0 +1,849 @@
+
+//**************************************************************
+//
+// C code generator
+//
+// With -m c, cgen translates the program to C instead of assembly.
+// The output is compiled together with the runtime in lib/c, which
+// provides main, the methods of the basic classes and the memory
+// manager:
+//
+//     cgen -m c -g foo.c < foo.ast
+//     cc -O2 -fno-strict-aliasing -Ilib/c -o foo foo.c lib/c/coolrt.c
+//
+// Every class becomes a struct holding an Object header and all of its
+// attributes, inherited ones first, and a dispatch table (X_vtab) with
+// the slots of the MIPS code.  Method X.m becomes the C function X__m,
+// which takes self and the arguments and returns the result.
+//
+// Values of static type Int or Bool are C ints: attributes, formals,
+// locals and results of those types are never boxed.  A value is boxed
+// only where it is used as an Object, and unboxed where a case branch or
+// a method returning SELF_TYPE gives it back as an Int or Bool.
+//
+// Every expression is translated into statements that leave its value
+// in a fresh temporary, so that C evaluates the program in Cool's order;
+// the C compiler removes the copies.  With -g the references live in a
+// frame of roots, r[], which the collector finds through cool_frames;
+// otherwise they are plain locals r0, r1, ...  r0 is always self.
+//
+//**************************************************************
+
+#include <algorithm>
+#include <sstream>
+#include <stdlib.h>
+#include "cgen.h"
+#include "cgen_gc.h"
+
+extern int cgen_debug;
+
+extern Symbol Bool, Int, Str, Main, main_meth, Object, self, SELF_TYPE;
+
+extern thread_local CgenNodeP curr_class;  // shared with numTemps() in cgen.cc
+
+//
+// How a value of some static type is held in C.
+//
+enum CRep { RepRef, RepInt, RepBool };
+
+// A variable in scope: the C lvalue that holds it.
+struct CVar {
+  std::string lvalue;
+  CRep rep;
+  CVar(const std::string &l, CRep r) : lvalue(l), rep(r) { }
+};
+
+//
+// State of the code generator while translating a function.
+//
+static CgenClassTableP c_classtable = NULL;
+static SymbolTable<Symbol,CVar> *c_env = NULL;
+static bool c_roots;                // references are kept in a frame of roots
+static int next_ref;                // references used by the function
+static int next_int;                // int temporaries used by the function
+static int depth;                   // nesting of the statement being emitted
+
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  Helpers
+//
+//////////////////////////////////////////////////////////////////////////////
+
+static CRep rep(Symbol type)
+{
+  if (type == Int)
+    return RepInt;
+  if (type == Bool)
+    return RepBool;
+  return RepRef;
+}
+
+static const char *c_type(CRep r)
+{
+  return r == RepRef ? "Object *" : "int ";
+}
+
+static std::string itos(int i)
+{
+  std::ostringstream s;
+  s << i;
+  return s.str();
+}
+
+// the start of a statement at the current depth
+static ostream &line(ostream &s)
+{
+  for (int i = 0; i <= depth; i++)
+    s << '\t';
+  return s;
+}
+
+static std::string ref(int i)
+{
+  return c_roots ? "r[" + itos(i) + "]" : "r" + itos(i);
+}
+
+static std::string new_temp(CRep r)
+{
+  if (r == RepRef)
+    return ref(next_ref++);
+  return "i" + itos(next_int++);
+}
+
+static std::string self_ref()
+{
+  return ref(0);
+}
+
+// a C string literal for the len characters of str
+static void emit_c_string(const char *str, int len, ostream &s)
+{
+  static const char digits[] = "01234567";
+
+  s << '"';
+  for (int i = 0; i < len; i++) {
+    unsigned char c = str[i];
+    if (c == '"' || c == '\\' || c == '?')
+      s << '\\' << c;
+    else if (c >= ' ' && c < 0177)
+      s << c;
+    else
+      s << '\\' << digits[c >> 6] << digits[(c >> 3) & 7] << digits[c & 7];
+  }
+  s << '"';
+}
+
+static std::string string_ref(StringEntry *e)
+{
+  std::ostringstream s;
+  s << "(&";  e->code_ref(s);  s << ".h)";
+  return s.str();
+}
+
+// self and constants are never void
+static bool never_void(const std::string &v)
+{
+  return v == self_ref() || (v[0] != 'r' && v[0] != 'i');
+}
+
+static std::string default_value(Symbol type)
+{
+  if (type == Int || type == Bool)
+    return "0";
+  if (type == Str)
+    return string_ref(stringtable.lookup_string(""));
+  return "NULL";
+}
+
+//
+// The value v, held as from, held as to instead.  Boxing an Int
+// allocates, so the result is a new temporary.
+//
+static std::string coerce(const std::string &v, CRep from, CRep to, ostream &s)
+{
+  if (from == to)
+    return v;
+  std::string t = new_temp(to);
+  if (to == RepRef)
+    line(s) << t << " = cool_box_" << (from == RepInt ? "int" : "bool")
+            << "(" << v << ");\n";
+  else
+    line(s) << t << " = cool_unbox(" << v << ");\n";
+  return t;
+}
+
+static std::string code_value(Expression e, CRep to, ostream &s)
+{
+  return coerce(e->code_c(s), rep(e->get_type()), to, s);
+}
+
+static std::string file_name()
+{
+  std::ostringstream s;
+  Symbol file = curr_class->get_filename();
+  emit_c_string(file->get_string(), file->get_len(), s);
+  return s.str();
+}
+
+// the attribute a of self
+static std::string attr_lvalue(Symbol a)
+{
+  return "((struct " + std::string(curr_class->get_name()->get_string()) +
+         "_obj *) " + self_ref() + ")->a_" + a->get_string();
+}
+
+static void emit_method_name(Symbol classname, Symbol methodname, ostream &s)
+{  s << classname << "__" << methodname; }
+
+//
+// The C prototype of method m of class owner, with or without the
+// names of the parameters.
+//
+static void emit_method_head(Symbol owner, method_class *m, bool names, ostream &s)
+{
+  Formals formals = m->getFormals();
+  s << c_type(rep(m->getReturnType()));
+  emit_method_name(owner, m->getName(), s);
+  s << "(Object *" << (names ? "self" : "");
+  for (int i = formals->first(); formals->more(i); i = formals->next(i)) {
+    s << ", " << c_type(rep(formals->nth(i)->getType()));
+    if (names)
+      s << "p" << i;
+  }
+  s << ")";
+}
+
+// the type of a pointer to such a function
+static void emit_method_pointer(method_class *m, ostream &s)
+{
+  Formals formals = m->getFormals();
+  s << "(" << c_type(rep(m->getReturnType())) << "(*)(Object *";
+  for (int i = formals->first(); formals->more(i); i = formals->next(i))
+    s << ", " << c_type(rep(formals->nth(i)->getType()));
+  s << "))";
+}
+
+//
+// A function: its head, the declarations of the temporaries, the frame
+// of roots with self in r[0], the body, and the return of result.
+//
+static void emit_function(const std::string &head, const std::string &setup,
+                          const std::string &body, const std::string &result,
+                          ostream &s)
+{
+  s << "\n" << head << "\n{\n";
+  if (c_roots) {
+    s << "\tObject *r[" << next_ref << "] = { 0 };\n"
+      << "\tstruct cool_frame frame = { cool_frames, " << next_ref << ", r };\n";
+  } else {
+    s << "\tObject *r0";
+    for (int i = 1; i < next_ref; i++)
+      s << ", *r" << i;
+    s << ";\n";
+  }
+  if (next_int > 0) {
+    s << "\tint i0";
+    for (int i = 1; i < next_int; i++)
+      s << ", i" << i;
+    s << ";\n";
+  }
+  s << "\n";
+  if (c_roots)
+    s << "\tcool_frames = &frame;\n";
+  s << "\t" << self_ref() << " = self;\n" << setup << body;
+  if (c_roots)
+    s << "\tcool_frames = frame.prev;\n";
+  s << "\treturn " << result << ";\n}\n";
+}
+
+//
+// Classes are entered with their attributes in scope, as fields of
+// self.
+//
+static void enter_class(CgenNodeP nd)
+{
+  curr_class = nd;
+  c_env->enterscope();
+  for (int i = 0; i < nd->numAttrs(); i++) {
+    attr_class *a = nd->getAttr(i);
+    c_env->addid(a->getName(), new CVar(attr_lvalue(a->getName()), rep(a->getType())));
+  }
+}
+
+static void exit_class()
+{
+  c_env->exitscope();
+}
+
+// Int, Bool and String are laid out by the runtime
+static bool runtime_layout(CgenNodeP nd)
+{
+  Symbol name = nd->get_name();
+  return name == Int || name == Bool || name == Str;
+}
+
+static void emit_header(int tag, Symbol name, const char *size, ostream &s)
+{
+  s << "{ " << tag << ", sizeof(" << size << "), " << name << "_vtab }";
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  CClassTable methods
+//
+//////////////////////////////////////////////////////////////////////////////
+
+void CClassTable::code_structs()
+{
+  for (size_t i = 0; i < tag_order.size(); i++) {
+    CgenNodeP nd = tag_order[i];
+    if (runtime_layout(nd))
+      continue;
+    str << "\nstruct " << nd->get_name() << "_obj {\n\tObject h;\n";
+    for (int j = 0; j < nd->numAttrs(); j++) {
+      attr_class *a = nd->getAttr(j);
+      str << "\t" << c_type(rep(a->getType())) << "a_" << a->getName() << ";\n";
+    }
+    str << "};\n";
+  }
+}
+
+//
+// Prototypes of the initializers and of the methods the program
+// defines; those of the basic classes are in coolrt.h.
+//
+void CClassTable::code_declarations()
+{
+  str << "\n";
+  for (size_t i = 0; i < tag_order.size(); i++)
+    str << "Object *" << tag_order[i]->get_name() << "_init(Object *);\n";
+
+  for (size_t i = 0; i < tag_order.size(); i++) {
+    CgenNodeP nd = tag_order[i];
+    if (nd->basic())
+      continue;
+    Features features = nd->features;
+    for (int j = features->first(); features->more(j); j = features->next(j))
+      if (features->nth(j)->isMethod()) {
+        emit_method_head(nd->get_name(),
+                         static_cast<method_class*>(features->nth(j)), false, str);
+        str << ";\n";
+      }
+  }
+}
+
+void CClassTable::code_dispatch_tables()
+{
+  for (size_t i = 0; i < tag_order.size(); i++) {
+    CgenNodeP nd = tag_order[i];
+    str << "\nconst CoolMethod " << nd->get_name() << "_vtab[] = {\n";
+    for (int j = 0; j < nd->numMethods(); j++) {
+      str << "\t(CoolMethod) ";
+      emit_method_name(nd->getMethodOwner(j), nd->getMethod(j)->getName(), str);
+      str << ",\n";
+    }
+    if (nd->numMethods() == 0)
+      str << "\tNULL\n";
+    str << "};\n";
+  }
+}
+
+void CClassTable::code_constants()
+{
+  stringtable.add_string("");
+
+  str << "\n";
+  for (int i = stringtable.first(); stringtable.more(i); i = stringtable.next(i)) {
+    StringEntry *e = stringtable.lookup(i);
+    str << "CoolString ";  e->code_ref(str);  str << " = { ";
+    emit_header(stringclasstag, Str, "CoolString", str);
+    str << ", " << e->get_len() << ", ";
+    emit_c_string(e->get_string(), e->get_len(), str);
+    str << " };\n";
+  }
+  for (int val = FALSE; val <= TRUE; val++) {
+    str << "CoolInt ";  BoolConst(val).code_ref(str);  str << " = { ";
+    emit_header(boolclasstag, Bool, "CoolInt", str);
+    str << ", " << val << " };\n";
+  }
+}
+
+void CClassTable::code_prototypes()
+{
+  str << "\n";
+  for (size_t i = 0; i < tag_order.size(); i++) {
+    CgenNodeP nd = tag_order[i];
+    Symbol name = nd->get_name();
+
+    if (name == Int || name == Bool) {
+      str << "CoolInt " << name << "_proto = { ";
+      emit_header(nd->getTag(), name, "CoolInt", str);
+      str << ", 0 };\n";
+      continue;
+    }
+    if (name == Str) {
+      str << "CoolString " << name << "_proto = { ";
+      emit_header(nd->getTag(), name, "CoolString", str);
+      str << ", 0, \"\" };\n";
+      continue;
+    }
+    str << "struct " << name << "_obj " << name << "_proto = { ";
+    emit_header(nd->getTag(), name, (std::string("struct ") +
+                                     name->get_string() + "_obj").c_str(), str);
+    for (int j = 0; j < nd->numAttrs(); j++)
+      str << ", " << default_value(nd->getAttr(j)->getType());
+    str << " };\n";
+  }
+}
+
+//
+// What the runtime needs to know of each class: its prototype,
+// initializer and name, and where its references are.
+//
+void CClassTable::code_class_table()
+{
+  for (size_t i = 0; i < tag_order.size(); i++) {
+    CgenNodeP nd = tag_order[i];
+    bool refs = false;
+    for (int j = 0; j < nd->numAttrs() && !runtime_layout(nd); j++)
+      refs = refs || rep(nd->getAttr(j)->getType()) == RepRef;
+    if (!refs)
+      continue;
+    str << "\nstatic const int " << nd->get_name() << "_ptrs[] = {\n";
+    for (int j = 0; j < nd->numAttrs(); j++)
+      if (rep(nd->getAttr(j)->getType()) == RepRef)
+        str << "\toffsetof(struct " << nd->get_name() << "_obj, a_"
+            << nd->getAttr(j)->getName() << "),\n";
+    str << "\t0\n};\n";
+  }
+
+  str << "\nconst CoolClass cool_class_table[] = {\n";
+  for (size_t i = 0; i < tag_order.size(); i++) {
+    CgenNodeP nd = tag_order[i];
+    Symbol name = nd->get_name();
+    bool refs = false;
+    for (int j = 0; j < nd->numAttrs() && !runtime_layout(nd); j++)
+      refs = refs || rep(nd->getAttr(j)->getType()) == RepRef;
+
+    str << "\t{ &" << name << "_proto.h, " << name << "_init, "
+        << string_ref(stringtable.lookup_string(name->get_string())) << ", ";
+    if (refs)
+      str << name << "_ptrs";
+    else
+      str << "cool_no_ptrs";
+    str << " },\n";
+  }
+  str << "};\n\n";
+
+  str << "const int cool_int_tag = " << intclasstag << ";\n"
+      << "const int cool_bool_tag = " << boolclasstag << ";\n"
+      << "const int cool_string_tag = " << stringclasstag << ";\n"
+      << "const int cool_gc = " << c_roots << ";\n"
+      << "const int cool_gc_test = "
+      << (c_roots && cgen_Memmgr_Test == GC_TEST) << ";\n";
+}
+
+void CClassTable::code_functions()
+{
+  c_env = new SymbolTable<Symbol,CVar>();
+  for (size_t i = 0; i < tag_order.size(); i++) {
+    enter_class(tag_order[i]);
+    tag_order[i]->code_c_init(str);
+    if (!tag_order[i]->basic())
+      tag_order[i]->code_c_methods(str);
+    exit_class();
+  }
+
+  // Main.main on a new Main
+  CgenNodeP main_class = probe(Main);
+  str << "\nvoid cool_main(void)\n{\n\t";
+  emit_method_name(main_class->getMethodOwner(main_class->methodOffset(main_meth)),
+                   main_meth, str);
+  str << "(Main_init(cool_new(&Main_proto.h)));\n}\n";
+}
+
+void CClassTable::code()
+{
+  c_classtable = this;
+  c_roots = cgen_Memmgr != GC_NOGC;
+
+  str << "/* generated by cgen -m c */\n"
+      << "#include <stddef.h>\n"
+      << "#include \"coolrt.h\"\n";
+
+  if (cgen_debug) cout << "coding structs" << endl;
+  code_structs();
+  code_declarations();
+
+  if (cgen_debug) cout << "coding class tables" << endl;
+  code_dispatch_tables();
+  code_constants();
+  code_prototypes();
+  code_class_table();
+
+  if (cgen_debug) cout << "coding functions" << endl;
+  code_functions();
+}
+
+
+///////////////////////////////////////////////////////////////////////
+//
+// CgenNode methods
+//
+///////////////////////////////////////////////////////////////////////
+
+//
+// X_init runs the parent's initializer and then the initializers of
+// the attributes X declares, in order.
+//
+void CgenNode::code_c_init(ostream &s)
+{
+  std::ostringstream body;
+
+  next_ref = 1;
+  next_int = 0;
+  depth = 0;
+  if (name != Object)
+    line(body) << parentnd->get_name() << "_init(" << self_ref() << ");\n";
+
+  for (int i = features->first(); features->more(i); i = features->next(i)) {
+    Feature f = features->nth(i);
+    if (!f->isAttr())
+      continue;
+    attr_class *a = static_cast<attr_class*>(f);
+    if (a->getInitExpr()->isNoExpr())
+      continue;
+    CVar *var = c_env->lookup(a->getName());
+    std::string v = code_value(a->getInitExpr(), var->rep, body);
+    line(body) << var->lvalue << " = " << v << ";\n";
+  }
+
+  emit_function("Object *" + std::string(name->get_string()) + "_init(Object *self)",
+                "", body.str(), self_ref(), s);
+}
+
+//
+// Formals of type Int and Bool are used as the C parameters they are;
+// references are copied to the frame.
+//
+void CgenNode::code_c_methods(ostream &s)
+{
+  for (int i = features->first(); features->more(i); i = features->next(i)) {
+    Feature f = features->nth(i);
+    if (!f->isMethod())
+      continue;
+    method_class *m = static_cast<method_class*>(f);
+    Formals formals = m->getFormals();
+    std::ostringstream head, setup, body;
+
+    next_ref = 1;
+    next_int = 0;
+    depth = 0;
+    c_env->enterscope();
+    for (int j = formals->first(); formals->more(j); j = formals->next(j)) {
+      Formal formal = formals->nth(j);
+      CRep r = rep(formal->getType());
+      std::string param = "p" + itos(j);
+      if (r == RepRef) {
+        std::string t = new_temp(r);
+        line(setup) << t << " = " << param << ";\n";
+        param = t;
+      }
+      c_env->addid(formal->getName(), new CVar(param, r));
+    }
+
+    std::string result = code_value(m->getExpr(), rep(m->getReturnType()), body);
+    c_env->exitscope();
+
+    emit_method_head(name, m, true, head);
+    emit_function(head.str(), setup.str(), body.str(), result, s);
+  }
+}
+
+
+//******************************************************************
+//
+//   code_c() for each kind of expression emits the statements that
+//   compute its value and returns the temporary (or constant) that
+//   holds it, as rep(get_type()) says.
+//
+//*****************************************************************
+
+static std::string code_call(Expression receiver, CgenNodeP nd, Symbol name,
+                             Expressions actual, Expression e, int line_number,
+                             bool dynamic, ostream &s)
+{
+  int offset = nd->methodOffset(name);
+  method_class *m = nd->getMethod(offset);
+  Formals formals = m->getFormals();
+  std::vector<std::string> args;
+
+  for (int i = actual->first(); actual->more(i); i = actual->next(i))
+    args.push_back(code_value(actual->nth(i), rep(formals->nth(i)->getType()), s));
+
+  std::string obj = receiver->code_c(s);
+  if (rep(receiver->get_type()) == RepRef && !never_void(obj))
+    line(s) << "if (" << obj << " == NULL) cool_dispatch_abort("
+            << file_name() << ", " << line_number << ");\n";
+  else
+    obj = coerce(obj, rep(receiver->get_type()), RepRef, s);
+
+  CRep result_rep = rep(m->getReturnType());
+  std::string result = new_temp(result_rep);
+  line(s) << result << " = ";
+  if (dynamic) {
+    s << "(";
+    emit_method_pointer(m, s);
+    s << " " << obj << "->disp[" << offset << "])(";
+  } else {
+    emit_method_name(nd->getMethodOwner(offset), name, s);
+    s << "(";
+  }
+  s << obj;
+  for (size_t i = 0; i < args.size(); i++)
+    s << ", " << args[i];
+  s << ");\n";
+  return coerce(result, result_rep, rep(e->get_type()), s);
+}
+
+std::string assign_class::code_c(ostream &s) {
+  CVar *var = c_env->lookup(name);
+  std::string v = expr->code_c(s);
+  std::string stored = coerce(v, rep(expr->get_type()), var->rep, s);
+  line(s) << var->lvalue << " = " << stored << ";\n";
+  return v;
+}
+
+std::string static_dispatch_class::code_c(ostream &s) {
+  CgenNodeP nd = c_classtable->lookupClass(type_name, curr_class);
+  return code_call(expr, nd, name, actual, this, get_line_number(), false, s);
+}
+
+std::string dispatch_class::code_c(ostream &s) {
+  CgenNodeP nd = c_classtable->lookupClass(expr->get_type(), curr_class);
+  return code_call(expr, nd, name, actual, this, get_line_number(), true, s);
+}
+
+std::string cond_class::code_c(ostream &s) {
+  CRep r = rep(type);
+  std::string p = pred->code_c(s);
+  std::string result = new_temp(r);
+
+  line(s) << "if (" << p << ") {\n";
+  depth++;
+  std::string v = code_value(then_exp, r, s);
+  line(s) << result << " = " << v << ";\n";
+  depth--;
+  line(s) << "} else {\n";
+  depth++;
+  v = code_value(else_exp, r, s);
+  line(s) << result << " = " << v << ";\n";
+  depth--;
+  line(s) << "}\n";
+  return result;
+}
+
+std::string loop_class::code_c(ostream &s) {
+  line(s) << "for (;;) {\n";
+  depth++;
+  std::string p = pred->code_c(s);
+  line(s) << "if (!" << p << ")\n";
+  line(s) << "\tbreak;\n";
+  body->code_c(s);
+  depth--;
+  line(s) << "}\n";
+  return "NULL";
+}
+
+//
+// Branches are tried from the most specific class (largest tag) to
+// the least, so the first whose tag range holds the object's tag is
+// the closest ancestor.
+//
+static bool by_tag_desc(branch_class *a, branch_class *b)
+{
+  return c_classtable->lookupClass(a->get_type_decl(), curr_class)->getTag() >
+         c_classtable->lookupClass(b->get_type_decl(), curr_class)->getTag();
+}
+
+std::string typcase_class::code_c(ostream &s) {
+  CRep r = rep(type);
+  std::string obj = code_value(expr, RepRef, s);
+  line(s) << "if (" << obj << " == NULL) cool_case_abort2("
+          << file_name() << ", " << get_line_number() << ");\n";
+  std::string tag = new_temp(RepInt);
+  line(s) << tag << " = " << obj << "->tag;\n";
+  std::string result = new_temp(r);
+
+  std::vector<branch_class*> branches;
+  for (int i = cases->first(); cases->more(i); i = cases->next(i))
+    branches.push_back(static_cast<branch_class*>(cases->nth(i)));
+  std::sort(branches.begin(), branches.end(), by_tag_desc);
+
+  line(s);
+  for (size_t i = 0; i < branches.size(); i++) {
+    branch_class *b = branches[i];
+    CgenNodeP nd = c_classtable->lookupClass(b->get_type_decl(), curr_class);
+    CRep var_rep = rep(b->get_type_decl());
+
+    s << "if (" << tag << " >= " << nd->getTag() << " && "
+      << tag << " <= " << nd->getMaxTag() << ") {\n";
+    depth++;
+    std::string var = coerce(obj, RepRef, var_rep, s);
+    c_env->enterscope();
+    c_env->addid(b->getName(), new CVar(var, var_rep));
+    std::string v = code_value(b->getExpr(), r, s);
+    c_env->exitscope();
+    line(s) << result << " = " << v << ";\n";
+    depth--;
+    line(s) << "} else ";
+  }
+  s << "{\n";
+  line(s) << "\tcool_case_abort(" << obj << ");\n";
+  line(s) << "}\n";
+  return result;
+}
+
+std::string block_class::code_c(ostream &s) {
+  std::string v;
+  for (int i = body->first(); body->more(i); i = body->next(i))
+    v = body->nth(i)->code_c(s);
+  return v;
+}
+
+std::string let_class::code_c(ostream &s) {
+  CRep r = rep(type_decl);
+  std::string v = init->isNoExpr() ? default_value(type_decl) : code_value(init, r, s);
+  std::string var = new_temp(r);
+  line(s) << var << " = " << v << ";\n";
+
+  c_env->enterscope();
+  c_env->addid(identifier, new CVar(var, r));
+  std::string result = body->code_c(s);
+  c_env->exitscope();
+  return result;
+}
+
+static std::string code_binary(Expression e1, Expression e2, const char *fn,
+                               const char *op, ostream &s)
+{
+  std::string a = e1->code_c(s);
+  std::string b = e2->code_c(s);
+  std::string t = new_temp(RepInt);
+  if (fn != NULL)
+    line(s) << t << " = " << fn << "(" << a << ", " << b << ");\n";
+  else
+    line(s) << t << " = " << a << " " << op << " " << b << ";\n";
+  return t;
+}
+
+std::string plus_class::code_c(ostream &s) {
+  return code_binary(e1, e2, "cool_add", NULL, s);
+}
+
+std::string sub_class::code_c(ostream &s) {
+  return code_binary(e1, e2, "cool_sub", NULL, s);
+}
+
+std::string mul_class::code_c(ostream &s) {
+  return code_binary(e1, e2, "cool_mul", NULL, s);
+}
+
+std::string divide_class::code_c(ostream &s) {
+  return code_binary(e1, e2, "cool_div", NULL, s);
+}
+
+std::string neg_class::code_c(ostream &s) {
+  std::string a = e1->code_c(s);
+  std::string t = new_temp(RepInt);
+  line(s) << t << " = cool_sub(0, " << a << ");\n";
+  return t;
+}
+
+std::string lt_class::code_c(ostream &s) {
+  return code_binary(e1, e2, NULL, "<", s);
+}
+
+std::string leq_class::code_c(ostream &s) {
+  return code_binary(e1, e2, NULL, "<=", s);
+}
+
+//
+// Ints and Bools held as ints are compared directly; references are
+// compared by cool_equal, which looks at the values of boxed Ints and
+// Bools and of Strings.
+//
+std::string eq_class::code_c(ostream &s) {
+  CRep r1 = rep(e1->get_type()), r2 = rep(e2->get_type());
+  if (r1 != RepRef && r1 == r2)
+    return code_binary(e1, e2, NULL, "==", s);
+
+  std::string a = code_value(e1, RepRef, s);
+  std::string b = code_value(e2, RepRef, s);
+  std::string t = new_temp(RepBool);
+  line(s) << t << " = cool_equal(" << a << ", " << b << ");\n";
+  return t;
+}
+
+std::string comp_class::code_c(ostream &s) {
+  std::string a = e1->code_c(s);
+  std::string t = new_temp(RepBool);
+  line(s) << t << " = !" << a << ";\n";
+  return t;
+}
+
+std::string int_const_class::code_c(ostream& s)
+{
+  int val = (int) strtoul(token->get_string(), NULL, 10);
+  if (val == -val && val != 0)
+    return "(-2147483647 - 1)";
+  return itos(val);
+}
+
+std::string string_const_class::code_c(ostream& s)
+{
+  return string_ref(stringtable.lookup_string(token->get_string()));
+}
+
+std::string bool_const_class::code_c(ostream& s)
+{
+  return val ? "1" : "0";
+}
+
+std::string new__class::code_c(ostream &s) {
+  if (type_name == Int || type_name == Bool || type_name == Str)
+    return default_value(type_name);
+
+  std::string t = new_temp(RepRef);
+  if (type_name == SELF_TYPE)
+    line(s) << t << " = cool_new_self(" << self_ref() << ");\n";
+  else
+    line(s) << t << " = " << type_name << "_init(cool_new(&"
+            << type_name << "_proto.h));\n";
+  return t;
+}
+
+std::string isvoid_class::code_c(ostream &s) {
+  std::string v = e1->code_c(s);
+  if (rep(e1->get_type()) != RepRef)
+    return "0";
+  std::string t = new_temp(RepBool);
+  line(s) << t << " = " << v << " == NULL;\n";
+  return t;
+}
+
+std::string no_expr_class::code_c(ostream &s) {
+  return "NULL";
+}
+
+// a copy, which later assignments to the variable leave alone
+std::string object_class::code_c(ostream &s) {
+  if (name == self)
+    return self_ref();
+  CVar *var = c_env->lookup(name);
+  std::string t = new_temp(var->rep);
+  line(s) << t << " = " << var->lvalue << ";\n";
+  return t;
+}
@@ -2,10 +2,11 @@
 #include <stdio.h>
 #include <string.h>
 #include "stringtab.h"
+#include "asm_writer.h"
 
 static int ascii = 0;
 
-void ascii_mode(ostream& str)
+void ascii_mode(AsmWriter& str)
 {
   if (!ascii) 
     {
@@ -14,7 +15,7 @@ void ascii_mode(ostream& str)
     } 
 }
 
-void byte_mode(ostream& str)
+void byte_mode(AsmWriter& str)
 {
   if (ascii) 
     {
@@ -23,8 +24,9 @@ void byte_mode(ostream& str)
     }
 }
 
-void emit_string_constant(ostream& str, char* s)
+void emit_string_constant(ostream& os, char* s)
 {
+  AsmWriter str(os);
   ascii = 0;
 
   while (*s) {
@@ -39,7 +41,7 @@ void emit_string_constant(ostream& str, char* s)
       break;
     case '\\':
       byte_mode(str);
-      str << "\t.byte\t" << (int) ((unsigned char) '\\') << endl;
+      str << "\t.byte\t" << (int) ((unsigned char) '\\') << "\n";
       break;
     case '"' :
       ascii_mode(str);
@@ -54,14 +56,14 @@ void emit_string_constant(ostream& str, char* s)
       else 
 	{
 	  byte_mode(str);
-	  str << "\t.byte\t" << (int) ((unsigned char) *s) << endl;
+	  str << "\t.byte\t" << (int) ((unsigned char) *s) << "\n";
 	}
       break;
     }
     s++;
   }
   byte_mode(str);
-  str << "\t.byte\t0\t" << endl;
+  str << "\t.byte\t0\t\n";
 }
 
 
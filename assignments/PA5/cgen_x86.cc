@@ -0,0 +1,893 @@
+
+//**************************************************************
+//
+// x86-64 code generator
+//
+// With -m x86-64, cgen emits GNU as assembly for Linux and the System V
+// ABI instead of MIPS code for spim.  The program is linked with the
+// runtime in lib/x86-64, which provides the entry point, the methods
+// of the basic classes and the memory manager:
+//
+//     cgen -m x86-64 -g foo.s < foo.ast
+//     cc -o foo foo.s lib/x86-64/runtime.c lib/x86-64/entry.s
+//
+// The class tree, tags, attribute layouts and dispatch table slots are
+// those of the MIPS code generator (CgenClassTable); words are 8 bytes
+// instead of 4.  The code follows the same plan as the MIPS code
+// without -O: the value of every expression ends up in %rax, and
+// everything that must survive a call is kept in the frame.
+//
+// Methods take the receiver in %rax and their arguments on the stack,
+// pushed left to right, and pop the arguments when they return.  Self
+// is kept in %rbx, which C functions preserve too.  The frame is
+//
+//      16(%rbp) ...   arguments, the last one first
+//       8(%rbp)       return address
+//       0(%rbp)       caller's frame pointer
+//      -8(%rbp)       caller's self
+//     -16(%rbp) ...   temporaries
+//
+// Temporaries start out zero: the collector in the runtime takes every
+// word of a Cool frame that points into the heap for a reference, so
+// the frame must not hold stale pointers.
+//
+//**************************************************************
+
+#include <algorithm>
+#include "cgen.h"
+#include "cgen_gc.h"
+#include "emit_x86.h"
+
+extern void emit_string_constant(ostream& str, char *s);
+extern int cgen_debug;
+
+extern Symbol Bool, Int, Str, Main, main_meth, Object, self, SELF_TYPE;
+extern BoolConst falsebool, truebool;
+
+//
+// State of the code generator while emitting the body of a method.
+//
+static CgenClassTableP x86_classtable = NULL;
+extern thread_local CgenNodeP curr_class;  // shared with numTemps() in cgen.cc
+static SymbolTable<Symbol,VarLoc> *var_env = NULL;
+static int curr_formals;            // formals of the current method
+static int next_temp;               // first free temporary
+static int next_label = 0;
+
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  emit_* procedures
+//
+//  As in cgen.cc, offsets of loads and stores are in words.  Addresses
+//  of labels are taken relative to %rip so that the program may be
+//  linked as a position-independent executable.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+static void emit_load(char *dest_reg, int offset, char *source_reg, ostream& s)
+{
+  s << XMOVQ << offset * X86_WORD_SIZE << "(" << source_reg << "), "
+    << dest_reg << endl;
+}
+
+static void emit_store(char *source_reg, int offset, char *dest_reg, ostream& s)
+{
+  s << XMOVQ << source_reg << ", " << offset * X86_WORD_SIZE << "("
+    << dest_reg << ")" << endl;
+}
+
+static void emit_move(char *dest_reg, char *source_reg, ostream& s)
+{
+  s << XMOVQ << source_reg << ", " << dest_reg << endl;
+}
+
+static void emit_load_imm(char *dest_reg, int val, ostream& s)
+{
+  s << XMOVQ << "$" << val << ", " << dest_reg << endl;
+}
+
+static void emit_push(char *reg, ostream& s)
+{
+  s << XPUSHQ << reg << endl;
+}
+
+static void emit_pop(char *reg, ostream& s)
+{
+  s << XPOPQ << reg << endl;
+}
+
+static void emit_call(char *address, ostream& s)
+{
+  s << XCALL << address << endl;
+}
+
+static void emit_disptable_ref(Symbol sym, ostream& s)
+{  s << sym << DISPTAB_SUFFIX; }
+
+static void emit_init_ref(Symbol sym, ostream& s)
+{  s << sym << CLASSINIT_SUFFIX; }
+
+static void emit_protobj_ref(Symbol sym, ostream& s)
+{  s << sym << PROTOBJ_SUFFIX; }
+
+static void emit_method_ref(Symbol classname, Symbol methodname, ostream& s)
+{  s << classname << METHOD_SEP << methodname; }
+
+static void emit_label_ref(int l, ostream &s)
+{  s << "label" << l; }
+
+static void emit_label_def(int l, ostream &s)
+{
+  emit_label_ref(l, s);
+  s << ":" << endl;
+}
+
+// the address of a label, relative to %rip: leaq <label>(%rip), dest
+static void emit_address_end(char *dest, ostream &s)
+{
+  s << "(" << XRIP << "), " << dest << endl;
+}
+
+static void emit_load_bool(char *dest, const BoolConst& b, ostream& s)
+{
+  s << XLEAQ;  b.code_ref(s);  emit_address_end(dest, s);
+}
+
+static void emit_load_string(char *dest, StringEntry *str, ostream& s)
+{
+  s << XLEAQ;  str->code_ref(s);  emit_address_end(dest, s);
+}
+
+static void emit_load_int(char *dest, IntEntry *i, ostream& s)
+{
+  s << XLEAQ;  i->code_ref(s);  emit_address_end(dest, s);
+}
+
+static void emit_jump(char *opcode, int label, ostream &s)
+{
+  s << opcode;  emit_label_ref(label, s);  s << endl;
+}
+
+//
+// Int and Bool values are the low 32 bits of the attribute word.
+//
+static void emit_fetch_int(char *dest, char *source, ostream& s)
+{
+  s << XMOVL << X86_INT_OFFSET << "(" << source << "), " << dest << endl;
+}
+
+static void emit_store_int(char *source, char *dest, ostream& s)
+{
+  s << XMOVL << source << ", " << X86_INT_OFFSET << "(" << dest << ")" << endl;
+}
+
+// set the flags from the value of the Bool in reg
+static void emit_test_bool(char *reg, ostream &s)
+{
+  s << XCMPL << "$0, " << X86_INT_OFFSET << "(" << reg << ")" << endl;
+}
+
+//
+// Select true or false by the flags: ACC is true if cmov moves.
+// leaq leaves the flags alone.
+//
+static void emit_select_bool(char *cmov, ostream &s)
+{
+  emit_load_bool(XACC, falsebool, s);
+  emit_load_bool(XT3, truebool, s);
+  s << cmov << XT3 << ", " << XACC << endl;
+}
+
+//
+// Temporaries of the current method.
+//
+static void emit_temp_store(char *source, int t, ostream &s)
+{
+  emit_store(source, X86_FIRST_TEMP - t, XFP, s);
+}
+
+static void emit_temp_load(char *dest, int t, ostream &s)
+{
+  emit_load(dest, X86_FIRST_TEMP - t, XFP, s);
+}
+
+static void emit_var_load(char *dest, VarLoc *loc, ostream &s)
+{
+  switch (loc->kind) {
+  case VarAttr:
+    emit_load(dest, DEFAULT_OBJFIELDS + loc->index, XSELF, s);
+    break;
+  case VarFormal:
+    emit_load(dest, X86_FIRST_FORMAL + curr_formals - 1 - loc->index, XFP, s);
+    break;
+  default:
+    emit_temp_load(dest, loc->index, s);
+    break;
+  }
+}
+
+static void emit_var_store(char *source, VarLoc *loc, ostream &s)
+{
+  switch (loc->kind) {
+  case VarAttr:
+    emit_store(source, DEFAULT_OBJFIELDS + loc->index, XSELF, s);
+    break;
+  case VarFormal:
+    emit_store(source, X86_FIRST_FORMAL + curr_formals - 1 - loc->index, XFP, s);
+    break;
+  default:
+    emit_temp_store(source, loc->index, s);
+    break;
+  }
+}
+
+//
+// Method entry and exit.  The temporaries are pushed as zeros.
+//
+static void emit_method_entry(int temps, ostream &s)
+{
+  emit_push(XFP, s);
+  emit_move(XFP, XSP, s);
+  emit_push(XSELF, s);
+  for (int i = 0; i < temps; i++)
+    s << XPUSHQ << "$0" << endl;
+  emit_move(XSELF, XACC, s);
+}
+
+static void emit_method_exit(int formals, ostream &s)
+{
+  emit_load(XSELF, X86_SAVED_SELF, XFP, s);
+  s << XLEAVE;
+  if (formals > 0)
+    s << XRET << "$" << formals * X86_WORD_SIZE << endl;
+  else
+    s << "\tret\n";
+}
+
+//
+// Code to abort with the file name and line number of an expression:
+// the runtime takes the file name in %rax and the line in %rdi.
+//
+static void emit_abort(char *routine, int line, ostream &s)
+{
+  emit_load_string(XACC, stringtable.lookup_string(
+                           curr_class->get_filename()->get_string()), s);
+  emit_load_imm(XT1, line, s);
+  emit_call(routine, s);
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  X86ClassTable methods
+//
+//////////////////////////////////////////////////////////////////////////////
+
+//
+// Constants.  The names are those of the MIPS code (code_ref); only
+// the layout differs.
+//
+static void code_string_def(StringEntry *e, int stringclasstag, ostream &s)
+{
+  IntEntryP lensym = inttable.add_int(e->get_len());
+
+  s << X86_ALIGN;
+  e->code_ref(s);  s << LABEL
+    << X86_QUAD << stringclasstag << endl
+    << X86_QUAD << (DEFAULT_OBJFIELDS + STRING_SLOTS +
+                    (e->get_len() + X86_WORD_SIZE) / X86_WORD_SIZE) << endl
+    << X86_QUAD;  emit_disptable_ref(Str, s);  s << endl;
+  s << X86_QUAD;  lensym->code_ref(s);  s << endl;
+  emit_string_constant(s, e->get_string());
+}
+
+static void code_int_def(IntEntry *e, int intclasstag, ostream &s)
+{
+  s << X86_ALIGN;
+  e->code_ref(s);  s << LABEL
+    << X86_QUAD << intclasstag << endl
+    << X86_QUAD << (DEFAULT_OBJFIELDS + INT_SLOTS) << endl
+    << X86_QUAD;  emit_disptable_ref(Int, s);  s << endl;
+  s << X86_QUAD << e->get_string() << endl;
+}
+
+static void code_bool_def(int val, int boolclasstag, ostream &s)
+{
+  s << X86_ALIGN;
+  BoolConst(val).code_ref(s);  s << LABEL
+    << X86_QUAD << boolclasstag << endl
+    << X86_QUAD << (DEFAULT_OBJFIELDS + BOOL_SLOTS) << endl
+    << X86_QUAD;  emit_disptable_ref(Bool, s);  s << endl;
+  s << X86_QUAD << val << endl;
+}
+
+//
+// The names the runtime uses, the tags of the basic value classes and
+// the memory manager settings.
+//
+void X86ClassTable::code_global_data()
+{
+  static const char *globals[] = {
+    CLASSNAMETAB, INTTAG, BOOLTAG, STRINGTAG, X86_MEMMGR_GC, X86_MEMMGR_TEST
+  };
+
+  str << "\t.data\n" << X86_ALIGN;
+  for (size_t i = 0; i < sizeof(globals) / sizeof(globals[0]); i++)
+    str << "\t.globl\t" << globals[i] << endl;
+  str << "\t.globl\t";  emit_protobj_ref(Main, str);  str << endl;
+  str << "\t.globl\t";  emit_init_ref(Main, str);  str << endl;
+  str << "\t.globl\t";  emit_protobj_ref(Int, str);  str << endl;
+  str << "\t.globl\t";  emit_protobj_ref(Str, str);  str << endl;
+  str << "\t.globl\t";  falsebool.code_ref(str);  str << endl;
+  str << "\t.globl\t";  truebool.code_ref(str);  str << endl;
+
+  str << INTTAG << LABEL << X86_QUAD << intclasstag << endl;
+  str << BOOLTAG << LABEL << X86_QUAD << boolclasstag << endl;
+  str << STRINGTAG << LABEL << X86_QUAD << stringclasstag << endl;
+  str << X86_MEMMGR_GC << LABEL
+      << X86_QUAD << (cgen_Memmgr == GC_NOGC ? 0 : 1) << endl;
+  str << X86_MEMMGR_TEST << LABEL
+      << X86_QUAD << (cgen_Memmgr_Test == GC_TEST) << endl;
+}
+
+void X86ClassTable::code_constants()
+{
+  stringtable.add_string("");
+  inttable.add_string("0");
+
+  // the lengths of the strings are constants too
+  for (int i = stringtable.first(); stringtable.more(i); i = stringtable.next(i))
+    inttable.add_int(stringtable.lookup(i)->get_len());
+
+  for (int i = stringtable.first(); stringtable.more(i); i = stringtable.next(i))
+    code_string_def(stringtable.lookup(i), stringclasstag, str);
+  for (int i = inttable.first(); inttable.more(i); i = inttable.next(i))
+    code_int_def(inttable.lookup(i), intclasstag, str);
+  code_bool_def(FALSE, boolclasstag, str);
+  code_bool_def(TRUE, boolclasstag, str);
+}
+
+void X86ClassTable::code_class_nametab()
+{
+  str << CLASSNAMETAB << LABEL;
+  for (size_t i = 0; i < tag_order.size(); i++) {
+    str << X86_QUAD;
+    stringtable.lookup_string(tag_order[i]->get_name()->get_string())->code_ref(str);
+    str << endl;
+  }
+}
+
+void X86ClassTable::code_class_objtab()
+{
+  str << CLASSOBJTAB << LABEL;
+  for (size_t i = 0; i < tag_order.size(); i++) {
+    Symbol name = tag_order[i]->get_name();
+    str << X86_QUAD;  emit_protobj_ref(name, str);  str << endl;
+    str << X86_QUAD;  emit_init_ref(name, str);  str << endl;
+  }
+}
+
+void X86ClassTable::code_dispatch_tables()
+{
+  for (size_t i = 0; i < tag_order.size(); i++) {
+    CgenNodeP nd = tag_order[i];
+    emit_disptable_ref(nd->get_name(), str);  str << LABEL;
+    for (int j = 0; j < nd->numMethods(); j++) {
+      str << X86_QUAD;
+      emit_method_ref(nd->getMethodOwner(j), nd->getMethod(j)->getName(), str);
+      str << endl;
+    }
+  }
+}
+
+void X86ClassTable::code_prototypes()
+{
+  for (size_t i = 0; i < tag_order.size(); i++) {
+    CgenNodeP nd = tag_order[i];
+
+    emit_protobj_ref(nd->get_name(), str);  str << LABEL
+      << X86_QUAD << nd->getTag() << endl
+      << X86_QUAD << nd->getSize() << endl
+      << X86_QUAD;  emit_disptable_ref(nd->get_name(), str);  str << endl;
+
+    for (int j = 0; j < nd->numAttrs(); j++) {
+      Symbol type = nd->getAttr(j)->getType();
+      str << X86_QUAD;
+      if (type == Int)
+        inttable.lookup_string("0")->code_ref(str);
+      else if (type == Bool)
+        falsebool.code_ref(str);
+      else if (type == Str)
+        stringtable.lookup_string("")->code_ref(str);
+      else
+        str << EMPTYSLOT;
+      str << endl;
+    }
+  }
+}
+
+//
+// As in cgen.cc, a name not bound in var_env is an attribute of the
+// current class, found in its layout; attr_locs[i] is attribute i.
+//
+static std::vector<VarLoc> attr_locs;
+
+static void enter_class(CgenNodeP nd)
+{
+  curr_class = nd;
+  var_env->enterscope();
+  while ((int) attr_locs.size() < nd->numAttrs())
+    attr_locs.push_back(VarLoc(VarAttr, attr_locs.size()));
+}
+
+static VarLoc *lookup_var(Symbol name)
+{
+  VarLoc *loc = var_env->lookup(name);
+  if (loc)
+    return loc;
+  int i = curr_class->attrOffset(name);
+  return i >= 0 ? &attr_locs[i] : NULL;
+}
+
+static void exit_class()
+{
+  var_env->exitscope();
+}
+
+void X86ClassTable::code_inits()
+{
+  for (size_t i = 0; i < tag_order.size(); i++) {
+    enter_class(tag_order[i]);
+    tag_order[i]->code_x86_init(str);
+    exit_class();
+  }
+}
+
+void X86ClassTable::code_methods()
+{
+  for (size_t i = 0; i < tag_order.size(); i++) {
+    if (tag_order[i]->basic())
+      continue;
+    enter_class(tag_order[i]);
+    tag_order[i]->code_x86_methods(str);
+    exit_class();
+  }
+}
+
+void X86ClassTable::code()
+{
+  x86_classtable = this;
+
+  if (cgen_debug) cout << "coding global data" << endl;
+  code_global_data();
+
+  if (cgen_debug) cout << "coding constants" << endl;
+  code_constants();
+
+  if (cgen_debug) cout << "coding class tables" << endl;
+  code_class_nametab();
+  code_class_objtab();
+  code_dispatch_tables();
+  code_prototypes();
+
+  str << "\n\t.text\n";
+  str << "\t.globl\t";  emit_method_ref(Main, main_meth, str);  str << endl;
+
+  var_env = new SymbolTable<Symbol,VarLoc>();
+  if (cgen_debug) cout << "coding initializers" << endl;
+  code_inits();
+
+  if (cgen_debug) cout << "coding methods" << endl;
+  code_methods();
+
+  // the stack need not be executable
+  str << "\t.section\t.note.GNU-stack,\"\",@progbits\n";
+}
+
+
+///////////////////////////////////////////////////////////////////////
+//
+// CgenNode methods
+//
+///////////////////////////////////////////////////////////////////////
+
+//
+// X_init runs the parent's initializer and then the initializers of
+// the attributes X declares, in order.
+//
+void CgenNode::code_x86_init(ostream &s)
+{
+  int temps = 0;
+  for (int i = features->first(); features->more(i); i = features->next(i)) {
+    Feature f = features->nth(i);
+    if (f->isAttr())
+      temps = std::max(temps, static_cast<attr_class*>(f)->getInitExpr()->numTemps());
+  }
+
+  curr_formals = 0;
+  next_temp = 0;
+  emit_init_ref(name, s);  s << LABEL;
+  emit_method_entry(temps, s);
+
+  if (name != Object) {
+    s << XCALL;  emit_init_ref(get_parentnd()->get_name(), s);  s << endl;
+  }
+
+  for (int i = features->first(); features->more(i); i = features->next(i)) {
+    Feature f = features->nth(i);
+    if (!f->isAttr())
+      continue;
+    attr_class *a = static_cast<attr_class*>(f);
+    if (a->getInitExpr()->isNoExpr())
+      continue;
+    a->getInitExpr()->code_x86(s);
+    emit_var_store(XACC, lookup_var(a->getName()), s);
+  }
+
+  emit_move(XACC, XSELF, s);
+  emit_method_exit(0, s);
+}
+
+void CgenNode::code_x86_methods(ostream &s)
+{
+  for (int i = features->first(); features->more(i); i = features->next(i)) {
+    Feature f = features->nth(i);
+    if (!f->isMethod())
+      continue;
+    method_class *m = static_cast<method_class*>(f);
+    Formals formals = m->getFormals();
+    Expression body = m->getExpr();
+
+    var_env->enterscope();
+    for (int j = formals->first(); formals->more(j); j = formals->next(j))
+      var_env->addid(formals->nth(j)->getName(), new VarLoc(VarFormal, j));
+
+    curr_formals = formals->len();
+    next_temp = 0;
+    emit_method_ref(name, m->getName(), s);  s << LABEL;
+    emit_method_entry(body->numTemps(), s);
+    body->code_x86(s);
+    emit_method_exit(curr_formals, s);
+    var_env->exitscope();
+  }
+}
+
+
+//******************************************************************
+//
+//   code_x86() for each kind of expression.  The value is left in
+//   %rax; the temporary registers are free between expressions.
+//
+//*****************************************************************
+
+static int new_label()
+{
+  return next_label++;
+}
+
+static void emit_default_value(char *dest, Symbol type, ostream &s)
+{
+  if (type == Int)
+    emit_load_int(dest, inttable.lookup_string("0"), s);
+  else if (type == Bool)
+    emit_load_bool(dest, falsebool, s);
+  else if (type == Str)
+    emit_load_string(dest, stringtable.lookup_string(""), s);
+  else
+    emit_load_imm(dest, 0, s);
+}
+
+//
+// Evaluate e1 and e2 of a binary operation, leaving e2 in ACC and
+// e1 in T1.
+//
+static void code_operands(Expression e1, Expression e2, ostream &s)
+{
+  e1->code_x86(s);
+  int t = next_temp++;
+  emit_temp_store(XACC, t, s);
+  e2->code_x86(s);
+  next_temp--;
+  emit_temp_load(XT1, t, s);
+}
+
+//
+// Sums, differences and negations that overflow abort the program, as
+// add, sub and neg trap on MIPS; products wrap around.
+//
+static void emit_overflow_check(ostream &s)
+{
+  s << XJO << "_overflow_abort" << endl;
+}
+
+//
+// Integer arithmetic: the result is a fresh copy of the Int in e2.
+// The temporary holding e1 stays live across the copy.  op is NULL
+// for division; trap says whether op overflows as on MIPS.
+//
+static void code_arith(Expression e1, Expression e2, char *op, bool trap,
+                       ostream &s)
+{
+  e1->code_x86(s);
+  int t = next_temp++;
+  emit_temp_store(XACC, t, s);
+  e2->code_x86(s);
+  emit_call("Object.copy", s);
+  next_temp--;
+  emit_temp_load(XT1, t, s);
+  emit_fetch_int(XT1L, XT1, s);
+  emit_fetch_int(XT2L, XACC, s);
+  if (op == NULL) {
+    // idivl divides %edx:%eax, so the new Int is kept in T4
+    emit_move(XT4, XACC, s);
+    s << XMOVL << XT1L << ", " << XACCL << endl;
+    s << XCLTD;
+    s << XIDIVL << XT2L << endl;
+    emit_store_int(XACCL, XT4, s);
+    emit_move(XACC, XT4, s);
+    return;
+  }
+  s << op << XT2L << ", " << XT1L << endl;
+  if (trap)
+    emit_overflow_check(s);
+  emit_store_int(XT1L, XACC, s);
+}
+
+static void code_void_check(int line, ostream &s)
+{
+  int ok = new_label();
+  s << XTESTQ << XACC << ", " << XACC << endl;
+  emit_jump(XJNE, ok, s);
+  emit_abort("_dispatch_abort", line, s);
+  emit_label_def(ok, s);
+}
+
+static void code_actuals(Expressions actual, ostream &s)
+{
+  for (int i = actual->first(); actual->more(i); i = actual->next(i)) {
+    actual->nth(i)->code_x86(s);
+    emit_push(XACC, s);
+  }
+}
+
+void assign_class::code_x86(ostream &s) {
+  expr->code_x86(s);
+  emit_var_store(XACC, lookup_var(name), s);
+}
+
+// the method is known, so it is called directly
+void static_dispatch_class::code_x86(ostream &s) {
+  CgenNodeP nd = x86_classtable->lookupClass(type_name, curr_class);
+  code_actuals(actual, s);
+  expr->code_x86(s);
+  code_void_check(get_line_number(), s);
+  s << XCALL;
+  emit_method_ref(nd->getMethodOwner(nd->methodOffset(name)), name, s);
+  s << endl;
+}
+
+void dispatch_class::code_x86(ostream &s) {
+  CgenNodeP nd = x86_classtable->lookupClass(expr->get_type(), curr_class);
+  code_actuals(actual, s);
+  expr->code_x86(s);
+  code_void_check(get_line_number(), s);
+  emit_load(XT1, DISPTABLE_OFFSET, XACC, s);
+  s << XCALL << "*" << nd->methodOffset(name) * X86_WORD_SIZE
+    << "(" << XT1 << ")" << endl;
+}
+
+void cond_class::code_x86(ostream &s) {
+  int else_label = new_label();
+  int end_label = new_label();
+
+  pred->code_x86(s);
+  emit_test_bool(XACC, s);
+  emit_jump(XJE, else_label, s);
+  then_exp->code_x86(s);
+  emit_jump(XJMP, end_label, s);
+  emit_label_def(else_label, s);
+  else_exp->code_x86(s);
+  emit_label_def(end_label, s);
+}
+
+void loop_class::code_x86(ostream &s) {
+  int loop = new_label();
+  int done = new_label();
+
+  emit_label_def(loop, s);
+  pred->code_x86(s);
+  emit_test_bool(XACC, s);
+  emit_jump(XJE, done, s);
+  body->code_x86(s);
+  emit_jump(XJMP, loop, s);
+  emit_label_def(done, s);
+  emit_load_imm(XACC, 0, s);
+}
+
+//
+// Branches are tried from the most specific class (largest tag) to
+// the least, so the first whose tag range holds the object's tag is
+// the closest ancestor.
+//
+static bool by_tag_desc(branch_class *a, branch_class *b)
+{
+  return x86_classtable->lookupClass(a->get_type_decl(), curr_class)->getTag() >
+         x86_classtable->lookupClass(b->get_type_decl(), curr_class)->getTag();
+}
+
+void typcase_class::code_x86(ostream &s) {
+  int end_label = new_label();
+  int ok = new_label();
+
+  expr->code_x86(s);
+  s << XTESTQ << XACC << ", " << XACC << endl;
+  emit_jump(XJNE, ok, s);
+  emit_abort("_case_abort2", get_line_number(), s);
+  emit_label_def(ok, s);
+
+  int t = next_temp++;
+  emit_temp_store(XACC, t, s);
+  emit_load(XT2, TAG_OFFSET, XACC, s);
+
+  std::vector<branch_class*> branches;
+  for (int i = cases->first(); cases->more(i); i = cases->next(i))
+    branches.push_back(static_cast<branch_class*>(cases->nth(i)));
+  std::sort(branches.begin(), branches.end(), by_tag_desc);
+
+  for (size_t i = 0; i < branches.size(); i++) {
+    branch_class *b = branches[i];
+    CgenNodeP nd = x86_classtable->lookupClass(b->get_type_decl(), curr_class);
+    int next = new_label();
+
+    s << XCMPQ << "$" << nd->getTag() << ", " << XT2 << endl;
+    emit_jump(XJL, next, s);
+    s << XCMPQ << "$" << nd->getMaxTag() << ", " << XT2 << endl;
+    emit_jump(XJG, next, s);
+    var_env->enterscope();
+    var_env->addid(b->getName(), new VarLoc(VarTemp, t));
+    b->getExpr()->code_x86(s);
+    var_env->exitscope();
+    emit_jump(XJMP, end_label, s);
+    emit_label_def(next, s);
+  }
+
+  emit_call("_case_abort", s);
+  emit_label_def(end_label, s);
+  next_temp--;
+}
+
+void block_class::code_x86(ostream &s) {
+  for (int i = body->first(); body->more(i); i = body->next(i))
+    body->nth(i)->code_x86(s);
+}
+
+void let_class::code_x86(ostream &s) {
+  if (init->isNoExpr())
+    emit_default_value(XACC, type_decl, s);
+  else
+    init->code_x86(s);
+
+  int t = next_temp++;
+  emit_temp_store(XACC, t, s);
+  var_env->enterscope();
+  var_env->addid(identifier, new VarLoc(VarTemp, t));
+  body->code_x86(s);
+  var_env->exitscope();
+  next_temp--;
+}
+
+void plus_class::code_x86(ostream &s) {
+  code_arith(e1, e2, XADDL, true, s);
+}
+
+void sub_class::code_x86(ostream &s) {
+  code_arith(e1, e2, XSUBL, true, s);
+}
+
+void mul_class::code_x86(ostream &s) {
+  code_arith(e1, e2, XIMULL, false, s);
+}
+
+void divide_class::code_x86(ostream &s) {
+  code_arith(e1, e2, NULL, false, s);
+}
+
+void neg_class::code_x86(ostream &s) {
+  e1->code_x86(s);
+  emit_call("Object.copy", s);
+  s << XNEGL << X86_INT_OFFSET << "(" << XACC << ")" << endl;
+  emit_overflow_check(s);
+}
+
+void lt_class::code_x86(ostream &s) {
+  code_operands(e1, e2, s);
+  emit_fetch_int(XT1L, XT1, s);
+  emit_fetch_int(XT2L, XACC, s);
+  s << XCMPL << XT2L << ", " << XT1L << endl;
+  emit_select_bool(XCMOVL, s);
+}
+
+void leq_class::code_x86(ostream &s) {
+  code_operands(e1, e2, s);
+  emit_fetch_int(XT1L, XT1, s);
+  emit_fetch_int(XT2L, XACC, s);
+  s << XCMPL << XT2L << ", " << XT1L << endl;
+  emit_select_bool(XCMOVLE, s);
+}
+
+//
+// Pointer equality is tested inline; otherwise equality_test compares
+// Int, Bool and String values and returns true or false.
+//
+void eq_class::code_x86(ostream &s) {
+  int done = new_label();
+
+  code_operands(e1, e2, s);
+  emit_move(XT2, XACC, s);
+  emit_load_bool(XACC, truebool, s);
+  s << XCMPQ << XT2 << ", " << XT1 << endl;
+  emit_jump(XJE, done, s);
+  emit_call("equality_test", s);
+  emit_label_def(done, s);
+}
+
+void comp_class::code_x86(ostream &s) {
+  e1->code_x86(s);
+  emit_test_bool(XACC, s);
+  emit_select_bool(XCMOVE, s);
+}
+
+void int_const_class::code_x86(ostream& s)
+{
+  emit_load_int(XACC, inttable.lookup_string(token->get_string()), s);
+}
+
+void string_const_class::code_x86(ostream& s)
+{
+  emit_load_string(XACC, stringtable.lookup_string(token->get_string()), s);
+}
+
+void bool_const_class::code_x86(ostream& s)
+{
+  emit_load_bool(XACC, BoolConst(val), s);
+}
+
+//
+// new SELF_TYPE finds the prototype and initializer of self's class
+// in class_objTab, two words per class.
+//
+void new__class::code_x86(ostream &s) {
+  if (type_name != SELF_TYPE) {
+    s << XLEAQ;  emit_protobj_ref(type_name, s);  emit_address_end(XACC, s);
+    emit_call("Object.copy", s);
+    s << XCALL;  emit_init_ref(type_name, s);  s << endl;
+    return;
+  }
+
+  s << XLEAQ << CLASSOBJTAB;  emit_address_end(XT1, s);
+  emit_load(XT2, TAG_OFFSET, XSELF, s);
+  s << XSHLQ << "$" << X86_LOG_WORD_SIZE + 1 << ", " << XT2 << endl;
+  s << XADDQ << XT2 << ", " << XT1 << endl;
+  emit_push(XT1, s);
+  emit_load(XACC, 0, XT1, s);
+  emit_call("Object.copy", s);
+  emit_pop(XT1, s);
+  s << XCALL << "*" << X86_WORD_SIZE << "(" << XT1 << ")" << endl;
+}
+
+void isvoid_class::code_x86(ostream &s) {
+  e1->code_x86(s);
+  s << XTESTQ << XACC << ", " << XACC << endl;
+  emit_select_bool(XCMOVE, s);
+}
+
+void no_expr_class::code_x86(ostream &s) {
+}
+
+void object_class::code_x86(ostream &s) {
+  if (name == self)
+    emit_move(XACC, XSELF, s);
+  else
+    emit_var_load(XACC, lookup_var(name), s);
+}
@@ -5,6 +5,8 @@
 #define COOL_TREE_HANDCODE_H
 
 #include <iostream>
+#include <string>
+#include <vector>
 #include "tree.h"
 #include "cool.h"
 #include "stringtab.h"
@@ -32,6 +34,9 @@ class Expression_class;
 typedef Expression_class *Expression;
 class Case_class;
 typedef Case_class *Case;
+class ValueNumbering;
+class AttrUses;
+typedef std::vector<int> BcCode;       // bytecode, see cgen_bc.cc
 
 typedef list_node<Class_> Classes_class;
 typedef Classes_class *Classes;
@@ -69,27 +74,58 @@ void dump_with_types(ostream&,int);
 
 
 #define Feature_EXTRAS                                        \
-virtual void dump_with_types(ostream&,int) = 0; 
+virtual void dump_with_types(ostream&,int) = 0;               \
+virtual bool isMethod() = 0;                                  \
+virtual bool isAttr() = 0;                                    \
+virtual void simplify() = 0;
 
 
 #define Feature_SHARED_EXTRAS                                       \
 void dump_with_types(ostream&,int);    
 
 
+#define method_EXTRAS                                         \
+bool isMethod() { return true; }                              \
+bool isAttr() { return false; }                               \
+Symbol getName() { return name; }                             \
+Formals getFormals() { return formals; }                      \
+Symbol getReturnType() { return return_type; }                \
+Expression getExpr() { return expr; }                         \
+void simplify();
+
+
+#define attr_EXTRAS                                           \
+bool isMethod() { return false; }                             \
+bool isAttr() { return true; }                                \
+Symbol getName() { return name; }                             \
+Symbol getType() { return type_decl; }                        \
+Expression getInitExpr() { return init; }                     \
+void simplify();
+
+
 #define Formal_EXTRAS                              \
-virtual void dump_with_types(ostream&,int) = 0;
+virtual void dump_with_types(ostream&,int) = 0;    \
+virtual Symbol getName() = 0;                      \
+virtual Symbol getType() = 0;
 
 
 #define formal_EXTRAS                           \
-void dump_with_types(ostream&,int);
+void dump_with_types(ostream&,int);             \
+Symbol getName() { return name; }               \
+Symbol getType() { return type_decl; }
 
 
 #define Case_EXTRAS                             \
-virtual void dump_with_types(ostream& ,int) = 0;
+virtual void dump_with_types(ostream& ,int) = 0; \
+virtual void simplify() = 0;
 
 
 #define branch_EXTRAS                                   \
-void dump_with_types(ostream& ,int);
+void dump_with_types(ostream& ,int);                    \
+Symbol getName() { return name; }                       \
+Symbol get_type_decl() { return type_decl; }            \
+Expression getExpr() { return expr; }                   \
+void simplify();
 
 
 #define Expression_EXTRAS                    \
@@ -97,13 +133,92 @@ Symbol type;                                 \
 Symbol get_type() { return type; }           \
 Expression set_type(Symbol s) { type = s; return this; } \
 virtual void code(ostream&) = 0; \
+virtual void code_x86(ostream&) = 0; \
+virtual std::string code_c(ostream&) = 0; \
+virtual int code_bc(BcCode&) = 0;           \
+virtual int numTemps() = 0;                 \
+virtual bool hasCall() = 0;                 \
+virtual Expression simplify() = 0;          \
+virtual void numberValues(ValueNumbering&) = 0; \
+virtual void countUses(AttrUses&) = 0;      \
+virtual std::string valueKey(std::vector<Symbol>&) { return ""; } \
+virtual void code_int(ostream&);            \
+virtual bool intHasCall() { return hasCall(); } \
+virtual bool isNoExpr() { return false; }  \
+virtual void code_branch(ostream&, bool sense, int label); \
+virtual int code_bc_branch(BcCode&, bool sense); \
 virtual void dump_with_types(ostream&,int) = 0;  \
 void dump_type(ostream&, int);               \
 Expression_class() { type = (Symbol) NULL; }
 
 #define Expression_SHARED_EXTRAS           \
 void code(ostream&); 			   \
+void code_x86(ostream&);                  \
+std::string code_c(ostream&);             \
+int code_bc(BcCode&);                     \
+int numTemps();                           \
+bool hasCall();                           \
+Expression simplify();                    \
+void numberValues(ValueNumbering&);       \
+void countUses(AttrUses&);                \
 void dump_with_types(ostream&,int); 
 
+#define no_expr_EXTRAS                     \
+bool isNoExpr() { return true; }
+
+#define plus_EXTRAS                        \
+std::string valueKey(std::vector<Symbol>&); \
+void code_int(ostream&);                    \
+bool intHasCall();
+
+#define sub_EXTRAS                         \
+std::string valueKey(std::vector<Symbol>&); \
+void code_int(ostream&);                    \
+bool intHasCall();
+
+#define mul_EXTRAS                         \
+std::string valueKey(std::vector<Symbol>&); \
+void code_int(ostream&);                    \
+bool intHasCall();
+
+#define divide_EXTRAS                      \
+std::string valueKey(std::vector<Symbol>&); \
+void code_int(ostream&);                    \
+bool intHasCall();
+
+#define neg_EXTRAS                         \
+std::string valueKey(std::vector<Symbol>&); \
+void code_int(ostream&);                    \
+bool intHasCall();
+
+#define int_const_EXTRAS                   \
+std::string valueKey(std::vector<Symbol>&); \
+void code_int(ostream&);
+
+#define object_EXTRAS                      \
+std::string valueKey(std::vector<Symbol>&);
+
+#define lt_EXTRAS                          \
+void code_branch(ostream&, bool sense, int label); \
+int code_bc_branch(BcCode&, bool sense);
+
+#define leq_EXTRAS                         \
+void code_branch(ostream&, bool sense, int label); \
+int code_bc_branch(BcCode&, bool sense);
+
+#define eq_EXTRAS                          \
+void code_branch(ostream&, bool sense, int label); \
+int code_bc_branch(BcCode&, bool sense);
+
+#define comp_EXTRAS                        \
+void code_branch(ostream&, bool sense, int label); \
+int code_bc_branch(BcCode&, bool sense);
+
+#define isvoid_EXTRAS                      \
+void code_branch(ostream&, bool sense, int label);
+
+#define bool_const_EXTRAS                  \
+void code_branch(ostream&, bool sense, int label);
+
 
 #endif
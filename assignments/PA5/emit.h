@@ -13,6 +13,7 @@
 ///////////////////////////////////////////////////////////////////////
 
 #include "stringtab.h"
+#include "asm_writer.h"
 
 #define MAXINT  100000000    
 #define WORD_SIZE    4
@@ -25,6 +26,15 @@
 #define BOOLTAG              "_bool_tag"
 #define STRINGTAG            "_string_tag"
 #define HEAP_START           "heap_start"
+#define STACKMAPTAB          "stack_mapTab"
+#define INTCACHE             "int_cache"
+#define EXIT_HOOK            "_exit_hook"
+#define PROFILE_COUNTERS     "profile_counters"
+#define PROFILE_MSG          "profile_msg"
+#define PROFILE_NL           "profile_nl"
+#define PROFILE_INIT         "_Prof_Init"
+#define PROFILE_DUMP         "_Prof_Dump"
+#define PROFILE_MARK         "#profile"
 
 // Naming conventions
 #define DISPTAB_SUFFIX       "_dispTab"
@@ -35,6 +45,8 @@
 #define INTCONST_PREFIX      "int_const"
 #define STRCONST_PREFIX      "str_const"
 #define BOOLCONST_PREFIX     "bool_const"
+#define FRAMEMAP_PREFIX      "frame_map"
+#define INLINECACHE_PREFIX   "inline_cache"
 
 
 #define EMPTYSLOT            0
@@ -67,10 +79,13 @@
 #define ZERO "$zero"		// Zero register 
 #define ACC  "$a0"		// Accumulator 
 #define A1   "$a1"		// For arguments to prim funcs 
+#define A2   "$a2"		// Register arguments of methods (-O)
+#define A3   "$a3"		// Register arguments of methods (-O)
 #define SELF "$s0"		// Ptr to self (callee saves) 
 #define T1   "$t1"		// Temporary 1 
 #define T2   "$t2"		// Temporary 2 
 #define T3   "$t3"		// Temporary 3 
+#define T0   "$t0"		// Self in leaf methods
 #define SP   "$sp"		// Stack pointer 
 #define FP   "$fp"		// Frame pointer 
 #define RA   "$ra"		// Return address 
@@ -80,6 +95,8 @@
 //
 #define JALR  "\tjalr\t"  
 #define JAL   "\tjal\t"                 
+#define JUMP  "\tj\t"
+#define SYSCALL "\tsyscall\n"
 #define RET   "\tjr\t"RA"\t"
 
 #define SW    "\tsw\t"
@@ -97,6 +114,9 @@
 #define MUL   "\tmul\t"
 #define SUB   "\tsub\t"
 #define SLL   "\tsll\t"
+#define SRL   "\tsrl\t"
+#define SRA   "\tsra\t"
+#define SLTIU "\tsltiu\t"
 #define BEQZ  "\tbeqz\t"
 #define BRANCH   "\tb\t"
 #define BEQ      "\tbeq\t"
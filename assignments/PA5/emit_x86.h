@@ -0,0 +1,83 @@
+///////////////////////////////////////////////////////////////////////
+//
+//  Assembly for the x86-64 back end (cgen -m x86-64), in GNU as
+//  syntax.  Labels follow the naming conventions of emit.h; the
+//  runtime that goes with the code is in lib/x86-64.
+//
+///////////////////////////////////////////////////////////////////////
+
+#define X86_WORD_SIZE     8
+#define X86_LOG_WORD_SIZE 3
+
+#define X86_QUAD      "\t.quad\t"
+#define X86_ALIGN     "\t.p2align\t3\n"
+
+// Global names shared with the runtime
+#define X86_MEMMGR_GC    "_MemMgr_GC"
+#define X86_MEMMGR_TEST  "_MemMgr_TEST"
+
+//
+// Objects have the header of emit.h with 8-byte words.  An Int or Bool
+// keeps its value in the low 32 bits of its one attribute word.
+//
+#define X86_INT_OFFSET    (DEFAULT_OBJFIELDS * X86_WORD_SIZE)
+
+//
+// The frame of a method: the caller's self is saved just below the
+// frame pointer and the temporaries follow it; the arguments are above
+// the return address.
+//
+#define X86_SAVED_SELF    (-1)
+#define X86_FIRST_TEMP    (-2)
+#define X86_FIRST_FORMAL  2
+
+//
+// register names
+//
+#define XACC   "%rax"		// Accumulator
+#define XSELF  "%rbx"		// Ptr to self (callee saves)
+#define XT1    "%rdi"		// Temporary 1, first C argument
+#define XT2    "%rsi"		// Temporary 2, second C argument
+#define XT3    "%rdx"		// Temporary 3
+#define XT4    "%rcx"		// Temporary 4
+#define XFP    "%rbp"		// Frame pointer
+#define XSP    "%rsp"		// Stack pointer
+#define XRIP   "%rip"		// for position-independent addresses
+
+// the low 32 bits, which hold Int values
+#define XACCL  "%eax"
+#define XT1L   "%edi"
+#define XT2L   "%esi"
+#define XT3L   "%edx"
+
+//
+// Opcodes
+//
+#define XMOVQ   "\tmovq\t"
+#define XMOVL   "\tmovl\t"
+#define XLEAQ   "\tleaq\t"
+#define XPUSHQ  "\tpushq\t"
+#define XPOPQ   "\tpopq\t"
+#define XADDL   "\taddl\t"
+#define XSUBL   "\tsubl\t"
+#define XIMULL  "\timull\t"
+#define XIDIVL  "\tidivl\t"
+#define XNEGL   "\tnegl\t"
+#define XCLTD   "\tcltd\n"
+#define XSHLQ   "\tshlq\t"
+#define XADDQ   "\taddq\t"
+#define XCMPQ   "\tcmpq\t"
+#define XCMPL   "\tcmpl\t"
+#define XTESTQ  "\ttestq\t"
+#define XCMOVE  "\tcmove\t"
+#define XCMOVL  "\tcmovl\t"
+#define XCMOVLE "\tcmovle\t"
+#define XCALL   "\tcall\t"
+#define XJMP    "\tjmp\t"
+#define XJE     "\tje\t"
+#define XJNE    "\tjne\t"
+#define XJL     "\tjl\t"
+#define XJG     "\tjg\t"
+#define XJO     "\tjo\t"
+#define XLEAVE  "\tleave\n"
+#define XRET    "\tret\t"
@@ -6,6 +6,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include "cool-io.h"
 #include <unistd.h>
 #include "cgen_gc.h"
@@ -30,10 +31,19 @@ extern int cool_yydebug;        // for the parser
        bool disable_reg_alloc;  // Don't do register allocation
 
        int cgen_optimize;       // optimize switch for code generator 
+       int cgen_compact_disptabs; // share one table among all dispatch tables
+       int cgen_inline_caches;  // cache the target at dynamic dispatch sites
+       int cgen_reg_args;       // pass the first arguments in $a1-$a3
+       int cgen_profile_generate; // count events for -fprofile-use
+       char *cgen_profile_use;  // output of a -fprofile-generate run
+       int cgen_jobs;           // classes coded at once
+       int cgen_int_cache_min;  // range of the preallocated Ints (-O)
+       int cgen_int_cache_max;
        char *out_filename;      // file name for generated code
        Memmgr cgen_Memmgr = GC_NOGC;      // enable/disable garbage collection
        Memmgr_Test cgen_Memmgr_Test = GC_NORMAL;  // normal/test GC
        Memmgr_Debug cgen_Memmgr_Debug = GC_QUICK; // check heap frequently
+       CgenTarget cgen_target = TARGET_MIPS;      // MIPS for spim, x86-64, C or bytecode
 
 // used for option processing (man 3 getopt for more info)
 extern int optind, opterr;
@@ -50,10 +60,18 @@ void handle_flags(int argc, char *argv[]) {
   semant_debug = 0;
   cgen_debug = 0;
   cgen_optimize = 0;
+  cgen_compact_disptabs = 0;
+  cgen_inline_caches = 0;
+  cgen_reg_args = 0;
+  cgen_profile_generate = 0;
+  cgen_profile_use = NULL;
+  cgen_jobs = 1;
+  cgen_int_cache_min = -128;
+  cgen_int_cache_max = 1023;
   disable_reg_alloc = 0;
   
 
-  while ((c = getopt(argc, argv, "lpscvrOo:gtT")) != -1) {
+  while ((c = getopt(argc, argv, "lpscvrODIf:j:m:o:gGtT")) != -1) {
     switch (c) {
 #ifdef DEBUG
     case 'l':
@@ -87,6 +105,9 @@ void handle_flags(int argc, char *argv[]) {
     case 'g':  // enable garbage collection
       cgen_Memmgr = GC_GENGC;
       break;
+    case 'G':  // garbage collection with precise stack maps
+      cgen_Memmgr = GC_PRECISE;
+      break;
     case 't':  // run garbage collection very frequently (on every allocation)
       cgen_Memmgr_Test = GC_TEST;
       break;
@@ -99,6 +120,49 @@ void handle_flags(int argc, char *argv[]) {
     case 'O':  // enable optimization
       cgen_optimize = 1;
       break;
+    case 'D':  // compact dispatch tables
+      cgen_compact_disptabs = 1;
+      break;
+    case 'I':  // inline caches at dispatch sites
+      cgen_inline_caches = 1;
+      break;
+    case 'm':  // -m mips, -m x86-64, -m c or -m bytecode
+      if (strcmp(optarg, "mips") == 0)
+        cgen_target = TARGET_MIPS;
+      else if (strcmp(optarg, "x86-64") == 0)
+        cgen_target = TARGET_X86_64;
+      else if (strcmp(optarg, "c") == 0)
+        cgen_target = TARGET_C;
+      else if (strcmp(optarg, "bytecode") == 0)
+        cgen_target = TARGET_BYTECODE;
+      else
+        unknownopt = 1;
+      break;
+    case 'f':  // -fprofile-generate, -fprofile-use=file, -fint-cache=min:max
+               // or -freg-args
+      if (strcmp(optarg, "profile-generate") == 0)
+        cgen_profile_generate = 1;
+      else if (strncmp(optarg, "profile-use=", 12) == 0)
+        cgen_profile_use = optarg + 12;
+      else if (strncmp(optarg, "int-cache=", 10) == 0) {
+        // the range is checked with 16-bit addiu and sltiu immediates
+        char end;
+        if (sscanf(optarg + 10, "%d:%d%c", &cgen_int_cache_min,
+                   &cgen_int_cache_max, &end) != 2 ||
+            cgen_int_cache_min > cgen_int_cache_max ||
+            cgen_int_cache_min < -32767 || cgen_int_cache_min > 32767 ||
+            (long) cgen_int_cache_max - cgen_int_cache_min >= 32767)
+          unknownopt = 1;
+      } else if (strcmp(optarg, "reg-args") == 0)
+        cgen_reg_args = 1;
+      else
+        unknownopt = 1;
+      break;
+    case 'j':  // -j N: code classes in N threads
+      cgen_jobs = atoi(optarg);
+      if (cgen_jobs < 1)
+        unknownopt = 1;
+      break;
     case '?':
       unknownopt = 1;
       break;
@@ -111,9 +175,13 @@ void handle_flags(int argc, char *argv[]) {
   if (unknownopt) {
       cerr << "usage: " << argv[0] << 
 #ifdef DEBUG
-	  " [-lvpscOgtTr -o outname] [input-files]\n";
+	  " [-lvpscODIgGtTr -fprofile-generate -fprofile-use=file"
+	  " -fint-cache=min:max -freg-args -j jobs"
+	  " -m mips|x86-64|c|bytecode -o outname] [input-files]\n";
 #else
-      " [-OgtT -o outname] [input-files]\n";
+      " [-ODIgGtT -fprofile-generate -fprofile-use=file"
+      " -fint-cache=min:max -freg-args -j jobs"
+      " -m mips|x86-64|c|bytecode -o outname] [input-files]\n";
 #endif
       exit(1);
   }
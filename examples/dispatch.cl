@@ -0,0 +1,94 @@
+(*
+ * dispatch.cl
+ *
+ * A dispatch benchmark.  The same call, shape.area(), is made over
+ * a list holding only squares, where every call reaches the same
+ * method, and over a list cycling through four kinds of shapes,
+ * where consecutive calls reach different methods.
+ *)
+
+class Shape {
+  area() : Int { 0 };
+};
+
+class Square inherits Shape {
+  side : Int;
+  init(s : Int) : Square {{ side <- s; self; }};
+  area() : Int { side * side };
+};
+
+class Rect inherits Shape {
+  width : Int;
+  height : Int;
+  init(w : Int, h : Int) : Rect {{ width <- w; height <- h; self; }};
+  area() : Int { width * height };
+};
+
+class Triangle inherits Shape {
+  base : Int;
+  height : Int;
+  init(b : Int, h : Int) : Triangle {{ base <- b; height <- h; self; }};
+  area() : Int { base * height / 2 };
+};
+
+class Circle inherits Shape {
+  radius : Int;
+  init(r : Int) : Circle {{ radius <- r; self; }};
+  area() : Int { 3 * radius * radius };
+};
+
+class ShapeList {
+  shape : Shape;
+  rest : ShapeList;
+  cons(s : Shape) : ShapeList { (new ShapeList).init(s, self) };
+  init(s : Shape, r : ShapeList) : ShapeList {{ shape <- s; rest <- r; self; }};
+
+  -- the sum of the areas of the shapes in the list
+  total() : Int {
+    let sum : Int <- 0, l : ShapeList <- self in {
+      while not isvoid l.rest() loop {
+        sum <- sum + l.shape().area();
+        l <- l.rest();
+      } pool;
+      sum;
+    }
+  };
+
+  shape() : Shape { shape };
+  rest() : ShapeList { rest };
+};
+
+class Main inherits IO {
+  squares : ShapeList <- new ShapeList;
+  mixed : ShapeList <- new ShapeList;
+
+  main() : Object {
+    let i : Int <- 0, sum : Int <- 0 in {
+      while i < 100 loop {
+        squares <- squares.cons((new Square).init(i));
+        mixed <- mixed.cons(
+          if i - i / 4 * 4 = 0 then (new Square).init(i) else
+          if i - i / 4 * 4 = 1 then (new Rect).init(i, 2) else
+          if i - i / 4 * 4 = 2 then (new Triangle).init(i, 3) else
+            (new Circle).init(i)
+          fi fi fi);
+        i <- i + 1;
+      } pool;
+
+      i <- 0;
+      while i < 50 loop {
+        sum <- sum + squares.total();
+        i <- i + 1;
+      } pool;
+      out_string("monomorphic: ").out_int(sum).out_string("\n");
+
+      i <- 0;
+      sum <- 0;
+      while i < 50 loop {
+        sum <- sum + mixed.total();
+        i <- i + 1;
+      } pool;
+      out_string("megamorphic: ").out_int(sum).out_string("\n");
+    }
+  };
+};
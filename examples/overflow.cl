@@ -0,0 +1,42 @@
+(*
+ *  Arithmetic that must still fail at run time when cgen -O folds
+ *  constants.  add, sub and neg trap on signed overflow and division
+ *  by zero breaks, so none of the cases below may be folded away.
+ *
+ *  The program reads a case number and runs that case; case 0 runs
+ *  the ones that are safe to fold and does not fail.  overflow.out
+ *  is the output spim gives for cases 0 to 9, one run each.
+ *)
+
+class Main inherits IO {
+   max : Int <- 2147483647;
+   min : Int <- ~2147483647 - 1;
+   zero : Int;
+
+   main() : Object {
+      let c : Int <- in_int() in {
+         out_string("case ").out_int(c).out_string("\n");
+         if c = 0 then {
+            out_int(~~5).out_string(" ");
+            out_int(2147483647 + 0).out_string(" ");
+            out_int(~2147483647 - 1).out_string(" ");
+            out_int(min - min).out_string(" ");
+            out_int(~max).out_string(" ");
+            out_int(65536 * 65536).out_string(" ");
+            out_int(min / 1).out_string("\n");
+         } else
+         if c = 1 then out_int(2147483647 + 1) else
+         if c = 2 then out_int(~2147483647 - 2) else
+         if c = 3 then out_int(~(~2147483647 - 1)) else
+         if c = 4 then out_int(~~(~2147483647 - 1)) else
+         if c = 5 then out_int(~~min) else
+         if c = 6 then out_int(max + 1) else
+         if c = 7 then out_int(min - 1) else
+         if c = 8 then out_int(7 / 0) else
+         if c = 9 then out_int(max / zero) else
+            out_string("no such case\n")
+         fi fi fi fi fi fi fi fi fi fi;
+         out_string("no trap\n");
+      }
+   };
+};
@@ -8,8 +8,14 @@
 // Garbage collection options
 //
 
-extern enum Memmgr { GC_NOGC, GC_GENGC, GC_SNCGC } cgen_Memmgr;
+extern enum Memmgr { GC_NOGC, GC_GENGC, GC_SNCGC, GC_PRECISE } cgen_Memmgr;
 
 extern enum Memmgr_Test { GC_NORMAL, GC_TEST } cgen_Memmgr_Test;
 
 extern enum Memmgr_Debug { GC_QUICK, GC_DEBUG } cgen_Memmgr_Debug;
+
+//
+// Target machine of the code generator
+//
+
+extern enum CgenTarget { TARGET_MIPS, TARGET_X86_64, TARGET_C, TARGET_BYTECODE } cgen_target;
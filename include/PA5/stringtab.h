@@ -58,12 +58,14 @@ public:
 // static data definitions.
 //
 // code_def and code_ref are used by the code to produce definitions and
-// references (respectively) to constants.  
+// references (respectively) to constants.  code_label is the label
+// code_ref writes, as instructions in the code generator refer to it.
 //
 class StringEntry : public Entry {
 public:
   void code_def(ostream& str, int stringclasstag);
   void code_ref(ostream& str);
+  int code_label() const;
   StringEntry(char *s, int l, int i);
 };
 
@@ -76,6 +78,7 @@ class IntEntry: public Entry {
 public:
   void code_def(ostream& str, int intclasstag);
   void code_ref(ostream& str);
+  int code_label() const;
   IntEntry(char *s, int l, int i);
 };
 
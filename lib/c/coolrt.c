@@ -0,0 +1,356 @@
+/*
+ * Runtime system for Cool programs compiled to C with cgen -m c.
+ *
+ * It implements the methods of the basic classes, reports runtime
+ * errors with the messages of lib/trap.handler, and manages memory.
+ * See coolrt.h for the object layout.
+ *
+ * The collector copies what is reachable from the frames of roots into
+ * a new semispace.  Constants and prototypes are not in the heap and
+ * never refer to it, so they need not be scanned.  With -t it runs at
+ * every allocation.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include "coolrt.h"
+
+#define STR_MAXSIZE	1026		/* longest line in_string reads */
+#define ALIGN(n)	(((n) + 7) & ~(size_t) 7)
+
+struct cool_frame *cool_frames;
+char *cool_alloc_ptr, *cool_alloc_limit;
+const int cool_no_ptrs[] = { 0 };
+
+static char *heap_lo;			/* current semispace or chunk */
+static size_t heap_size = 1 << 20;	/* size of the next one */
+
+/*
+ * The references of a runtime function, kept in a frame of roots while
+ * it allocates.
+ */
+#define ENTER(n)	Object *r[n] = { 0 }; \
+			struct cool_frame frame = { cool_frames, n, r }; \
+			cool_frames = &frame
+#define LEAVE		cool_frames = frame.prev
+
+static void die(const char *msg)
+{
+    fputs(msg, stdout);
+    fflush(stdout);
+    exit(0);
+}
+
+/*
+ * Memory.
+ */
+static char *new_space(size_t size)
+{
+    char *p = malloc(size);
+    if (p == NULL)
+        die("Out of memory.\n");
+    return p;
+}
+
+static void set_limit(size_t size)
+{
+    cool_alloc_limit = cool_gc_test ? cool_alloc_ptr : heap_lo + size;
+}
+
+/* without a collector, a full heap is left behind for a new one */
+static void grow(size_t need)
+{
+    size_t size = heap_size > need ? heap_size : need;
+    heap_lo = cool_alloc_ptr = new_space(size);
+    set_limit(size);
+}
+
+static int is_string(Object *o)
+{
+    return o->tag == cool_string_tag;
+}
+
+/* the characters of a String in the heap follow it */
+static char *inline_chars(Object *o)
+{
+    return (char *) ((CoolString *) o + 1);
+}
+
+static void forward(Object **p, char *from, char *from_end, char **next)
+{
+    Object *o = *p;
+    if (o == NULL || (char *) o < from || (char *) o >= from_end)
+        return;
+    if (o->tag < 0) {			/* already copied */
+        *p = (Object *) o->disp;
+        return;
+    }
+    Object *copy = (Object *) *next;
+    size_t bytes = ALIGN(o->size);
+    memcpy(copy, o, o->size);
+    *next += bytes;
+    if (is_string(o) && ((CoolString *) o)->chars == inline_chars(o))
+        ((CoolString *) copy)->chars = inline_chars(copy);
+    o->tag = -1;
+    o->disp = (const CoolMethod *) copy;
+    *p = copy;
+}
+
+/*
+ * Copy what is reachable into a semispace large enough for need more
+ * bytes even if everything is live; the next one is at least twice
+ * what survives.
+ */
+static void collect(size_t need)
+{
+    char *from = heap_lo, *from_end = cool_alloc_ptr;
+    size_t size = from_end - from + need;
+    if (size < heap_size)
+        size = heap_size;
+    char *to = new_space(size);
+    char *next = to, *scan = to;
+
+    for (struct cool_frame *f = cool_frames; f != NULL; f = f->prev)
+        for (long i = 0; i < f->n; i++)
+            forward(&f->r[i], from, from_end, &next);
+    while (scan < next) {
+        Object *o = (Object *) scan;
+        for (const int *p = cool_class_table[o->tag].ptrs; *p; p++)
+            forward((Object **) (scan + *p), from, from_end, &next);
+        scan += ALIGN(o->size);
+    }
+
+    free(from);
+    heap_lo = to;
+    cool_alloc_ptr = next;
+    set_limit(size);
+    size_t live = next - to;
+    if (2 * (live + need) > heap_size)
+        heap_size = 2 * (live + need);
+}
+
+/* called by cool_new when the heap is full, or always with -t */
+Object *cool_alloc_slow(size_t bytes)
+{
+    if (cool_gc)
+        collect(bytes);
+    else
+        grow(bytes);
+    Object *o = (Object *) cool_alloc_ptr;
+    cool_alloc_ptr += bytes;
+    if (cool_gc_test)
+        cool_alloc_limit = cool_alloc_ptr;
+    return o;
+}
+
+/* references held in C variables are stale afterwards */
+static Object *alloc(size_t bytes)
+{
+    Object *o = (Object *) cool_alloc_ptr;
+    if (cool_alloc_ptr + bytes > cool_alloc_limit)
+        return cool_alloc_slow(bytes);
+    cool_alloc_ptr += bytes;
+    return o;
+}
+
+/* a String of len characters, which are zero */
+static CoolString *new_string(int len)
+{
+    size_t bytes = ALIGN(sizeof(CoolString) + len + 1);
+    Object *o = alloc(bytes);
+    CoolString *s = (CoolString *) o;
+    memset(s, 0, bytes);
+    s->h = String_proto.h;
+    s->h.size = sizeof(CoolString) + len + 1;
+    s->len = len;
+    s->chars = inline_chars(o);
+    return s;
+}
+
+/* new SELF_TYPE */
+Object *cool_new_self(Object *self)
+{
+    const CoolClass *c = &cool_class_table[self->tag];
+    return c->init(cool_new(c->proto));
+}
+
+/*
+ * Methods of the basic classes.
+ */
+static void print_class_name(Object *o)
+{
+    CoolString *name = (CoolString *) cool_class_table[o->tag].name;
+    fwrite(name->chars, 1, name->len, stdout);
+}
+
+Object *Object__abort(Object *self)
+{
+    fputs("Abort called from class ", stdout);
+    print_class_name(self);
+    die("\n");
+    return NULL;
+}
+
+Object *Object__type_name(Object *self)
+{
+    return cool_class_table[self->tag].name;
+}
+
+Object *Object__copy(Object *self)
+{
+    ENTER(1);
+    r[0] = self;
+    Object *copy = alloc(ALIGN(self->size));
+    memcpy(copy, r[0], r[0]->size);
+    if (is_string(r[0]) && ((CoolString *) r[0])->chars == inline_chars(r[0]))
+        ((CoolString *) copy)->chars = inline_chars(copy);
+    LEAVE;
+    return copy;
+}
+
+Object *IO__out_string(Object *self, Object *s)
+{
+    CoolString *str = (CoolString *) s;
+    fwrite(str->chars, 1, str->len, stdout);
+    return self;
+}
+
+Object *IO__out_int(Object *self, int i)
+{
+    printf("%d", i);
+    return self;
+}
+
+/* reads a line, or nothing at the end of the input */
+static void read_line(char *buf, int size)
+{
+    fflush(stdout);
+    if (!fgets(buf, size, stdin))
+        buf[0] = '\0';
+}
+
+/*
+ * The line without its newline.  As in trap.handler, nothing at all
+ * (the end of the input) reads as a newline.
+ */
+Object *IO__in_string(Object *self)
+{
+    char buf[STR_MAXSIZE];
+    read_line(buf, sizeof buf);
+    int len = strlen(buf);
+    if (len == 0)
+        buf[len++] = '\n';
+    else if (buf[len - 1] == '\n')
+        len--;
+    CoolString *s = new_string(len);
+    memcpy((char *) s->chars, buf, len);
+    return &s->h;
+}
+
+int IO__in_int(Object *self)
+{
+    char buf[256];
+    read_line(buf, sizeof buf);
+    return (int) strtol(buf, NULL, 10);
+}
+
+int String__length(Object *self)
+{
+    return ((CoolString *) self)->len;
+}
+
+Object *String__concat(Object *self, Object *s)
+{
+    int len1 = ((CoolString *) self)->len;
+    int len2 = ((CoolString *) s)->len;
+    if (len2 == 0)
+        return self;
+
+    ENTER(2);
+    r[0] = self;
+    r[1] = s;
+    CoolString *cat = new_string(len1 + len2);
+    memcpy((char *) cat->chars, ((CoolString *) r[0])->chars, len1);
+    memcpy((char *) cat->chars + len1, ((CoolString *) r[1])->chars, len2);
+    LEAVE;
+    return &cat->h;
+}
+
+Object *String__substr(Object *self, int i, int l)
+{
+    int len = ((CoolString *) self)->len;
+
+    if (i < 0)
+        die("Index to substr is negative\nExecution aborted.\n");
+    if (i > len)
+        die("Index to substr is too big\nExecution aborted.\n");
+    if (i + l > len)
+        die("Length to substr too long\nExecution aborted.\n");
+    if (l < 0)
+        die("Length to substr is negative\nExecution aborted.\n");
+
+    ENTER(1);
+    r[0] = self;
+    CoolString *sub = new_string(l);
+    memcpy((char *) sub->chars, ((CoolString *) r[0])->chars + i, l);
+    LEAVE;
+    return &sub->h;
+}
+
+/*
+ * = on two references: Ints, Bools and Strings are compared by value,
+ * anything else by identity.
+ */
+int cool_equal(Object *a, Object *b)
+{
+    if (a == b)
+        return 1;
+    if (a == NULL || b == NULL || a->tag != b->tag)
+        return 0;
+    if (a->tag == cool_int_tag || a->tag == cool_bool_tag)
+        return cool_unbox(a) == cool_unbox(b);
+    if (a->tag == cool_string_tag) {
+        CoolString *s = (CoolString *) a, *t = (CoolString *) b;
+        return s->len == t->len && memcmp(s->chars, t->chars, s->len) == 0;
+    }
+    return 0;
+}
+
+/*
+ * Runtime errors.
+ */
+void cool_dispatch_abort(const char *file, int line)
+{
+    printf("%s:%d", file, line);
+    die(": Dispatch to void.\n");
+}
+
+void cool_case_abort2(const char *file, int line)
+{
+    printf("%s:%d", file, line);
+    die("Match on void in case statement.\n");
+}
+
+void cool_case_abort(Object *o)
+{
+    fputs("No match in case statement for Class ", stdout);
+    print_class_name(o);
+    die("\n");
+}
+
+void cool_divide_by_zero(void)
+{
+    die("  Exception 9  [Breakpoint/Division by 0]  Execution aborted\n");
+}
+
+void cool_overflow(void)
+{
+    die("  Exception 12  [Arithmetic overflow]  Execution aborted\n");
+}
+
+int main(void)
+{
+    grow(heap_size);
+    cool_main();
+    fputs("COOL program successfully executed\n", stdout);
+    return 0;
+}
@@ -0,0 +1,156 @@
+/*
+ * Runtime interface of Cool programs compiled to C with cgen -m c.
+ *
+ * Every class becomes a struct that starts with an Object header; its
+ * attributes follow, those it inherits first.  Int and Bool values are
+ * plain ints wherever their static type is Int or Bool, and are boxed
+ * into CoolInt objects only when they are used as an Object.
+ *
+ * With -g (or -G) the generated code keeps every reference it holds in
+ * a frame of roots linked from cool_frames, and the runtime has a
+ * copying collector; otherwise the heap only grows.
+ */
+#ifndef COOLRT_H
+#define COOLRT_H
+
+#include <stddef.h>
+#include <string.h>
+
+typedef void (*CoolMethod)(void);
+
+typedef struct Object Object;
+struct Object {
+    int tag;
+    int size;			/* in bytes, header included */
+    const CoolMethod *disp;
+};
+
+/* Int and Bool */
+typedef struct CoolInt {
+    Object h;
+    int val;
+} CoolInt;
+
+/* chars points just past the object unless the string is a constant */
+typedef struct CoolString {
+    Object h;
+    int len;
+    const char *chars;
+} CoolString;
+
+/* per class, indexed by tag */
+typedef struct CoolClass {
+    Object *proto;
+    Object *(*init)(Object *);
+    Object *name;		/* a String */
+    const int *ptrs;		/* offsets of references, ending in 0 */
+} CoolClass;
+
+/* the references held by a function, for the collector */
+struct cool_frame {
+    struct cool_frame *prev;
+    long n;
+    Object **r;
+};
+
+/* from the generated code */
+extern const CoolClass cool_class_table[];
+extern const int cool_int_tag, cool_bool_tag, cool_string_tag;
+extern const int cool_gc, cool_gc_test;
+extern CoolInt Int_proto, bool_const0, bool_const1;
+extern CoolString String_proto;
+extern void cool_main(void);
+
+/* the runtime */
+extern struct cool_frame *cool_frames;
+extern char *cool_alloc_ptr, *cool_alloc_limit;
+extern const int cool_no_ptrs[];
+
+Object *cool_alloc_slow(size_t bytes);
+Object *cool_new_self(Object *self);
+int cool_equal(Object *a, Object *b);
+void cool_dispatch_abort(const char *file, int line);
+void cool_case_abort2(const char *file, int line);
+void cool_case_abort(Object *o);
+void cool_divide_by_zero(void);
+void cool_overflow(void);
+
+Object *Object__abort(Object *self);
+Object *Object__type_name(Object *self);
+Object *Object__copy(Object *self);
+Object *IO__out_string(Object *self, Object *s);
+Object *IO__out_int(Object *self, int i);
+Object *IO__in_string(Object *self);
+int IO__in_int(Object *self);
+int String__length(Object *self);
+Object *String__concat(Object *self, Object *s);
+Object *String__substr(Object *self, int i, int l);
+
+/*
+ * A copy of the prototype proto.  It is not initialized, and nothing
+ * but the new object may be held across the call.
+ */
+static inline Object *cool_new(const Object *proto)
+{
+    size_t bytes = (proto->size + 7) & ~(size_t) 7;
+    Object *o = (Object *) cool_alloc_ptr;
+    if (cool_alloc_ptr + bytes > cool_alloc_limit)
+        o = cool_alloc_slow(bytes);
+    else
+        cool_alloc_ptr += bytes;
+    memcpy(o, proto, proto->size);
+    return o;
+}
+
+static inline Object *cool_box_int(int val)
+{
+    CoolInt *i = (CoolInt *) cool_new(&Int_proto.h);
+    i->val = val;
+    return &i->h;
+}
+
+static inline Object *cool_box_bool(int val)
+{
+    return val ? &bool_const1.h : &bool_const0.h;
+}
+
+static inline int cool_unbox(Object *o)
+{
+    return ((CoolInt *) o)->val;
+}
+
+/*
+ * Int arithmetic behaves as on the machine: add, sub and neg trap on
+ * overflow, mul and div wrap around.
+ */
+static inline int cool_add(int a, int b)
+{
+    int r;
+    if (__builtin_add_overflow(a, b, &r))
+        cool_overflow();
+    return r;
+}
+
+static inline int cool_sub(int a, int b)
+{
+    int r;
+    if (__builtin_sub_overflow(a, b, &r))
+        cool_overflow();
+    return r;
+}
+
+static inline int cool_mul(int a, int b)
+{
+    return (int) ((unsigned) a * (unsigned) b);
+}
+
+static inline int cool_div(int a, int b)
+{
+    if (b == 0)
+        cool_divide_by_zero();
+    if (b == -1)
+        return (int) (0u - (unsigned) a);
+    return a / b;
+}
+
+#endif
@@ -0,0 +1,653 @@
+//
+// Two-pass assembler for the SPIM dialect used by cgen output and
+// lib/trap.handler.  The first pass assigns addresses to labels, the
+// second pass decodes instructions and lays out static data.
+//
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "sim.h"
+
+enum SegKind { SEG_TEXT, SEG_KTEXT, SEG_DATA, SEG_KDATA };
+
+struct Line {
+    std::string file;
+    int lineno;
+    SegKind seg;
+    std::string op;                     // mnemonic or directive
+    std::vector<std::string> args;      // operands
+    std::string str;                    // string literal for .ascii(z)
+};
+
+static std::vector<Line> lines;
+static std::map<std::string, int32_t> constants;
+static bool asm_errors;
+
+static void asm_error(const Line &l, const std::string &msg) {
+    fprintf(stderr, "%s:%d: %s\n", l.file.c_str(), l.lineno, msg.c_str());
+    asm_errors = true;
+}
+
+//
+// Register names
+//
+static const char *reg_names[32] = {
+    "zero", "at", "v0", "v1", "a0", "a1", "a2", "a3",
+    "t0", "t1", "t2", "t3", "t4", "t5", "t6", "t7",
+    "s0", "s1", "s2", "s3", "s4", "s5", "s6", "s7",
+    "t8", "t9", "k0", "k1", "gp", "sp", "fp", "ra"
+};
+
+static int parse_reg(const std::string &s) {
+    if (s.size() < 2 || s[0] != '$')
+        return -1;
+    const char *p = s.c_str() + 1;
+    if (isdigit(*p)) {
+        int n = atoi(p);
+        return n >= 0 && n < 32 ? n : -1;
+    }
+    if (strcmp(p, "s8") == 0)
+        return 30;
+    for (int i = 0; i < 32; i++)
+        if (strcmp(p, reg_names[i]) == 0)
+            return i;
+    return -1;
+}
+
+//
+// Lexing
+//
+static std::string trim(const std::string &s) {
+    size_t b = 0, e = s.size();
+    while (b < e && isspace((unsigned char) s[b])) b++;
+    while (e > b && isspace((unsigned char) s[e - 1])) e--;
+    return s.substr(b, e - b);
+}
+
+static bool is_ident_char(char c) {
+    return isalnum((unsigned char) c) || c == '_' || c == '.' || c == '$';
+}
+
+// Strip a comment, honouring string literals.
+static std::string strip_comment(const std::string &s) {
+    bool in_str = false;
+    for (size_t i = 0; i < s.size(); i++) {
+        if (in_str) {
+            if (s[i] == '\\') i++;
+            else if (s[i] == '"') in_str = false;
+        } else if (s[i] == '"') {
+            in_str = true;
+        } else if (s[i] == '#') {
+            return s.substr(0, i);
+        }
+    }
+    return s;
+}
+
+static bool parse_string_literal(const std::string &s, std::string &out) {
+    size_t i = s.find('"');
+    if (i == std::string::npos)
+        return false;
+    for (i++; i < s.size() && s[i] != '"'; i++) {
+        if (s[i] != '\\') {
+            out += s[i];
+            continue;
+        }
+        i++;
+        if (i >= s.size())
+            return false;
+        switch (s[i]) {
+        case 'n': out += '\n'; break;
+        case 't': out += '\t'; break;
+        case '0': out += '\0'; break;
+        case '\\': out += '\\'; break;
+        case '"': out += '"'; break;
+        default: out += s[i]; break;
+        }
+    }
+    return i < s.size();
+}
+
+static std::vector<std::string> split_operands(const std::string &s) {
+    std::vector<std::string> out;
+    std::string cur;
+    int depth = 0;
+    for (size_t i = 0; i < s.size(); i++) {
+        char c = s[i];
+        if (c == '(') depth++;
+        if (c == ')') depth--;
+        if (depth == 0 && (c == ',' || isspace((unsigned char) c))) {
+            if (!cur.empty()) out.push_back(cur);
+            cur.clear();
+        } else {
+            cur += c;
+        }
+    }
+    if (!cur.empty()) out.push_back(cur);
+    return out;
+}
+
+static bool read_file(const std::string &name, SegKind &seg) {
+    FILE *f = fopen(name.c_str(), "r");
+    if (!f) {
+        fprintf(stderr, "coolsim: cannot open %s\n", name.c_str());
+        return false;
+    }
+    char buf[4096];
+    int lineno = 0;
+    while (fgets(buf, sizeof buf, f)) {
+        lineno++;
+        std::string s = trim(strip_comment(buf));
+        while (!s.empty()) {
+            Line l;
+            l.file = name;
+            l.lineno = lineno;
+
+            // label definitions
+            size_t i = 0;
+            while (i < s.size() && is_ident_char(s[i])) i++;
+            if (i > 0 && i < s.size() && s[i] == ':') {
+                l.seg = seg;
+                l.op = ":";
+                l.args.push_back(s.substr(0, i));
+                lines.push_back(l);
+                s = trim(s.substr(i + 1));
+                continue;
+            }
+
+            // constant definitions: name=value
+            size_t eq = s.find('=');
+            if (i > 0 && eq != std::string::npos && s.find('"') == std::string::npos &&
+                trim(s.substr(0, eq)).find_first_of(" \t") == std::string::npos) {
+                l.seg = seg;
+                l.op = "=";
+                l.args.push_back(trim(s.substr(0, eq)));
+                l.args.push_back(trim(s.substr(eq + 1)));
+                lines.push_back(l);
+                break;
+            }
+
+            size_t sp = s.find_first_of(" \t");
+            l.op = sp == std::string::npos ? s : s.substr(0, sp);
+            std::string rest = sp == std::string::npos ? "" : trim(s.substr(sp));
+            if (l.op == ".ascii" || l.op == ".asciiz") {
+                if (!parse_string_literal(rest, l.str))
+                    asm_error(l, "malformed string literal");
+            } else {
+                l.args = split_operands(rest);
+            }
+
+            if (l.op == ".text") seg = SEG_TEXT;
+            else if (l.op == ".ktext") seg = SEG_KTEXT;
+            else if (l.op == ".data") seg = SEG_DATA;
+            else if (l.op == ".kdata") seg = SEG_KDATA;
+            l.seg = seg;
+            lines.push_back(l);
+            break;
+        }
+    }
+    fclose(f);
+    return true;
+}
+
+//
+// Expressions: numbers, symbols, and symbol+number / symbol-number.
+//
+static bool lookup_symbol(Machine &m, const std::string &name, int32_t &v) {
+    std::map<std::string, int32_t>::iterator c = constants.find(name);
+    if (c != constants.end()) {
+        v = c->second;
+        return true;
+    }
+    std::map<std::string, uint32_t>::iterator s = m.symbols.find(name);
+    if (s != m.symbols.end()) {
+        v = (int32_t) s->second;
+        return true;
+    }
+    return false;
+}
+
+static bool parse_number(const std::string &s, int32_t &v) {
+    if (s.empty())
+        return false;
+    const char *p = s.c_str();
+    char *end;
+    if (*p == '\'' && s.size() == 3 && s[2] == '\'') {
+        v = s[1];
+        return true;
+    }
+    long long n = strtoll(p, &end, 0);
+    if (*end != '\0' || end == p)
+        return false;
+    v = (int32_t) n;
+    return true;
+}
+
+static bool eval(Machine &m, const std::string &s, int32_t &v) {
+    if (parse_number(s, v))
+        return true;
+    size_t op = s.find_first_of("+-", 1);
+    if (op != std::string::npos) {
+        int32_t a, b;
+        if (!eval(m, s.substr(0, op), a) || !eval(m, s.substr(op + 1), b))
+            return false;
+        v = s[op] == '+' ? a + b : a - b;
+        return true;
+    }
+    return lookup_symbol(m, s, v);
+}
+
+//
+// Pass 1: addresses
+//
+static uint32_t align_to(uint32_t loc, uint32_t n) {
+    return (loc + n - 1) & ~(n - 1);
+}
+
+static uint32_t data_size(const Line &l, uint32_t loc) {
+    if (l.op == ".word")   return align_to(loc, 4) - loc + 4 * l.args.size();
+    if (l.op == ".half")   return align_to(loc, 2) - loc + 2 * l.args.size();
+    if (l.op == ".byte")   return l.args.size();
+    if (l.op == ".ascii")  return l.str.size();
+    if (l.op == ".asciiz") return l.str.size() + 1;
+    if (l.op == ".space")  return l.args.empty() ? 0 : strtoul(l.args[0].c_str(), 0, 0);
+    if (l.op == ".align")  return align_to(loc, 1u << atoi(l.args[0].c_str())) - loc;
+    return 0;
+}
+
+static bool is_insn(const Line &l) {
+    return l.op != ":" && l.op != "=" && l.op[0] != '.';
+}
+
+static void pass1(Machine &m) {
+    uint32_t loc[4] = { TEXT_BASE, KTEXT_BASE, DATA_BASE, KDATA_BASE };
+    for (size_t i = 0; i < lines.size(); i++) {
+        Line &l = lines[i];
+        if (l.op == ".ktext" && !l.args.empty())
+            loc[SEG_KTEXT] = strtoul(l.args[0].c_str(), 0, 0);
+        if (l.op == ":") {
+            // a label on a .word binds to the aligned address
+            if (i + 1 < lines.size() && lines[i + 1].op == ".word" &&
+                (l.seg == SEG_DATA || l.seg == SEG_KDATA))
+                loc[l.seg] = align_to(loc[l.seg], 4);
+            if (m.symbols.count(l.args[0]))
+                asm_error(l, "label " + l.args[0] + " defined twice");
+            m.symbols[l.args[0]] = loc[l.seg];
+            if (l.seg == SEG_TEXT || l.seg == SEG_KTEXT)
+                m.text_labels[l.seg == SEG_KTEXT].push_back(
+                    std::make_pair(loc[l.seg], l.args[0]));
+        } else if (l.op == ".globl") {
+            m.globals.insert(l.args.begin(), l.args.end());
+        } else if (l.op == "=") {
+            int32_t v;
+            if (!eval(m, l.args[1], v))
+                asm_error(l, "bad constant " + l.args[1]);
+            constants[l.args[0]] = v;
+        } else if (is_insn(l)) {
+            loc[l.seg] += INSN_SIZE;
+        } else {
+            loc[l.seg] += data_size(l, loc[l.seg]);
+        }
+    }
+}
+
+//
+// Pass 2: instructions
+//
+struct Mnemonic {
+    const char *name;
+    int r_op;           // operation with a register last operand
+    int i_op;           // operation with an immediate last operand
+};
+
+static const Mnemonic alu_ops[] = {
+    { "add", OP_ADD, OP_ADDI },   { "addu", OP_ADDU, OP_ADDIU },
+    { "addi", OP_ADD, OP_ADDI },  { "addiu", OP_ADDU, OP_ADDIU },
+    { "sub", OP_SUB, OP_SUBI },   { "subu", OP_SUBU, OP_SUBIU },
+    { "mul", OP_MUL, OP_MULI },   { "mulo", OP_MUL, OP_MULI },
+    { "mulou", OP_MUL, OP_MULI },
+    { "div", OP_DIV, OP_DIVI },   { "divu", OP_DIV, OP_DIVI },
+    { "rem", OP_REM, OP_REMI },   { "remu", OP_REM, OP_REMI },
+    { "and", OP_AND, OP_ANDI },   { "andi", OP_AND, OP_ANDI },
+    { "or", OP_OR, OP_ORI },      { "ori", OP_OR, OP_ORI },
+    { "xor", OP_XOR, OP_XORI },   { "xori", OP_XOR, OP_XORI },
+    { "nor", OP_NOR, OP_NORI },
+    { "slt", OP_SLT, OP_SLTI },   { "slti", OP_SLT, OP_SLTI },
+    { "sltu", OP_SLTU, OP_SLTIU }, { "sltiu", OP_SLTU, OP_SLTIU },
+    { "sgt", OP_SGT, OP_SGTI },   { "seq", OP_SEQ, OP_SEQI },
+    { "sne", OP_SNE, OP_SNEI },   { "sle", OP_SLE, OP_SLEI },
+    { "sge", OP_SGE, OP_SGEI },
+    { "sll", OP_SLLV, OP_SLL },   { "sllv", OP_SLLV, OP_SLL },
+    { "srl", OP_SRLV, OP_SRL },   { "srlv", OP_SRLV, OP_SRL },
+    { "sra", OP_SRAV, OP_SRA },   { "srav", OP_SRAV, OP_SRA },
+    { 0, 0, 0 }
+};
+
+static const Mnemonic branch_ops[] = {
+    { "beq", OP_BEQ, OP_BEQI },   { "bne", OP_BNE, OP_BNEI },
+    { "blt", OP_BLT, OP_BLTI },   { "ble", OP_BLE, OP_BLEI },
+    { "bgt", OP_BGT, OP_BGTI },   { "bge", OP_BGE, OP_BGEI },
+    { "bltu", OP_BLTU, -1 },      { "bleu", OP_BLEU, -1 },
+    { "bgtu", OP_BGTU, -1 },      { "bgeu", OP_BGEU, -1 },
+    { 0, 0, 0 }
+};
+
+static const Mnemonic zbranch_ops[] = {
+    { "beqz", OP_BEQ, 0 }, { "bnez", OP_BNE, 0 }, { "bltz", OP_BLT, 0 },
+    { "blez", OP_BLE, 0 }, { "bgtz", OP_BGT, 0 }, { "bgez", OP_BGE, 0 },
+    { 0, 0, 0 }
+};
+
+static const Mnemonic mem_ops[] = {
+    { "lw", OP_LW, 0 }, { "sw", OP_SW, 0 }, { "lb", OP_LB, 0 },
+    { "lbu", OP_LBU, 0 }, { "sb", OP_SB, 0 }, { "lh", OP_LH, 0 },
+    { "lhu", OP_LHU, 0 }, { "sh", OP_SH, 0 },
+    { 0, 0, 0 }
+};
+
+static const Mnemonic *find(const Mnemonic *tab, const std::string &name) {
+    for (; tab->name; tab++)
+        if (name == tab->name)
+            return tab;
+    return 0;
+}
+
+// Parse "off(reg)", "(reg)", "label", "label(reg)", "label+off(reg)".
+static bool parse_mem(Machine &m, const std::string &s, int &base, int32_t &off) {
+    size_t p = s.find('(');
+    if (p == std::string::npos) {
+        base = 0;
+        return eval(m, s, off);
+    }
+    size_t q = s.find(')', p);
+    if (q == std::string::npos)
+        return false;
+    base = parse_reg(s.substr(p + 1, q - p - 1));
+    if (base < 0)
+        return false;
+    if (p == 0) {
+        off = 0;
+        return true;
+    }
+    return eval(m, s.substr(0, p), off);
+}
+
+static bool decode(Machine &m, const Line &l, Insn &in) {
+    const std::vector<std::string> &a = l.args;
+    const std::string &op = l.op;
+    const Mnemonic *mn;
+    in.op = OP_NOP;
+    in.rd = in.rs = in.rt = 0;
+    in.imm = in.aux = 0;
+
+    if ((op == "div" || op == "divu") && a.size() == 2 &&
+        parse_reg(a[1]) >= 0) {
+        in.op = OP_DIVHL;
+        in.rs = parse_reg(a[0]);
+        in.rt = parse_reg(a[1]);
+        return true;
+    }
+    if ((mn = find(alu_ops, op))) {
+        if (a.size() != 2 && a.size() != 3)
+            return false;
+        int rd = parse_reg(a[0]);
+        int rs = a.size() == 3 ? parse_reg(a[1]) : rd;
+        const std::string &last = a[a.size() - 1];
+        int rt = parse_reg(last);
+        if (rd < 0 || rs < 0)
+            return false;
+        in.rd = rd;
+        in.rs = rs;
+        if (rt >= 0) {
+            in.op = mn->r_op;
+            in.rt = rt;
+            // sllv and friends take the shift amount in rs
+            return true;
+        }
+        in.op = mn->i_op;
+        return eval(m, last, in.imm);
+    }
+    if ((mn = find(branch_ops, op))) {
+        if (a.size() != 3)
+            return false;
+        int rs = parse_reg(a[0]);
+        int rt = parse_reg(a[1]);
+        if (rs < 0)
+            return false;
+        in.rs = rs;
+        int32_t target;
+        if (!eval(m, a[2], target))
+            return false;
+        in.imm = target;
+        if (rt >= 0) {
+            in.op = mn->r_op;
+            in.rt = rt;
+            return true;
+        }
+        if (mn->i_op < 0)
+            return false;
+        in.op = mn->i_op;
+        in.imm = target;
+        return eval(m, a[1], in.aux);
+    }
+    if ((mn = find(zbranch_ops, op))) {
+        if (a.size() != 2 || parse_reg(a[0]) < 0)
+            return false;
+        in.op = mn->r_op;
+        in.rs = parse_reg(a[0]);
+        in.rt = 0;
+        return eval(m, a[1], in.imm);
+    }
+    if ((mn = find(mem_ops, op))) {
+        int base;
+        if (a.size() != 2 || parse_reg(a[0]) < 0 || !parse_mem(m, a[1], base, in.imm))
+            return false;
+        in.op = mn->r_op;
+        in.rt = parse_reg(a[0]);
+        in.rs = base;
+        return true;
+    }
+    if (op == "li" || op == "la") {
+        if (a.size() != 2 || parse_reg(a[0]) < 0)
+            return false;
+        in.rd = parse_reg(a[0]);
+        int base;
+        if (op == "la" && a[1].find('(') != std::string::npos) {
+            if (!parse_mem(m, a[1], base, in.imm))
+                return false;
+            in.op = OP_ADDIU;
+            in.rs = base;
+            return true;
+        }
+        in.op = OP_LI;
+        return eval(m, a[1], in.imm);
+    }
+    if (op == "lui") {
+        if (a.size() != 2 || parse_reg(a[0]) < 0 || !eval(m, a[1], in.imm))
+            return false;
+        in.op = OP_LI;
+        in.rd = parse_reg(a[0]);
+        in.imm <<= 16;
+        return true;
+    }
+    if (op == "move" || op == "neg" || op == "negu" || op == "not") {
+        if (a.size() != 2 && !(a.size() == 1 && op != "move"))
+            return false;
+        int rd = parse_reg(a[0]);
+        int rs = parse_reg(a[a.size() - 1]);
+        in.op = op == "move" ? OP_MOVE : op == "not" ? OP_NOT :
+                op == "neg" ? OP_NEG : OP_NEGU;
+        in.rd = rd;
+        in.rs = rs;
+        return rd >= 0 && rs >= 0;
+    }
+    if (op == "b" || op == "j" || op == "jal") {
+        if (a.size() != 1)
+            return false;
+        if (op == "jal") {
+            int r = parse_reg(a[0]);
+            if (r >= 0) {
+                in.op = OP_JALR;
+                in.rd = 31;
+                in.rs = r;
+                return true;
+            }
+        }
+        in.op = op == "jal" ? OP_JAL : OP_J;
+        return eval(m, a[0], in.imm);
+    }
+    if (op == "jr") {
+        if (a.size() != 1 || parse_reg(a[0]) < 0)
+            return false;
+        in.op = OP_JR;
+        in.rs = parse_reg(a[0]);
+        return true;
+    }
+    if (op == "jalr") {
+        in.op = OP_JALR;
+        if (a.size() == 1) {
+            in.rd = 31;
+            in.rs = parse_reg(a[0]);
+            return parse_reg(a[0]) >= 0;
+        }
+        if (a.size() == 2) {
+            in.rd = parse_reg(a[0]);
+            in.rs = parse_reg(a[1]);
+            return parse_reg(a[0]) >= 0 && parse_reg(a[1]) >= 0;
+        }
+        return false;
+    }
+    if (op == "mult" || op == "multu") {
+        if (a.size() != 2 || parse_reg(a[0]) < 0 || parse_reg(a[1]) < 0)
+            return false;
+        in.op = OP_MULT;
+        in.rs = parse_reg(a[0]);
+        in.rt = parse_reg(a[1]);
+        return true;
+    }
+    if (op == "mfhi" || op == "mflo") {
+        if (a.size() != 1 || parse_reg(a[0]) < 0)
+            return false;
+        in.op = op == "mfhi" ? OP_MFHI : OP_MFLO;
+        in.rd = parse_reg(a[0]);
+        return true;
+    }
+    if (op == "mfc0") {
+        if (a.size() != 2 || parse_reg(a[0]) < 0 || parse_reg(a[1]) < 0)
+            return false;
+        in.op = OP_MFC0;
+        in.rt = parse_reg(a[0]);
+        in.rd = parse_reg(a[1]);
+        return true;
+    }
+    if (op == "syscall") { in.op = OP_SYSCALL; return true; }
+    if (op == "rfe")     { in.op = OP_RFE; return true; }
+    if (op == "nop")     { in.op = OP_NOP; return true; }
+    if (op == "break")   { in.op = OP_BREAK; return true; }
+    return false;
+}
+
+static void put_word(Segment &s, uint32_t addr, uint32_t v) {
+    uint32_t off = addr - s.base;
+    if (s.bytes.size() < off + 4)
+        s.bytes.resize(off + 4);
+    memcpy(&s.bytes[off], &v, 4);
+}
+
+static void put_byte(Segment &s, uint32_t addr, uint8_t v) {
+    uint32_t off = addr - s.base;
+    if (s.bytes.size() < off + 1)
+        s.bytes.resize(off + 1);
+    s.bytes[off] = v;
+}
+
+static void pass2(Machine &m) {
+    uint32_t loc[4] = { TEXT_BASE, KTEXT_BASE, DATA_BASE, KDATA_BASE };
+    for (size_t i = 0; i < lines.size(); i++) {
+        Line &l = lines[i];
+        if (l.op == ".ktext" && !l.args.empty())
+            loc[SEG_KTEXT] = strtoul(l.args[0].c_str(), 0, 0);
+        if (l.op == ":" || l.op == "=")
+            continue;
+        if (is_insn(l)) {
+            Insn in;
+            if (l.seg != SEG_TEXT && l.seg != SEG_KTEXT) {
+                asm_error(l, "instruction outside of a text segment");
+                continue;
+            }
+            if (!decode(m, l, in))
+                asm_error(l, "cannot assemble `" + l.op + "'");
+            std::vector<Insn> &text = l.seg == SEG_TEXT ? m.text : m.ktext;
+            text.push_back(in);
+            loc[l.seg] += INSN_SIZE;
+            continue;
+        }
+
+        uint32_t size = data_size(l, loc[l.seg]);
+        if (l.seg == SEG_TEXT || l.seg == SEG_KTEXT) {
+            if (size)
+                asm_error(l, "data in a text segment");
+            continue;
+        }
+        Segment &seg = l.seg == SEG_DATA ? m.data : m.kdata;
+        uint32_t at = loc[l.seg];
+        if (l.op == ".word" || l.op == ".half") {
+            uint32_t n = l.op == ".word" ? 4 : 2;
+            at = align_to(at, n);
+            for (size_t k = 0; k < l.args.size(); k++, at += n) {
+                int32_t v;
+                if (!eval(m, l.args[k], v))
+                    asm_error(l, "undefined symbol " + l.args[k]);
+                if (n == 4) {
+                    put_word(seg, at, v);
+                } else {
+                    put_byte(seg, at, v & 0xff);
+                    put_byte(seg, at + 1, (v >> 8) & 0xff);
+                }
+            }
+        } else if (l.op == ".byte") {
+            for (size_t k = 0; k < l.args.size(); k++) {
+                int32_t v;
+                if (!eval(m, l.args[k], v))
+                    asm_error(l, "bad byte " + l.args[k]);
+                put_byte(seg, at++, v);
+            }
+        } else if (l.op == ".ascii" || l.op == ".asciiz") {
+            for (size_t k = 0; k < l.str.size(); k++)
+                put_byte(seg, at++, l.str[k]);
+            if (l.op == ".asciiz")
+                put_byte(seg, at++, 0);
+        } else if (size) {
+            // .space and .align padding
+            put_byte(seg, loc[l.seg] + size - 1, 0);
+        }
+        loc[l.seg] += size;
+    }
+    // Like SPIM, the data segment starts out larger than the static
+    // data; the heap (heap_start onwards) grows into it before the
+    // first sbrk.
+    m.data.bytes.resize(align_to(m.data.bytes.size() + 1, DATA_INITIAL));
+}
+
+bool assemble(Machine &m, const std::vector<std::string> &files) {
+    lines.clear();
+    constants.clear();
+    asm_errors = false;
+    for (size_t i = 0; i < files.size(); i++) {
+        SegKind seg = SEG_TEXT;
+        if (!read_file(files[i], seg))
+            return false;
+    }
+    pass1(m);
+    if (asm_errors)
+        return false;
+    pass2(m);
+    if (asm_errors)
+        return false;
+    if (!m.symbols.count("__start")) {
+        fprintf(stderr, "coolsim: no __start label\n");
+        return false;
+    }
+    m.entry = m.symbols["__start"];
+    return true;
+}
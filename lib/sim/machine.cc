@@ -0,0 +1,371 @@
+//
+// The interpreter.  Instructions are dispatched through a table of
+// label addresses (GCC computed goto); each handler ends by jumping
+// directly to the handler of the next instruction.
+//
+#include <stdlib.h>
+#include <string.h>
+#include "sim.h"
+
+const char *op_names[OP_COUNT] = {
+#define SIM_NAME(name) #name,
+    SIM_OPS(SIM_NAME)
+#undef SIM_NAME
+};
+
+// exception causes, as in the MIPS R2000 Cause register
+#define EXC_ADEL  4     // unaligned address in load / fetch
+#define EXC_ADES  5     // unaligned address in store
+#define EXC_IBE   6     // bad address in text read
+#define EXC_DBE   7     // bad address in data/stack read
+#define EXC_BP    9     // breakpoint / division by zero
+#define EXC_OV    12    // arithmetic overflow in add, sub, neg
+
+Machine::Machine() : entry(0), hi(0), lo(0), cause(0), epc(0),
+                     insn_count(0), watch(0), watch_count(0), profile(0), exit_code(0) {
+    data.base = DATA_BASE;
+    kdata.base = KDATA_BASE;
+    stack.base = STACK_TOP - STACK_SIZE;
+    stack.bytes.resize(STACK_SIZE);
+    memset(reg, 0, sizeof reg);
+    memset(op_count, 0, sizeof op_count);
+    reg[29] = INIT_SP;
+    reg[28] = INIT_GP;
+}
+
+static inline uint8_t *mem(Machine &m, uint32_t addr, uint32_t n) {
+    return m.memory(addr, n);
+}
+
+//
+// Counts an execution of in for -profile, and an allocation if in is
+// where the runtime copies an object.
+//
+static void profile_insn(Machine &m, Profile &p, const Insn *in,
+                         const Insn *utext, const Insn *ktext) {
+    p.seg = in >= ktext && in < ktext + m.ktext.size();
+    p.index = in - (p.seg ? ktext : utext);
+    p.hits[p.seg][p.index]++;
+    uint32_t addr = (p.seg ? KTEXT_BASE : TEXT_BASE) + INSN_SIZE * (uint32_t) p.index;
+    p.icache.access(addr);
+    if (addr == p.alloc_addr) {
+        uint8_t *o = mem(m, m.reg[4], 8);
+        if (o) {
+            int32_t tag, size;
+            memcpy(&tag, o, 4);
+            memcpy(&size, o + 4, 4);
+            p.allocs[tag].first++;
+            p.allocs[tag].second += 4 * (uint64_t) size;
+        }
+    }
+}
+
+static inline void profile_data(Profile &p, uint32_t addr) {
+    if (!p.dcache.access(addr))
+        p.dmisses[p.seg][p.index]++;
+}
+
+static bool read_line(char *buf, int size) {
+    if (size <= 0)
+        return false;
+    if (!fgets(buf, size, stdin)) {
+        buf[0] = '\0';
+        return false;
+    }
+    return true;
+}
+
+int Machine::run() {
+    static void *handlers[OP_COUNT] = {
+#define SIM_LABEL(name) &&do_##name,
+        SIM_OPS(SIM_LABEL)
+#undef SIM_LABEL
+    };
+
+    // sentinels catch execution falling off the end of a text segment
+    Insn stop = { OP_BREAK, 0, 0, 0, 0, -1 };
+    text.push_back(stop);
+    ktext.push_back(stop);
+
+    const Insn *utext = &text[0];
+    const Insn *ktext_p = &ktext[0];
+    Profile *prof = profile;
+    if (prof) {
+        for (int s = 0; s < 2; s++) {
+            size_t n = s ? ktext.size() : text.size();
+            prof->hits[s].assign(n, 0);
+            prof->dmisses[s].assign(n, 0);
+        }
+        std::map<std::string, uint32_t>::iterator a = symbols.find("_objcopy_allocated");
+        prof->alloc_addr = a == symbols.end() ? 0 : a->second;
+    }
+    uint32_t utext_end = TEXT_BASE + INSN_SIZE * (text.size() - 1);
+    uint32_t ktext_end = KTEXT_BASE + INSN_SIZE * (ktext.size() - 1);
+
+    int32_t *r = reg;
+    const Insn *pc;
+    const Insn *in;
+    uint32_t target, addr;
+    uint8_t *p;
+    int exc;
+
+#define ADDR_OF(ip) ((ip) >= ktext_p && (ip) < ktext_p + ktext.size() \
+                     ? KTEXT_BASE + INSN_SIZE * (uint32_t) ((ip) - ktext_p) \
+                     : TEXT_BASE + INSN_SIZE * (uint32_t) ((ip) - utext))
+#define JUMP(a) do { \
+        target = (a); \
+        if (target >= TEXT_BASE && target < utext_end && !(target & 3)) \
+            pc = utext + (target - TEXT_BASE) / INSN_SIZE; \
+        else if (target >= KTEXT_BASE && target < ktext_end && !(target & 3)) \
+            pc = ktext_p + (target - KTEXT_BASE) / INSN_SIZE; \
+        else { exc = EXC_IBE; goto exception; } \
+    } while (0)
+#define NEXT() do { \
+        r[0] = 0; \
+        in = pc++; \
+        op_count[in->op]++; \
+        if (prof) \
+            profile_insn(*this, *prof, in, utext, ktext_p); \
+        goto *handlers[in->op]; \
+    } while (0)
+#define RRR(name, expr) do_##name: { \
+        int32_t a = r[in->rs], b = r[in->rt]; (void) a; (void) b; \
+        r[in->rd] = (expr); NEXT(); }
+#define RRI(name, expr) do_##name: { \
+        int32_t a = r[in->rs], b = in->imm; (void) a; (void) b; \
+        r[in->rd] = (expr); NEXT(); }
+#define RRV(name, overflows, b_expr) do_##name: { \
+        int32_t v; \
+        if (overflows(r[in->rs], (b_expr), &v)) { exc = EXC_OV; goto exception; } \
+        r[in->rd] = v; NEXT(); }
+#define BR(name, cond) do_##name: { \
+        int32_t a = r[in->rs], b = r[in->rt]; \
+        uint32_t ua = a, ub = b; (void) ua; (void) ub; \
+        if (cond) { JUMP(in->imm); } \
+        NEXT(); }
+#define BRI(name, cond) do_##name: { \
+        int32_t a = r[in->rs], b = in->aux; \
+        if (cond) { JUMP(in->imm); } \
+        NEXT(); }
+#define LOAD(name, n, type) do_##name: { \
+        addr = r[in->rs] + in->imm; \
+        if (addr & (n - 1)) { exc = EXC_ADEL; goto exception; } \
+        if (!(p = mem(*this, addr, n))) { exc = EXC_DBE; goto exception; } \
+        if (prof) profile_data(*prof, addr); \
+        type v; memcpy(&v, p, n); r[in->rt] = v; NEXT(); }
+#define STORE(name, n, type) do_##name: { \
+        addr = r[in->rs] + in->imm; \
+        if (addr & (n - 1)) { exc = EXC_ADES; goto exception; } \
+        if (!(p = mem(*this, addr, n))) { exc = EXC_DBE; goto exception; } \
+        if (prof) profile_data(*prof, addr); \
+        type v = (type) r[in->rt]; memcpy(p, &v, n); NEXT(); }
+
+    pc = utext;
+    JUMP(entry);
+    NEXT();
+
+    RRV(ADD, __builtin_add_overflow, r[in->rt])
+    RRV(SUB, __builtin_sub_overflow, r[in->rt])
+    RRR(ADDU, (int32_t) ((uint32_t) a + (uint32_t) b))
+    RRR(SUBU, (int32_t) ((uint32_t) a - (uint32_t) b))
+    RRR(MUL, (int32_t) ((uint32_t) a * (uint32_t) b))
+    RRR(AND, a & b)
+    RRR(OR, a | b)
+    RRR(XOR, a ^ b)
+    RRR(NOR, ~(a | b))
+    RRR(SLT, a < b)
+    RRR(SLTU, (uint32_t) a < (uint32_t) b)
+    RRR(SGT, a > b)
+    RRR(SEQ, a == b)
+    RRR(SNE, a != b)
+    RRR(SLE, a <= b)
+    RRR(SGE, a >= b)
+    RRR(SLLV, (int32_t) ((uint32_t) a << (b & 31)))
+    RRR(SRLV, (int32_t) ((uint32_t) a >> (b & 31)))
+    RRR(SRAV, a >> (b & 31))
+    RRV(ADDI, __builtin_add_overflow, in->imm)
+    RRV(SUBI, __builtin_sub_overflow, in->imm)
+    RRI(ADDIU, (int32_t) ((uint32_t) a + (uint32_t) b))
+    RRI(SUBIU, (int32_t) ((uint32_t) a - (uint32_t) b))
+    RRI(MULI, (int32_t) ((uint32_t) a * (uint32_t) b))
+    RRI(ANDI, a & b)
+    RRI(ORI, a | b)
+    RRI(XORI, a ^ b)
+    RRI(NORI, ~(a | b))
+    RRI(SLTI, a < b)
+    RRI(SLTIU, (uint32_t) a < (uint32_t) b)
+    RRI(SGTI, a > b)
+    RRI(SEQI, a == b)
+    RRI(SNEI, a != b)
+    RRI(SLEI, a <= b)
+    RRI(SGEI, a >= b)
+    RRI(SLL, (int32_t) ((uint32_t) a << (b & 31)))
+    RRI(SRL, (int32_t) ((uint32_t) a >> (b & 31)))
+    RRI(SRA, a >> (b & 31))
+
+do_DIV:
+do_REM: {
+        int32_t a = r[in->rs], b = r[in->rt];
+        if (b == 0) { exc = EXC_BP; goto exception; }
+        if (a == INT32_MIN && b == -1)
+            r[in->rd] = in->op == OP_DIV ? a : 0;
+        else
+            r[in->rd] = in->op == OP_DIV ? a / b : a % b;
+        NEXT();
+    }
+do_DIVI:
+do_REMI: {
+        int32_t a = r[in->rs], b = in->imm;
+        if (b == 0) { exc = EXC_BP; goto exception; }
+        if (a == INT32_MIN && b == -1)
+            r[in->rd] = in->op == OP_DIVI ? a : 0;
+        else
+            r[in->rd] = in->op == OP_DIVI ? a / b : a % b;
+        NEXT();
+    }
+do_MULT: {
+        int64_t v = (int64_t) r[in->rs] * r[in->rt];
+        lo = (int32_t) v;
+        hi = (int32_t) (v >> 32);
+        NEXT();
+    }
+do_DIVHL: {
+        int32_t a = r[in->rs], b = r[in->rt];
+        if (b != 0 && !(a == INT32_MIN && b == -1)) {
+            lo = a / b;
+            hi = a % b;
+        }
+        NEXT();
+    }
+do_MFHI: r[in->rd] = hi; NEXT();
+do_MFLO: r[in->rd] = lo; NEXT();
+
+do_MOVE: r[in->rd] = r[in->rs]; NEXT();
+do_NEG:  if (r[in->rs] == INT32_MIN) { exc = EXC_OV; goto exception; }
+         r[in->rd] = -r[in->rs]; NEXT();
+do_NEGU: r[in->rd] = (int32_t) (0u - (uint32_t) r[in->rs]); NEXT();
+do_NOT:  r[in->rd] = ~r[in->rs]; NEXT();
+do_LI:   r[in->rd] = in->imm; NEXT();
+
+    LOAD(LW, 4, int32_t)
+    LOAD(LH, 2, int16_t)
+    LOAD(LHU, 2, uint16_t)
+    LOAD(LB, 1, int8_t)
+    LOAD(LBU, 1, uint8_t)
+    STORE(SW, 4, int32_t)
+    STORE(SH, 2, int16_t)
+    STORE(SB, 1, int8_t)
+
+    BR(BEQ, a == b)
+    BR(BNE, a != b)
+    BR(BLT, a < b)
+    BR(BLE, a <= b)
+    BR(BGT, a > b)
+    BR(BGE, a >= b)
+    BR(BLTU, ua < ub)
+    BR(BLEU, ua <= ub)
+    BR(BGTU, ua > ub)
+    BR(BGEU, ua >= ub)
+    BRI(BEQI, a == b)
+    BRI(BNEI, a != b)
+    BRI(BLTI, a < b)
+    BRI(BLEI, a <= b)
+    BRI(BGTI, a > b)
+    BRI(BGEI, a >= b)
+
+do_J:    JUMP(in->imm); NEXT();
+do_JAL:  if ((uint32_t) in->imm == watch) watch_count++;
+         r[31] = ADDR_OF(pc); JUMP(in->imm); NEXT();
+do_JR:   JUMP(r[in->rs]); NEXT();
+do_JALR: {
+        uint32_t t = r[in->rs];
+        if (prof)
+            prof->jalr_targets.insert(t);
+        r[in->rd] = ADDR_OF(pc);
+        JUMP(t);
+        NEXT();
+    }
+
+do_MFC0:
+    r[in->rt] = in->rd == 13 ? (int32_t) cause : in->rd == 14 ? (int32_t) epc : 0;
+    NEXT();
+do_RFE:
+do_NOP:
+    NEXT();
+do_BREAK:
+    if (in->aux == -1) {
+        fprintf(stderr, "coolsim: execution fell off the end of the text segment\n");
+        exit_code = 1;
+        goto done;
+    }
+    exc = EXC_BP;
+    goto exception;
+
+do_SYSCALL:
+    switch (r[2]) {
+    case 1:     // print_int
+        printf("%d", r[4]);
+        break;
+    case 4: {   // print_string
+        uint32_t a = r[4];
+        while ((p = mem(*this, a, 1)) && *p)
+            putchar(*p), a++;
+        break;
+    }
+    case 5: {   // read_int
+        char buf[256];
+        read_line(buf, sizeof buf);
+        r[2] = (int32_t) strtol(buf, 0, 10);
+        break;
+    }
+    case 8: {   // read_string
+        int32_t n = r[5];
+        if (n <= 0 || !(p = mem(*this, r[4], n))) {
+            exc = EXC_DBE;
+            goto exception;
+        }
+        read_line((char *) p, n);
+        break;
+    }
+    case 9: {   // sbrk
+        uint32_t brk = data.base + data.bytes.size();
+        int32_t n = (r[4] + 7) & ~7;
+        data.bytes.resize(data.bytes.size() + n);
+        r[2] = brk;
+        break;
+    }
+    case 10:    // exit
+        goto done;
+    case 11:    // print_char
+        putchar(r[4]);
+        break;
+    case 17:    // exit2
+        exit_code = r[4];
+        goto done;
+    default:
+        fprintf(stderr, "coolsim: unknown syscall %d\n", r[2]);
+        exit_code = 1;
+        goto done;
+    }
+    NEXT();
+
+exception:
+    // hand the exception to the kernel handler in trap.handler
+    epc = ADDR_OF(in);
+    cause = exc << 2;
+    if (ktext.size() <= 1) {
+        fprintf(stderr, "coolsim: exception %d at 0x%08x\n", exc, epc);
+        exit_code = 1;
+        goto done;
+    }
+    pc = ktext_p;
+    NEXT();
+
+done:
+    for (int i = 0; i < OP_COUNT; i++)
+        insn_count += op_count[i];
+    fflush(stdout);
+    text.pop_back();
+    ktext.pop_back();
+    return exit_code;
+}
@@ -0,0 +1,135 @@
+//
+// coolsim driver
+//
+//   coolsim [-trap_file file] [-stats] [-count label] [-profile]
+//           [-profile-json file] [-cache bytes,ways,line] [-file] program.s
+//
+// The trap handler defaults to $DEFAULT_TRAP_HANDLER, or else to
+// lib/trap.handler next to the directory of the executable.  Unlike
+// spim, coolsim prints nothing but the program's output; -stats adds
+// the number of instructions executed of each kind, and -count the
+// number of jal instructions to label, on stderr.
+//
+// -profile reports on stderr the instructions, loads, stores and data
+// cache misses of each method and each label, the objects allocated of
+// each class, and the hit rates of an L1 instruction and data cache
+// (32K, 4-way, 32-byte lines unless -cache says otherwise);
+// -profile-json writes the same to file.  See profile.cc.
+//
+#include <algorithm>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "sim.h"
+
+static void usage(const char *prog) {
+    fprintf(stderr, "usage: %s [-trap_file file] [-stats] [-count label] [-profile]\n"
+            "\t[-profile-json file] [-cache bytes,ways,line] [-file] program.s\n", prog);
+    exit(1);
+}
+
+// lib/trap.handler relative to the directory holding the executable
+static std::string default_trap_file(const char *argv0) {
+    const char *env = getenv("DEFAULT_TRAP_HANDLER");
+    if (env)
+        return env;
+    std::string dir = argv0;
+    size_t slash = dir.rfind('/');
+    dir = slash == std::string::npos ? "." : dir.substr(0, slash);
+    return dir + "/../lib/trap.handler";
+}
+
+// the instructions executed of each kind, most frequent first
+static void print_stats(const Machine &m) {
+    std::vector<std::pair<uint64_t, int> > ops;
+    for (int i = 0; i < OP_COUNT; i++)
+        if (m.op_count[i])
+            ops.push_back(std::make_pair(m.op_count[i], i));
+    std::sort(ops.rbegin(), ops.rend());
+
+    fprintf(stderr, "instructions executed: %llu\n", (unsigned long long) m.insn_count);
+    for (size_t i = 0; i < ops.size(); i++)
+        fprintf(stderr, "  %-8s %12llu %6.2f%%\n", op_names[ops[i].second],
+                (unsigned long long) ops[i].first, 100.0 * ops[i].first / m.insn_count);
+}
+
+int main(int argc, char *argv[]) {
+    std::string trap_file = default_trap_file(argv[0]);
+    std::string program;
+    bool stats = false;
+    std::string watch_label;
+    bool profile = false;
+    std::string profile_json;
+    unsigned cache_size = 32768, cache_ways = 4, cache_line = 32;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-trap_file") == 0 || strcmp(argv[i], "-exception_file") == 0) {
+            if (++i == argc) usage(argv[0]);
+            trap_file = argv[i];
+        } else if (strcmp(argv[i], "-file") == 0) {
+            if (++i == argc) usage(argv[0]);
+            program = argv[i];
+        } else if (strcmp(argv[i], "-count") == 0) {
+            if (++i == argc) usage(argv[0]);
+            watch_label = argv[i];
+        } else if (strcmp(argv[i], "-stats") == 0) {
+            stats = true;
+        } else if (strcmp(argv[i], "-profile") == 0) {
+            profile = true;
+        } else if (strcmp(argv[i], "-profile-json") == 0) {
+            if (++i == argc) usage(argv[0]);
+            profile_json = argv[i];
+        } else if (strcmp(argv[i], "-cache") == 0) {
+            if (++i == argc ||
+                sscanf(argv[i], "%u,%u,%u", &cache_size, &cache_ways, &cache_line) != 3)
+                usage(argv[0]);
+        } else if (argv[i][0] == '-') {
+            usage(argv[0]);
+        } else {
+            program = argv[i];
+        }
+    }
+    if (program.empty())
+        usage(argv[0]);
+
+    static char outbuf[1 << 16];
+    setvbuf(stdout, outbuf, _IOFBF, sizeof outbuf);
+
+    Machine m;
+    std::vector<std::string> files;
+    files.push_back(trap_file);
+    files.push_back(program);
+    if (!assemble(m, files))
+        return 1;
+
+    Profile prof;
+    if (profile || !profile_json.empty()) {
+        if (!prof.icache.init(cache_size, cache_ways, cache_line) ||
+            !prof.dcache.init(cache_size, cache_ways, cache_line)) {
+            fprintf(stderr, "%s: bad cache geometry %u,%u,%u\n", argv[0],
+                    cache_size, cache_ways, cache_line);
+            return 1;
+        }
+        m.profile = &prof;
+    }
+
+    if (!watch_label.empty())
+        m.watch = m.symbols[watch_label];
+    int status = m.run();
+    if (!watch_label.empty())
+        fprintf(stderr, "calls to %s: %llu\n", watch_label.c_str(), (unsigned long long) m.watch_count);
+    if (stats)
+        print_stats(m);
+    if (profile)
+        print_profile(m, stderr);
+    if (!profile_json.empty()) {
+        FILE *f = fopen(profile_json.c_str(), "w");
+        if (!f) {
+            perror(profile_json.c_str());
+            return 1;
+        }
+        write_profile_json(m, f);
+        fclose(f);
+    }
+    return status;
+}
@@ -0,0 +1,309 @@
+//
+// -profile: where a run spent its instructions, memory accesses and
+// cache misses, and what it allocated.
+//
+// Counts are kept per instruction while the program runs and summed
+// here by the regions cgen's labels mark out.  A label region runs
+// from a text label to the next one.  A method region runs from the
+// label of a method, Class.method or Class_init, or of a runtime
+// routine to the next such label, so it takes in the label regions of
+// its branch targets: cgen's label<N>, and the runtime's local labels,
+// which start with `_' and are not called.
+//
+#include <algorithm>
+#include <string.h>
+#include "sim.h"
+
+bool Cache::init(uint32_t size_, uint32_t ways_, uint32_t line_) {
+    size = size_;
+    ways = ways_;
+    line = line_;
+    if (ways == 0 || line == 0 || (line & (line - 1)) || size % (ways * line))
+        return false;
+    sets = size / (ways * line);
+    if (sets == 0)
+        return false;
+    for (line_shift = 0; (1u << line_shift) < line; line_shift++)
+        ;
+    tags.assign((size_t) sets * ways, 0);
+    used.assign((size_t) sets * ways, 0);
+    clock = hits = misses = 0;
+    return true;
+}
+
+struct Region {
+    std::string name;
+    std::string method;             // of a label region
+    uint64_t insns, loads, stores, dmisses;
+
+    Region(const std::string &n, const std::string &m)
+        : name(n), method(m), insns(0), loads(0), stores(0), dmisses(0) {}
+};
+
+static bool by_insns(const Region &a, const Region &b) {
+    return a.insns > b.insns;
+}
+
+static bool is_load(int op) {
+    return op == OP_LW || op == OP_LB || op == OP_LBU || op == OP_LH || op == OP_LHU;
+}
+
+static bool is_store(int op) {
+    return op == OP_SW || op == OP_SB || op == OP_SH;
+}
+
+// cgen's branch targets, label<N>
+static bool is_branch_label(const std::string &name) {
+    if (name.compare(0, 5, "label") != 0 || name.size() == 5)
+        return false;
+    for (size_t i = 5; i < name.size(); i++)
+        if (name[i] < '0' || name[i] > '9')
+            return false;
+    return true;
+}
+
+// labels that start a method region: those of cgen's methods and
+// tables, and of runtime routines that are .globl or were called,
+// whether by jal or (as the collectors are, through _MemMgr_*) by jalr
+static bool is_routine(Machine &m, const std::string &name, uint32_t addr,
+                       const std::vector<uint32_t> &called) {
+    if (is_branch_label(name))
+        return false;
+    return name[0] != '_' || m.globals.count(name) ||
+           std::binary_search(called.begin(), called.end(), addr) ||
+           m.profile->jalr_targets.count(addr);
+}
+
+static void add(Region &r, const Insn &in, uint64_t hits, uint64_t dmisses) {
+    r.insns += hits;
+    if (is_load(in.op))
+        r.loads += hits;
+    else if (is_store(in.op))
+        r.stores += hits;
+    r.dmisses += dmisses;
+}
+
+//
+// The label and method regions of the program, each with what its
+// instructions did, and the totals.  Regions nothing ran in are left out.
+//
+static void regions(Machine &m, std::vector<Region> &labels,
+                    std::vector<Region> &methods, Region &total) {
+    Profile &p = *m.profile;
+    std::vector<uint32_t> called(1, m.entry);
+    for (int seg = 0; seg < 2; seg++) {
+        const std::vector<Insn> &text = seg ? m.ktext : m.text;
+        for (size_t i = 0; i < text.size(); i++)
+            if (text[i].op == OP_JAL)
+                called.push_back((uint32_t) text[i].imm);
+    }
+    std::sort(called.begin(), called.end());
+
+    for (int seg = 0; seg < 2; seg++) {
+        const std::vector<Insn> &text = seg ? m.ktext : m.text;
+        const std::vector<std::pair<uint32_t, std::string> > &marks = m.text_labels[seg];
+        uint32_t base = seg ? KTEXT_BASE : TEXT_BASE;
+        size_t next = 0;
+        Region label("(unlabeled)", "(unlabeled)"), method("(unlabeled)", "");
+
+        for (size_t i = 0; i + 1 < text.size(); i++) {
+            uint32_t addr = base + INSN_SIZE * (uint32_t) i;
+            while (next < marks.size() && marks[next].first <= addr) {
+                const std::string &name = marks[next++].second;
+                if (label.insns)
+                    labels.push_back(label);
+                if (is_routine(m, name, addr, called)) {
+                    if (method.insns)
+                        methods.push_back(method);
+                    method = Region(name, "");
+                }
+                label = Region(name, method.name);
+            }
+            uint64_t hits = p.hits[seg][i], dmisses = p.dmisses[seg][i];
+            if (hits) {
+                add(label, text[i], hits, dmisses);
+                add(method, text[i], hits, dmisses);
+                add(total, text[i], hits, dmisses);
+            }
+        }
+        if (label.insns)
+            labels.push_back(label);
+        if (method.insns)
+            methods.push_back(method);
+    }
+    std::stable_sort(labels.begin(), labels.end(), by_insns);
+    std::stable_sort(methods.begin(), methods.end(), by_insns);
+}
+
+//
+// The name of the class with tag, from cgen's class_nameTab of String
+// objects: the length is an Int at offset 12, the characters at 16.
+//
+static std::string class_name(Machine &m, int32_t tag) {
+    char buf[32];
+    snprintf(buf, sizeof buf, "tag %d", tag);
+    std::map<std::string, uint32_t>::iterator tab = m.symbols.find("class_nameTab");
+    uint8_t *w;
+    uint32_t str, len_obj;
+    int32_t len;
+    if (tag < 0 || tab == m.symbols.end() ||
+        !(w = m.memory(tab->second + 4 * tag, 4)))
+        return buf;
+    memcpy(&str, w, 4);
+    if (!(w = m.memory(str + 12, 4)))
+        return buf;
+    memcpy(&len_obj, w, 4);
+    if (!(w = m.memory(len_obj + 12, 4)))
+        return buf;
+    memcpy(&len, w, 4);
+    if (len < 0 || !(w = m.memory(str + 16, len)))
+        return buf;
+    return std::string((const char *) w, len);
+}
+
+struct Alloc {
+    std::string name;
+    int32_t tag;
+    uint64_t count, bytes;
+};
+
+static bool by_count(const Alloc &a, const Alloc &b) {
+    return a.count > b.count;
+}
+
+static std::vector<Alloc> allocations(Machine &m) {
+    std::vector<Alloc> allocs;
+    std::map<int32_t, std::pair<uint64_t, uint64_t> >::iterator i;
+    for (i = m.profile->allocs.begin(); i != m.profile->allocs.end(); ++i) {
+        Alloc a;
+        a.name = class_name(m, i->first);
+        a.tag = i->first;
+        a.count = i->second.first;
+        a.bytes = i->second.second;
+        allocs.push_back(a);
+    }
+    std::stable_sort(allocs.begin(), allocs.end(), by_count);
+    return allocs;
+}
+
+static double percent(uint64_t part, uint64_t whole) {
+    return whole ? 100.0 * part / whole : 0.0;
+}
+
+static void print_cache(FILE *f, const char *what, const Cache &c) {
+    fprintf(f, "%s cache (%u bytes, %u-way, %u-byte lines): %llu hits, %llu misses, %.2f%% miss rate\n",
+            what, c.size, c.ways, c.line, (unsigned long long) c.hits,
+            (unsigned long long) c.misses, percent(c.misses, c.hits + c.misses));
+}
+
+static void print_regions(FILE *f, const char *what, const std::vector<Region> &rs,
+                          uint64_t total) {
+    fprintf(f, "\n%-40s %12s %7s %11s %11s %10s\n", what, "instructions", "%",
+            "loads", "stores", "D-misses");
+    for (size_t i = 0; i < rs.size(); i++)
+        fprintf(f, "%-40s %12llu %6.2f%% %11llu %11llu %10llu\n", rs[i].name.c_str(),
+                (unsigned long long) rs[i].insns, percent(rs[i].insns, total),
+                (unsigned long long) rs[i].loads, (unsigned long long) rs[i].stores,
+                (unsigned long long) rs[i].dmisses);
+}
+
+void print_profile(Machine &m, FILE *f) {
+    std::vector<Region> labels, methods;
+    Region total("total", "");
+    regions(m, labels, methods, total);
+
+    fprintf(f, "instructions executed: %llu\n", (unsigned long long) total.insns);
+    fprintf(f, "loads: %llu  stores: %llu\n", (unsigned long long) total.loads,
+            (unsigned long long) total.stores);
+    print_cache(f, "I", m.profile->icache);
+    print_cache(f, "D", m.profile->dcache);
+    print_regions(f, "method", methods, total.insns);
+    print_regions(f, "label", labels, total.insns);
+
+    std::vector<Alloc> allocs = allocations(m);
+    uint64_t count = 0, bytes = 0;
+    for (size_t i = 0; i < allocs.size(); i++) {
+        count += allocs[i].count;
+        bytes += allocs[i].bytes;
+    }
+    fprintf(f, "\n%-40s %12s %7s %11s\n", "allocations", "objects", "%", "bytes");
+    for (size_t i = 0; i < allocs.size(); i++)
+        fprintf(f, "%-40s %12llu %6.2f%% %11llu\n", allocs[i].name.c_str(),
+                (unsigned long long) allocs[i].count, percent(allocs[i].count, count),
+                (unsigned long long) allocs[i].bytes);
+    fprintf(f, "%-40s %12llu %7s %11llu\n", "total", (unsigned long long) count, "",
+            (unsigned long long) bytes);
+}
+
+//
+// JSON.
+//
+static void json_string(FILE *f, const std::string &s) {
+    putc('"', f);
+    for (size_t i = 0; i < s.size(); i++) {
+        unsigned char c = s[i];
+        if (c == '"' || c == '\\')
+            fprintf(f, "\\%c", c);
+        else if (c < 0x20)
+            fprintf(f, "\\u%04x", c);
+        else
+            putc(c, f);
+    }
+    putc('"', f);
+}
+
+static void json_cache(FILE *f, const char *what, const Cache &c) {
+    fprintf(f, "  \"%s\": {\"size\": %u, \"ways\": %u, \"line\": %u, \"hits\": %llu, \"misses\": %llu},\n",
+            what, c.size, c.ways, c.line, (unsigned long long) c.hits,
+            (unsigned long long) c.misses);
+}
+
+static void json_regions(FILE *f, const char *what, const std::vector<Region> &rs,
+                         bool labels) {
+    fprintf(f, "  \"%s\": [", what);
+    for (size_t i = 0; i < rs.size(); i++) {
+        fprintf(f, "%s\n    {\"name\": ", i ? "," : "");
+        json_string(f, rs[i].name);
+        if (labels) {
+            fprintf(f, ", \"method\": ");
+            json_string(f, rs[i].method);
+        }
+        fprintf(f, ", \"instructions\": %llu, \"loads\": %llu, \"stores\": %llu, \"dcache_misses\": %llu}",
+                (unsigned long long) rs[i].insns, (unsigned long long) rs[i].loads,
+                (unsigned long long) rs[i].stores, (unsigned long long) rs[i].dmisses);
+    }
+    fprintf(f, "\n  ],\n");
+}
+
+void write_profile_json(Machine &m, FILE *f) {
+    std::vector<Region> labels, methods;
+    Region total("total", "");
+    regions(m, labels, methods, total);
+
+    fprintf(f, "{\n  \"instructions\": %llu,\n  \"loads\": %llu,\n  \"stores\": %llu,\n",
+            (unsigned long long) total.insns, (unsigned long long) total.loads,
+            (unsigned long long) total.stores);
+    json_cache(f, "icache", m.profile->icache);
+    json_cache(f, "dcache", m.profile->dcache);
+    fprintf(f, "  \"opcodes\": {");
+    bool first = true;
+    for (int i = 0; i < OP_COUNT; i++)
+        if (m.op_count[i]) {
+            fprintf(f, "%s\"%s\": %llu", first ? "" : ", ", op_names[i],
+                    (unsigned long long) m.op_count[i]);
+            first = false;
+        }
+    fprintf(f, "},\n");
+    json_regions(f, "methods", methods, false);
+    json_regions(f, "labels", labels, true);
+
+    std::vector<Alloc> allocs = allocations(m);
+    fprintf(f, "  \"allocations\": [");
+    for (size_t i = 0; i < allocs.size(); i++) {
+        fprintf(f, "%s\n    {\"class\": ", i ? "," : "");
+        json_string(f, allocs[i].name);
+        fprintf(f, ", \"tag\": %d, \"objects\": %llu, \"bytes\": %llu}", allocs[i].tag,
+                (unsigned long long) allocs[i].count, (unsigned long long) allocs[i].bytes);
+    }
+    fprintf(f, "\n  ]\n}\n");
+}
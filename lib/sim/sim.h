@@ -0,0 +1,189 @@
+//
+// coolsim -- a MIPS32 simulator for the SPIM assembly emitted by cgen
+// and the Cool runtime in lib/trap.handler, for test runs in place of
+// spim.
+//
+// Source files are assembled once into an array of pre-decoded
+// instructions (one Insn per source instruction, pseudo-instructions
+// included) which the interpreter in machine.cc executes with
+// threaded dispatch, counting the instructions of each kind.
+//
+#ifndef COOLSIM_SIM_H_
+#define COOLSIM_SIM_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+
+#define TEXT_BASE    0x00400000u
+#define KTEXT_BASE   0x80000080u
+#define DATA_BASE    0x10000000u
+#define KDATA_BASE   0x90000000u
+#define STACK_TOP    0x80000000u
+#define STACK_SIZE   (8u << 20)
+#define INIT_SP      0x7fffeffcu
+#define INIT_GP      0x10008000u
+#define DATA_INITIAL 0x10000u
+#define INSN_SIZE    4
+
+//
+// Operations.  `R' forms take three registers, `I' forms take two
+// registers and an immediate.  Pseudo-instructions that SPIM expands
+// into several machine instructions are kept as single operations.
+// ADD, SUB and NEG trap on signed overflow; the `U' forms wrap.
+//
+#define SIM_OPS(X) \
+    X(ADD) X(ADDU) X(SUB) X(SUBU) X(MUL) X(DIV) X(REM) X(AND) X(OR) X(XOR) X(NOR) \
+    X(SLT) X(SLTU) X(SGT) X(SEQ) X(SNE) X(SLE) X(SGE) \
+    X(SLLV) X(SRLV) X(SRAV) \
+    X(ADDI) X(ADDIU) X(SUBI) X(SUBIU) X(MULI) X(DIVI) X(REMI) X(ANDI) X(ORI) X(XORI) X(NORI) \
+    X(SLTI) X(SLTIU) X(SGTI) X(SEQI) X(SNEI) X(SLEI) X(SGEI) \
+    X(SLL) X(SRL) X(SRA) \
+    X(MOVE) X(NEG) X(NEGU) X(NOT) X(LI) \
+    X(LW) X(SW) X(LB) X(LBU) X(SB) X(LH) X(LHU) X(SH) \
+    X(BEQ) X(BNE) X(BLT) X(BLE) X(BGT) X(BGE) \
+    X(BLTU) X(BLEU) X(BGTU) X(BGEU) \
+    X(BEQI) X(BNEI) X(BLTI) X(BLEI) X(BGTI) X(BGEI) \
+    X(J) X(JAL) X(JR) X(JALR) \
+    X(MULT) X(DIVHL) X(MFHI) X(MFLO) \
+    X(SYSCALL) X(MFC0) X(RFE) X(NOP) X(BREAK)
+
+enum Op {
+#define SIM_ENUM(name) OP_##name,
+    SIM_OPS(SIM_ENUM)
+#undef SIM_ENUM
+    OP_COUNT
+};
+
+extern const char *op_names[OP_COUNT];
+
+//
+// A decoded instruction.  Branch and jump targets are absolute
+// addresses in `imm'; branches that compare against a constant keep
+// the constant in `aux'.
+//
+struct Insn {
+    uint8_t op;
+    uint8_t rd;
+    uint8_t rs;
+    uint8_t rt;
+    int32_t imm;
+    int32_t aux;
+};
+
+//
+// A contiguous region of simulated memory.
+//
+struct Segment {
+    uint32_t base;
+    std::vector<uint8_t> bytes;
+
+    bool contains(uint32_t addr, uint32_t n) const {
+        return addr >= base && addr - base + n <= bytes.size();
+    }
+};
+
+//
+// A set-associative cache with LRU replacement, which only counts.
+//
+struct Cache {
+    uint32_t size, ways, line;          // in bytes, ways, bytes
+    uint32_t sets, line_shift;
+    std::vector<uint32_t> tags;         // line number + 1 per way, 0 if empty
+    std::vector<uint64_t> used;         // when each way was last used
+    uint64_t clock, hits, misses;
+
+    bool init(uint32_t size, uint32_t ways, uint32_t line);
+
+    // is the byte at addr in the cache?  It is afterwards.
+    bool access(uint32_t addr) {
+        uint32_t tag = (addr >> line_shift) + 1;
+        size_t set = (size_t) ((addr >> line_shift) % sets) * ways;
+        size_t victim = set;
+        clock++;
+        for (size_t w = set; w < set + ways; w++) {
+            if (tags[w] == tag) {
+                used[w] = clock;
+                hits++;
+                return true;
+            }
+            if (used[w] < used[victim])
+                victim = w;
+        }
+        tags[victim] = tag;
+        used[victim] = clock;
+        misses++;
+        return false;
+    }
+};
+
+//
+// What -profile collects while the program runs; profile.cc sums it
+// up by label and by method when it is reported.
+//
+struct Profile {
+    std::vector<uint64_t> hits[2];      // executions of each instruction
+    std::vector<uint64_t> dmisses[2];   // its data cache misses
+    int seg;                            // of the instruction executing:
+    size_t index;                       //   0 text, 1 ktext, and its index
+    Cache icache, dcache;
+    uint32_t alloc_addr;                // where $a0 is the object copied
+    std::map<int32_t, std::pair<uint64_t, uint64_t> > allocs;  // tag: count, bytes
+    std::set<uint32_t> jalr_targets;    // routines called through a register
+};
+
+struct Machine {
+    // text
+    std::vector<Insn> text;             // user text at TEXT_BASE
+    std::vector<Insn> ktext;            // kernel text at KTEXT_BASE
+
+    // data
+    Segment data;                       // static data + heap (grows via sbrk)
+    Segment kdata;
+    Segment stack;
+
+    std::map<std::string, uint32_t> symbols;    // label -> address
+    std::vector<std::pair<uint32_t, std::string> > text_labels[2];  // text, ktext
+    std::set<std::string> globals;      // names declared .globl
+    uint32_t entry;
+
+    // registers
+    int32_t reg[32];
+    int32_t hi, lo;
+    uint32_t cause, epc;
+
+    // statistics
+    uint64_t insn_count;                // set when run() returns
+    uint64_t op_count[OP_COUNT];
+    uint32_t watch;                     // count jal to this address
+    uint64_t watch_count;
+    Profile *profile;                   // or 0
+
+    int exit_code;
+
+    Machine();
+    int run();
+
+    // simulated memory at [addr, addr+n), or 0 if it is not mapped
+    uint8_t *memory(uint32_t addr, uint32_t n) {
+        if (data.contains(addr, n))
+            return &data.bytes[addr - data.base];
+        if (stack.contains(addr, n))
+            return &stack.bytes[addr - stack.base];
+        if (kdata.contains(addr, n))
+            return &kdata.bytes[addr - kdata.base];
+        return 0;
+    }
+};
+
+// assembler.cc
+bool assemble(Machine &m, const std::vector<std::string> &files);
+
+// profile.cc
+void print_profile(Machine &m, FILE *f);
+void write_profile_json(Machine &m, FILE *f);
+
+#endif
@@ -0,0 +1,111 @@
+/*
+ * The Cool bytecode written by cgen -m bytecode and run by coolvm.
+ *
+ * A program is a sequence of 32-bit little-endian words:
+ *
+ *	magic, version
+ *	Int tag, Bool tag, String tag
+ *	number of string constants, then each as a string (below)
+ *	number of classes, then in tag order:
+ *	    name (a string constant), initializer (a function),
+ *	    number of attributes, then for each the kind of its
+ *	    default value: BC_INT, BC_VOID, or a string constant,
+ *	    number of dispatch table slots, then their functions
+ *	number of functions, then for each:
+ *	    name as a string, file name (a string constant), native
+ *	    method (BC_NOT_NATIVE for code), number of reference and
+ *	    of int registers, number of reference and of int formals,
+ *	    length of the code in words, the code
+ *	Main's tag, the function of Main.main
+ *
+ * A string is its length followed by its characters, four to a word.
+ *
+ * Functions have two register files: references, which the collector
+ * scans, and ints, which hold Int and Bool values of static type Int
+ * or Bool.  Reference register 0 is self, reference formals follow it
+ * and int formals start at int register 0.  An instruction is an
+ * opcode followed by the operands its signature lists:
+ *
+ *	r  reference register	i  int register
+ *	d  either register: its number times two, plus one for int
+ *	n  a number		s  a string constant
+ *	c  a class tag		f  a function
+ *	l  the code offset of a jump target
+ *	x  a word for the interpreter's use (an inline cache), zero
+ *	*  a count of arguments followed by that many d operands
+ */
+#ifndef BYTECODE_H
+#define BYTECODE_H
+
+#define BC_MAGIC	0x434c4f43	/* "COLC" */
+#define BC_VERSION	1
+
+#define BC_INT		(-1)		/* default value of an Int or Bool */
+#define BC_VOID		(-2)		/* default value of a reference */
+#define BC_NOT_NATIVE	0
+
+#define BC_OPCODES(OP) \
+	OP(MOVR, "rr")		/* r1 = r2 */ \
+	OP(MOVI, "ii")		/* i1 = i2 */ \
+	OP(LDI, "in")		/* i = n */ \
+	OP(LDS, "rs")		/* r = string constant */ \
+	OP(LDNULL, "r")		/* r = void */ \
+	OP(GETR, "rn")		/* r = attribute n of self */ \
+	OP(GETI, "in") \
+	OP(SETR, "nr")		/* attribute n of self = r */ \
+	OP(SETI, "ni") \
+	OP(ADD, "iii")		/* i1 = i2 + i3 */ \
+	OP(SUB, "iii") \
+	OP(MUL, "iii") \
+	OP(DIV, "iii") \
+	OP(NEG, "ii") \
+	OP(LT, "iii") \
+	OP(LE, "iii") \
+	OP(EQI, "iii") \
+	OP(NOT, "ii") \
+	OP(EQR, "irr")		/* i = (r1 = r2) as Cool compares them */ \
+	OP(ISVOID, "ir") \
+	OP(BOXI, "ri")		/* r = a new Int holding i */ \
+	OP(BOXB, "ri")		/* r = the Bool for i */ \
+	OP(UNBOX, "ir")		/* i = the value of the Int or Bool r */ \
+	OP(TAG, "ir")		/* i = class tag of r */ \
+	OP(NEW, "rc")		/* r = a new, initialized object of class c */ \
+	OP(NEWSELF, "r")	/* r = a new object of self's class */ \
+	OP(JMP, "l") \
+	OP(JF, "il")		/* jump if i is false */ \
+	OP(JT, "il") \
+	OP(JFLT, "iil")		/* jump unless i1 < i2 */ \
+	OP(JFLE, "iil") \
+	OP(JFEQ, "iil") \
+	OP(JTLT, "iil")		/* jump if i1 < i2 */ \
+	OP(JTLE, "iil") \
+	OP(JTEQ, "iil") \
+	OP(JOUT, "innl")	/* jump unless n1 <= i <= n2 */ \
+	OP(CALL, "dfnr*")	/* d = f(r, args); n is the line */ \
+	OP(DISPATCH, "dnnrxx*")	/* d = slot n1 of r's class (r, args) */ \
+	OP(RET, "d") \
+	OP(CASEVOID, "rn")	/* abort if r is void; n is the line */ \
+	OP(CASEABORT, "r")	/* no branch of a case matched r */
+
+#define BC_OPCODE_ENUM(name, sig)	BC_##name,
+enum { BC_OPCODES(BC_OPCODE_ENUM) BC_NUM_OPCODES };
+#undef BC_OPCODE_ENUM
+
+/* the methods of the basic classes, implemented by the interpreter */
+#define BC_NATIVES(N) \
+	N(OBJECT_ABORT, "Object.abort") \
+	N(OBJECT_TYPE_NAME, "Object.type_name") \
+	N(OBJECT_COPY, "Object.copy") \
+	N(IO_OUT_STRING, "IO.out_string") \
+	N(IO_OUT_INT, "IO.out_int") \
+	N(IO_IN_STRING, "IO.in_string") \
+	N(IO_IN_INT, "IO.in_int") \
+	N(STRING_LENGTH, "String.length") \
+	N(STRING_CONCAT, "String.concat") \
+	N(STRING_SUBSTR, "String.substr")
+
+#define BC_NATIVE_ENUM(name, method)	BC_##name,
+enum { BC_NO_NATIVE = BC_NOT_NATIVE, BC_NATIVES(BC_NATIVE_ENUM) BC_NUM_NATIVES };
+#undef BC_NATIVE_ENUM
+
+#endif
@@ -0,0 +1,1001 @@
+/*
+ * coolvm: runs the bytecode written by cgen -m bytecode.
+ *
+ *	coolvm [-t] program.bc
+ *
+ * Loading translates each function's code once into direct-threaded
+ * form: every opcode becomes the address of its handler in run(), jump
+ * targets become pointers into the code, and string constants and
+ * functions become pointers too.  An instruction ends by jumping
+ * straight to the handler of the next (GCC's computed goto), so there
+ * is no central dispatch loop.
+ *
+ * Each dynamic dispatch site carries a monomorphic inline cache, the
+ * class tag and method of its last receiver, and looks in the dispatch
+ * table only when the receiver's class changes.
+ *
+ * Objects live in a single heap, with a mark-compact (Lisp-2) collector:
+ * it marks what the reference registers reach, computes where each live
+ * object will slide to, updates the references and slides the objects
+ * down.  Registers are the only roots; constants and prototypes are
+ * outside the heap and never refer into it.  With -t it collects at
+ * every allocation.
+ *
+ * Runtime errors are reported with the messages of lib/trap.handler.
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include "bytecode.h"
+
+#define STR_MAXSIZE	1026		/* longest line in_string reads */
+#define HEAP_RESERVE	((size_t) 1 << 36)	/* address space for the heap */
+#define HEAP_MIN	((size_t) 1 << 20)
+#define RSTACK_SIZE	(1 << 22)	/* reference registers */
+#define ISTACK_SIZE	(1 << 22)	/* int registers */
+#define FRAMES		(1 << 20)	/* nested calls */
+
+/*
+ * An object is a header followed by its fields, one word each.  An Int
+ * or Bool has its value in field 0; a String has its length in field 0
+ * and its characters, with a terminating 0, after it.
+ */
+typedef struct Obj Obj;
+struct Obj {
+    int32_t tag;
+    int32_t words;		/* size in words, header included */
+    Obj *fwd;			/* set while collecting */
+};
+
+typedef union Slot {
+    Obj *ref;
+    long i;
+} Slot;
+
+#define HEADER_WORDS	((long) (sizeof(Obj) / sizeof(Slot)))
+#define FIELDS(o)	((Slot *) ((o) + 1))
+#define CHARS(o)	((char *) (FIELDS(o) + 1))
+
+typedef struct Func Func;
+
+typedef union Code {
+    const void *op;		/* address of the handler */
+    long n;
+    Obj *s;
+    Func *f;
+    union Code *l;
+} Code;
+
+struct Func {
+    char *name;
+    Obj *file;
+    int native;
+    int nref, nint;
+    int nref_formals, nint_formals;
+    Code *code;
+};
+
+typedef struct Class {
+    Obj *name;
+    Func *init;			/* NULL if it would only return self */
+    int nfields;
+    char *is_ref;		/* which fields are references */
+    Obj *proto;
+    int nslots;
+    Func **vtab;
+} Class;
+
+/* a call in progress: where its caller resumes */
+typedef struct Frame {
+    Code *pc;
+    Func *fn;
+    Obj **r;
+    int *i;
+    long dst;			/* the caller's register for the result */
+} Frame;
+
+static int int_tag, bool_tag, string_tag;
+static int nstrings, nclasses, nfuncs;
+static Obj **strings;
+static Class *classes;
+static Func *funcs;
+static Obj *bool_obj[2];
+
+static Obj **rstack, **rtop;		/* the roots are rstack[0..rtop) */
+static int *istack;
+static Frame *frames;
+
+static char *heap_lo, *heap_ptr, *heap_limit, *heap_end;
+static int gc_test;
+
+static void die(const char *msg)
+{
+    fputs(msg, stdout);
+    fflush(stdout);
+    exit(0);
+}
+
+static void fatal(const char *msg, const char *arg)
+{
+    fflush(stdout);
+    fprintf(stderr, "coolvm: %s%s\n", msg, arg);
+    exit(1);
+}
+
+static void *xmalloc(size_t n)
+{
+    void *p = calloc(1, n ? n : 1);
+    if (p == NULL)
+        fatal("out of memory", "");
+    return p;
+}
+
+
+/*
+ * Memory.
+ */
+static int in_heap(Obj *o)
+{
+    return (char *) o >= heap_lo && (char *) o < heap_ptr;
+}
+
+static Slot *ref_fields(Obj *o, int *n)
+{
+    if (o->tag == int_tag || o->tag == bool_tag || o->tag == string_tag) {
+        *n = 0;
+        return NULL;
+    }
+    *n = classes[o->tag].nfields;
+    return FIELDS(o);
+}
+
+static Obj **mark_stack;
+static long mark_sp, mark_size;
+
+static void mark(Obj *o)
+{
+    if (o == NULL || !in_heap(o) || o->fwd != NULL)
+        return;
+    o->fwd = o;
+    if (mark_sp == mark_size) {
+        mark_size = mark_size ? 2 * mark_size : 1024;
+        mark_stack = realloc(mark_stack, mark_size * sizeof(Obj *));
+        if (mark_stack == NULL)
+            fatal("out of memory", "");
+    }
+    mark_stack[mark_sp++] = o;
+}
+
+static void update(Obj **p)
+{
+    if (*p != NULL && in_heap(*p))
+        *p = (*p)->fwd;
+}
+
+/*
+ * Mark, compute forwarding addresses, update references, slide.
+ * Afterwards the heap may grow to twice what is live (and need).
+ */
+static void collect(size_t need)
+{
+    Obj **r;
+    char *p, *to;
+
+    for (r = rstack; r < rtop; r++)
+        mark(*r);
+    while (mark_sp > 0) {
+        Obj *o = mark_stack[--mark_sp];
+        int n;
+        Slot *f = ref_fields(o, &n);
+        for (int k = 0; k < n; k++)
+            if (classes[o->tag].is_ref[k])
+                mark(f[k].ref);
+    }
+
+    to = heap_lo;
+    for (p = heap_lo; p < heap_ptr; p += ((Obj *) p)->words * sizeof(Slot)) {
+        Obj *o = (Obj *) p;
+        if (o->fwd != NULL) {
+            o->fwd = (Obj *) to;
+            to += o->words * sizeof(Slot);
+        }
+    }
+
+    for (r = rstack; r < rtop; r++)
+        update(r);
+    for (p = heap_lo; p < heap_ptr; p += ((Obj *) p)->words * sizeof(Slot)) {
+        Obj *o = (Obj *) p;
+        int n;
+        if (o->fwd == NULL)
+            continue;
+        Slot *f = ref_fields(o, &n);
+        for (int k = 0; k < n; k++)
+            if (classes[o->tag].is_ref[k])
+                update(&f[k].ref);
+    }
+
+    for (p = heap_lo; p < heap_ptr; ) {
+        Obj *o = (Obj *) p;
+        size_t bytes = o->words * sizeof(Slot);
+        p += bytes;
+        if (o->fwd != NULL) {
+            Obj *dest = o->fwd;
+            memmove(dest, o, bytes);
+            dest->fwd = NULL;
+        }
+    }
+    heap_ptr = to;
+
+    size_t size = 2 * ((heap_ptr - heap_lo) + need);
+    if (size < HEAP_MIN)
+        size = HEAP_MIN;
+    if (size > (size_t) (heap_end - heap_lo))
+        size = heap_end - heap_lo;
+    heap_limit = heap_lo + size;
+}
+
+/* references held in C variables are stale afterwards */
+static Obj *alloc(long words)
+{
+    size_t bytes = words * sizeof(Slot);
+    if (heap_ptr + bytes > heap_limit || gc_test) {
+        collect(bytes);
+        if (heap_ptr + bytes > heap_limit)
+            die("Out of memory.\n");
+    }
+    Obj *o = (Obj *) heap_ptr;
+    heap_ptr += bytes;
+    o->words = words;
+    o->fwd = NULL;
+    return o;
+}
+
+static Obj *copy_of(Obj *proto)
+{
+    Obj *o = alloc(proto->words);
+    memcpy(o, proto, proto->words * sizeof(Slot));
+    o->fwd = NULL;
+    return o;
+}
+
+static long string_words(long len)
+{
+    return HEADER_WORDS + 1 + (len + sizeof(Slot)) / sizeof(Slot);
+}
+
+static Obj *new_string(long len)
+{
+    Obj *o = alloc(string_words(len));
+    o->tag = string_tag;
+    memset(FIELDS(o), 0, (o->words - HEADER_WORDS) * sizeof(Slot));
+    FIELDS(o)[0].i = len;
+    return o;
+}
+
+static Obj *new_int(int val)
+{
+    Obj *o = alloc(HEADER_WORDS + 1);
+    o->tag = int_tag;
+    FIELDS(o)[0].i = val;
+    return o;
+}
+
+
+/*
+ * Methods of the basic classes.  They find self and their arguments in
+ * their registers r and i, and leave a reference result in r[0] or an
+ * int one in i[0].
+ */
+static void print_class_name(Obj *o)
+{
+    Obj *name = classes[o->tag].name;
+    fwrite(CHARS(name), 1, FIELDS(name)[0].i, stdout);
+}
+
+/* reads a line, or nothing at the end of the input */
+static void read_line(char *buf, int size)
+{
+    fflush(stdout);
+    if (!fgets(buf, size, stdin))
+        buf[0] = '\0';
+}
+
+static void call_native(int native, Obj **r, int *i)
+{
+    char buf[STR_MAXSIZE];
+    long len, len1, len2, start, n;
+    Obj *o;
+
+    switch (native) {
+    case BC_OBJECT_ABORT:
+        fputs("Abort called from class ", stdout);
+        print_class_name(r[0]);
+        die("\n");
+    case BC_OBJECT_TYPE_NAME:
+        r[0] = classes[r[0]->tag].name;
+        break;
+    case BC_OBJECT_COPY:
+        o = alloc(r[0]->words);
+        memcpy(o, r[0], r[0]->words * sizeof(Slot));
+        o->fwd = NULL;
+        r[0] = o;
+        break;
+    case BC_IO_OUT_STRING:
+        fwrite(CHARS(r[1]), 1, FIELDS(r[1])[0].i, stdout);
+        break;
+    case BC_IO_OUT_INT:
+        printf("%d", i[0]);
+        break;
+    case BC_IO_IN_STRING:
+        /* as in trap.handler, the end of the input reads as a newline */
+        read_line(buf, sizeof buf);
+        len = strlen(buf);
+        if (len == 0)
+            buf[len++] = '\n';
+        else if (buf[len - 1] == '\n')
+            len--;
+        o = new_string(len);
+        memcpy(CHARS(o), buf, len);
+        r[0] = o;
+        break;
+    case BC_IO_IN_INT:
+        read_line(buf, 256);
+        i[0] = (int) strtol(buf, NULL, 10);
+        break;
+    case BC_STRING_LENGTH:
+        i[0] = FIELDS(r[0])[0].i;
+        break;
+    case BC_STRING_CONCAT:
+        len1 = FIELDS(r[0])[0].i;
+        len2 = FIELDS(r[1])[0].i;
+        if (len2 == 0)
+            break;
+        o = new_string(len1 + len2);
+        memcpy(CHARS(o), CHARS(r[0]), len1);
+        memcpy(CHARS(o) + len1, CHARS(r[1]), len2);
+        r[0] = o;
+        break;
+    case BC_STRING_SUBSTR:
+        len = FIELDS(r[0])[0].i;
+        start = i[0];
+        n = i[1];
+        if (start < 0)
+            die("Index to substr is negative\nExecution aborted.\n");
+        if (start > len)
+            die("Index to substr is too big\nExecution aborted.\n");
+        if (start + n > len)
+            die("Length to substr too long\nExecution aborted.\n");
+        if (n < 0)
+            die("Length to substr is negative\nExecution aborted.\n");
+        o = new_string(n);
+        memcpy(CHARS(o), CHARS(r[0]) + start, n);
+        r[0] = o;
+        break;
+    }
+}
+
+/*
+ * = on two references: Ints, Bools and Strings are compared by value,
+ * anything else by identity.
+ */
+static int equal(Obj *a, Obj *b)
+{
+    if (a == b)
+        return 1;
+    if (a == NULL || b == NULL || a->tag != b->tag)
+        return 0;
+    if (a->tag == int_tag || a->tag == bool_tag)
+        return FIELDS(a)[0].i == FIELDS(b)[0].i;
+    if (a->tag == string_tag)
+        return FIELDS(a)[0].i == FIELDS(b)[0].i &&
+            memcmp(CHARS(a), CHARS(b), FIELDS(a)[0].i) == 0;
+    return 0;
+}
+
+static void print_position(Func *fn, long line)
+{
+    fwrite(CHARS(fn->file), 1, FIELDS(fn->file)[0].i, stdout);
+    printf(":%ld", line);
+}
+
+
+/*
+ * Loading.
+ */
+static const char *signatures[] = {
+#define BC_SIGNATURE(name, sig) sig,
+    BC_OPCODES(BC_SIGNATURE)
+#undef BC_SIGNATURE
+};
+
+/* the registers and results of the basic methods */
+static const struct { int nref_formals, nint_formals, nint; } natives[] = {
+    { 0, 0, 0 },
+    { 0, 0, 0 },		/* Object.abort */
+    { 0, 0, 0 },		/* Object.type_name */
+    { 0, 0, 0 },		/* Object.copy */
+    { 1, 0, 0 },		/* IO.out_string */
+    { 0, 1, 1 },		/* IO.out_int */
+    { 0, 0, 0 },		/* IO.in_string */
+    { 0, 0, 1 },		/* IO.in_int */
+    { 0, 0, 1 },		/* String.length */
+    { 1, 0, 0 },		/* String.concat */
+    { 0, 2, 2 },		/* String.substr */
+};
+
+static int32_t *words, *word_end;
+static const char *bc_file;
+
+static void bad(const char *what)
+{
+    fatal(what, bc_file);
+}
+
+static int32_t next_word(void)
+{
+    if (words >= word_end)
+        bad("truncated bytecode in ");
+    return *words++;
+}
+
+static int32_t next_index(int limit)
+{
+    int32_t n = next_word();
+    if (n < 0 || n >= limit)
+        bad("bad bytecode in ");
+    return n;
+}
+
+static char *next_chars(int32_t *len)
+{
+    *len = next_word();
+    if (*len < 0 || (word_end - words) * 4 < *len)
+        bad("truncated bytecode in ");
+    char *s = (char *) words;
+    words += (*len + 3) / 4;
+    return s;
+}
+
+static Obj *static_string(const char *s, long len)
+{
+    Obj *o = xmalloc(string_words(len) * sizeof(Slot));
+    o->tag = string_tag;
+    o->words = string_words(len);
+    FIELDS(o)[0].i = len;
+    memcpy(CHARS(o), s, len);
+    return o;
+}
+
+static void load_strings(void)
+{
+    nstrings = next_word();
+    strings = xmalloc(nstrings * sizeof(Obj *));
+    for (int k = 0; k < nstrings; k++) {
+        int32_t len;
+        char *s = next_chars(&len);
+        strings[k] = static_string(s, len);
+    }
+}
+
+/*
+ * Initializers and dispatch tables are left as function numbers until
+ * the functions are loaded.
+ */
+static void load_classes(void)
+{
+    nclasses = next_word();
+    classes = xmalloc(nclasses * sizeof(Class));
+    for (int t = 0; t < nclasses; t++) {
+        Class *c = &classes[t];
+        c->name = strings[next_index(nstrings)];
+        c->init = (Func *) (long) next_word();
+        c->nfields = next_word();
+        c->is_ref = xmalloc(c->nfields);
+        c->proto = xmalloc((HEADER_WORDS + c->nfields) * sizeof(Slot));
+        c->proto->tag = t;
+        c->proto->words = HEADER_WORDS + c->nfields;
+        for (int k = 0; k < c->nfields; k++) {
+            int32_t kind = next_word();
+            c->is_ref[k] = kind != BC_INT;
+            if (kind >= nstrings)
+                bad("bad bytecode in ");
+            if (kind >= 0)
+                FIELDS(c->proto)[k].ref = strings[kind];
+        }
+        c->nslots = next_word();
+        c->vtab = xmalloc(c->nslots * sizeof(Func *));
+        for (int k = 0; k < c->nslots; k++)
+            c->vtab[k] = (Func *) (long) next_word();
+    }
+}
+
+static Func *func_ref(long n)
+{
+    if (n < 0 || n >= nfuncs)
+        bad("bad function number in ");
+    return &funcs[n];
+}
+
+/*
+ * Translates code to direct-threaded form, with the handlers of run()
+ * in labels.
+ */
+static Code *load_code(int32_t *w, int32_t len, const void **labels)
+{
+    Code *code = xmalloc(len * sizeof(Code));
+    int32_t pc = 0;
+
+    while (pc < len) {
+        int32_t op = w[pc];
+        if (op < 0 || op >= BC_NUM_OPCODES)
+            bad("bad opcode in ");
+        code[pc++].op = labels[op];
+        for (const char *sig = signatures[op]; *sig; sig++) {
+            if (pc >= len)
+                bad("truncated code in ");
+            int32_t n = w[pc];
+            switch (*sig) {
+            case 's':
+                if (n < 0 || n >= nstrings)
+                    bad("bad string constant in ");
+                code[pc++].s = strings[n];
+                break;
+            case 'f':
+                code[pc++].f = func_ref(n);
+                break;
+            case 'l':
+                if (n < 0 || n >= len)
+                    bad("bad jump in ");
+                code[pc++].l = &code[n];
+                break;
+            case 'c':
+                if (n < 0 || n >= nclasses)
+                    bad("bad class tag in ");
+                code[pc++].n = n;
+                break;
+            case 'x':
+                code[pc++].n = -1;
+                break;
+            case '*':
+                if (n < 0 || pc + n >= len)
+                    bad("truncated code in ");
+                code[pc++].n = n;
+                for (; n > 0; n--, pc++)
+                    code[pc].n = w[pc];
+                break;
+            default:
+                code[pc++].n = n;
+            }
+        }
+    }
+    return code;
+}
+
+static void load_functions(const void **labels)
+{
+    nfuncs = next_word();
+    funcs = xmalloc(nfuncs * sizeof(Func));
+    for (int k = 0; k < nfuncs; k++) {
+        Func *fn = &funcs[k];
+        int32_t len;
+        char *name = next_chars(&len);
+        fn->name = xmalloc(len + 1);
+        memcpy(fn->name, name, len);
+        fn->file = strings[next_index(nstrings)];
+        fn->native = next_index(BC_NUM_NATIVES);
+        fn->nref = next_word();
+        fn->nint = next_word();
+        fn->nref_formals = next_word();
+        fn->nint_formals = next_word();
+        len = next_word();
+        if (len < 0 || word_end - words < len)
+            bad("truncated bytecode in ");
+        if (fn->native != BC_NOT_NATIVE) {
+            fn->nref_formals = natives[fn->native].nref_formals;
+            fn->nint_formals = natives[fn->native].nint_formals;
+            fn->nref = 1 + fn->nref_formals;
+            fn->nint = natives[fn->native].nint;
+        } else {
+            if (fn->nref < 1 + fn->nref_formals || fn->nint < fn->nint_formals)
+                bad("bad registers in ");
+            fn->code = load_code(words, len, labels);
+        }
+        words += len;
+    }
+
+    for (int t = 0; t < nclasses; t++) {
+        Class *c = &classes[t];
+        long init = (long) c->init;
+        c->init = init < 0 ? NULL : func_ref(init);
+        for (int k = 0; k < c->nslots; k++)
+            c->vtab[k] = func_ref((long) c->vtab[k]);
+    }
+}
+
+/*
+ * Loads the program, and makes boot the function that runs it:
+ * new Main.main(), then HALT.
+ */
+static void load(const char *file, const void **labels, Func *boot)
+{
+    FILE *f = fopen(file, "rb");
+    long size;
+
+    bc_file = file;
+    if (f == NULL || fseek(f, 0, SEEK_END) != 0 || (size = ftell(f)) < 0)
+        fatal("cannot read ", file);
+    rewind(f);
+    words = xmalloc(size + 4);
+    if (fread(words, 1, size, f) != (size_t) size)
+        fatal("cannot read ", file);
+    fclose(f);
+    word_end = words + size / 4;
+
+    if (next_word() != BC_MAGIC || next_word() != BC_VERSION)
+        fatal("not Cool bytecode: ", file);
+    int_tag = next_word();
+    bool_tag = next_word();
+    string_tag = next_word();
+    load_strings();
+    load_classes();
+    load_functions(labels);
+    int32_t main_tag = next_index(nclasses);
+    Func *main_fn = func_ref(next_word());
+
+    Code *code = xmalloc(10 * sizeof(Code));
+    code[0].op = labels[BC_NEW];
+    code[1].n = 1;
+    code[2].n = main_tag;
+    code[3].op = labels[BC_CALL];
+    code[4].n = 2;			/* reference register 1 */
+    code[5].f = main_fn;
+    code[6].n = 0;
+    code[7].n = 1;
+    code[8].n = 0;
+    code[9].op = labels[BC_NUM_OPCODES];
+    boot->name = "boot";
+    boot->file = strings[0];
+    boot->nref = 2;
+    boot->code = code;
+
+    /* the Bools, like the constants, are outside the heap */
+    for (int k = 0; k < 2; k++) {
+        bool_obj[k] = xmalloc((HEADER_WORDS + 1) * sizeof(Slot));
+        bool_obj[k]->tag = bool_tag;
+        bool_obj[k]->words = HEADER_WORDS + 1;
+        FIELDS(bool_obj[k])[0].i = k;
+    }
+}
+
+
+/*
+ * The interpreter.  r and i are the registers of the function fn that
+ * is running, and pc its next instruction.  Operand k of the
+ * instruction at pc is pc[k].
+ */
+#define R(k)		r[pc[k].n]
+#define I(k)		i[pc[k].n]
+#define NEXT(len)	do { pc += (len); goto *pc->op; } while (0)
+
+static void run(const char *file)
+{
+    static const void *labels[] = {
+#define BC_LABEL(name, sig) &&op_##name,
+        BC_OPCODES(BC_LABEL)
+#undef BC_LABEL
+        &&op_HALT
+    };
+    Func boot = { 0 };
+    Frame *frame = frames;
+    Func *fn, *callee;
+    Code *pc, *args;
+    Obj **r, *recv;
+    int *i;
+    long dst, nargs;
+
+    load(file, labels, &boot);
+    fn = &boot;
+    r = rstack;
+    i = istack;
+    rtop = r + fn->nref;
+    pc = fn->code;
+    goto *pc->op;
+
+op_MOVR:
+    R(1) = R(2);
+    NEXT(3);
+op_MOVI:
+    I(1) = I(2);
+    NEXT(3);
+op_LDI:
+    I(1) = (int) pc[2].n;
+    NEXT(3);
+op_LDS:
+    R(1) = pc[2].s;
+    NEXT(3);
+op_LDNULL:
+    R(1) = NULL;
+    NEXT(2);
+op_GETR:
+    R(1) = FIELDS(r[0])[pc[2].n].ref;
+    NEXT(3);
+op_GETI:
+    I(1) = (int) FIELDS(r[0])[pc[2].n].i;
+    NEXT(3);
+op_SETR:
+    FIELDS(r[0])[pc[1].n].ref = R(2);
+    NEXT(3);
+op_SETI:
+    FIELDS(r[0])[pc[1].n].i = I(2);
+    NEXT(3);
+
+    /* Int arithmetic as on the machine: add, sub and neg trap on
+       overflow, mul and div wrap around */
+op_ADD:
+    if (__builtin_add_overflow(I(2), I(3), &I(1)))
+        die("  Exception 12  [Arithmetic overflow]  Execution aborted\n");
+    NEXT(4);
+op_SUB:
+    if (__builtin_sub_overflow(I(2), I(3), &I(1)))
+        die("  Exception 12  [Arithmetic overflow]  Execution aborted\n");
+    NEXT(4);
+op_MUL:
+    I(1) = (int) ((unsigned) I(2) * (unsigned) I(3));
+    NEXT(4);
+op_DIV:
+    if (I(3) == 0)
+        die("  Exception 9  [Breakpoint/Division by 0]  Execution aborted\n");
+    if (I(3) == -1)
+        I(1) = (int) (0u - (unsigned) I(2));
+    else
+        I(1) = I(2) / I(3);
+    NEXT(4);
+op_NEG:
+    if (__builtin_sub_overflow(0, I(2), &I(1)))
+        die("  Exception 12  [Arithmetic overflow]  Execution aborted\n");
+    NEXT(3);
+op_LT:
+    I(1) = I(2) < I(3);
+    NEXT(4);
+op_LE:
+    I(1) = I(2) <= I(3);
+    NEXT(4);
+op_EQI:
+    I(1) = I(2) == I(3);
+    NEXT(4);
+op_NOT:
+    I(1) = !I(2);
+    NEXT(3);
+op_EQR:
+    I(1) = equal(R(2), R(3));
+    NEXT(4);
+op_ISVOID:
+    I(1) = R(2) == NULL;
+    NEXT(3);
+op_BOXI:
+    recv = new_int(I(2));
+    R(1) = recv;
+    NEXT(3);
+op_BOXB:
+    R(1) = bool_obj[I(2) != 0];
+    NEXT(3);
+op_UNBOX:
+    I(1) = (int) FIELDS(R(2))[0].i;
+    NEXT(3);
+op_TAG:
+    I(1) = R(2)->tag;
+    NEXT(3);
+
+op_NEW:
+    recv = copy_of(classes[pc[2].n].proto);
+    callee = classes[pc[2].n].init;
+    goto new_object;
+op_NEWSELF:
+    recv = copy_of(classes[r[0]->tag].proto);
+    callee = classes[recv->tag].init;
+new_object:
+    R(1) = recv;
+    if (callee == NULL)
+        NEXT(2 + (pc->op == &&op_NEW));
+    dst = pc[1].n << 1;
+    args = NULL;
+    nargs = 0;
+    pc += 2 + (pc->op == &&op_NEW);
+    goto call;
+
+op_JMP:
+    pc = pc[1].l;
+    goto *pc->op;
+op_JF:
+    if (!I(1)) {
+        pc = pc[2].l;
+        goto *pc->op;
+    }
+    NEXT(3);
+op_JT:
+    if (I(1)) {
+        pc = pc[2].l;
+        goto *pc->op;
+    }
+    NEXT(3);
+op_JFLT:
+    if (!(I(1) < I(2))) {
+        pc = pc[3].l;
+        goto *pc->op;
+    }
+    NEXT(4);
+op_JFLE:
+    if (!(I(1) <= I(2))) {
+        pc = pc[3].l;
+        goto *pc->op;
+    }
+    NEXT(4);
+op_JFEQ:
+    if (I(1) != I(2)) {
+        pc = pc[3].l;
+        goto *pc->op;
+    }
+    NEXT(4);
+op_JTLT:
+    if (I(1) < I(2)) {
+        pc = pc[3].l;
+        goto *pc->op;
+    }
+    NEXT(4);
+op_JTLE:
+    if (I(1) <= I(2)) {
+        pc = pc[3].l;
+        goto *pc->op;
+    }
+    NEXT(4);
+op_JTEQ:
+    if (I(1) == I(2)) {
+        pc = pc[3].l;
+        goto *pc->op;
+    }
+    NEXT(4);
+op_JOUT:
+    if (I(1) < pc[2].n || I(1) > pc[3].n) {
+        pc = pc[4].l;
+        goto *pc->op;
+    }
+    NEXT(5);
+
+op_CALL:
+    recv = R(4);
+    if (recv == NULL) {
+        print_position(fn, pc[3].n);
+        die(": Dispatch to void.\n");
+    }
+    callee = pc[2].f;
+    args = pc + 5;
+    goto setup;
+op_DISPATCH:
+    recv = R(4);
+    if (recv == NULL) {
+        print_position(fn, pc[3].n);
+        die(": Dispatch to void.\n");
+    }
+    if (pc[5].n != recv->tag) {
+        pc[5].n = recv->tag;
+        pc[6].f = classes[recv->tag].vtab[pc[2].n];
+    }
+    callee = pc[6].f;
+    args = pc + 7;
+setup:
+    dst = pc[1].n;
+    nargs = args[0].n;
+    pc = args + 1 + nargs;
+
+    /*
+     * The callee's registers follow the caller's: self, the reference
+     * arguments and the other references, and the int arguments.
+     */
+call:
+    {
+        Obj **nr = r + fn->nref;
+        int *ni = i + fn->nint;
+        int kr = 1, ki = 0;
+
+        if (nr + callee->nref > rstack + RSTACK_SIZE ||
+            ni + callee->nint > istack + ISTACK_SIZE || frame == frames + FRAMES)
+            die("Stack overflow.\n");
+        nr[0] = recv;
+        for (long k = 1; k <= nargs; k++) {
+            long d = args[k].n;
+            if (d & 1)
+                ni[ki++] = i[d >> 1];
+            else
+                nr[kr++] = r[d >> 1];
+        }
+        frame->pc = pc;
+        frame->fn = fn;
+        frame->r = r;
+        frame->i = i;
+        frame->dst = dst;
+        frame++;
+        rtop = nr + callee->nref;
+
+        if (callee->native != BC_NOT_NATIVE) {
+            call_native(callee->native, nr, ni);
+            frame--;
+            if (dst & 1)
+                i[dst >> 1] = ni[0];
+            else
+                r[dst >> 1] = nr[0];
+            rtop = r + fn->nref;
+            goto *pc->op;
+        }
+        for (; kr < callee->nref; kr++)
+            nr[kr] = NULL;
+        fn = callee;
+        r = nr;
+        i = ni;
+        pc = fn->code;
+        goto *pc->op;
+    }
+
+op_RET:
+    frame--;
+    dst = frame->dst;
+    if (dst & 1)
+        frame->i[dst >> 1] = i[pc[1].n >> 1];
+    else
+        frame->r[dst >> 1] = r[pc[1].n >> 1];
+    fn = frame->fn;
+    r = frame->r;
+    i = frame->i;
+    pc = frame->pc;
+    rtop = r + fn->nref;
+    goto *pc->op;
+
+op_CASEVOID:
+    if (R(1) == NULL) {
+        print_position(fn, pc[2].n);
+        die("Match on void in case statement.\n");
+    }
+    NEXT(3);
+op_CASEABORT:
+    fputs("No match in case statement for Class ", stdout);
+    print_class_name(R(1));
+    die("\n");
+
+op_HALT:
+    return;
+}
+
+static void *reserve(size_t bytes)
+{
+    void *p = mmap(NULL, bytes, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (p == MAP_FAILED)
+        fatal("cannot reserve memory", "");
+    return p;
+}
+
+int main(int argc, char **argv)
+{
+    int k = 1;
+
+    if (k < argc && strcmp(argv[k], "-t") == 0) {
+        gc_test = 1;
+        k++;
+    }
+    if (k != argc - 1) {
+        fprintf(stderr, "usage: %s [-t] program.bc\n", argv[0]);
+        return 1;
+    }
+
+    heap_lo = heap_ptr = reserve(HEAP_RESERVE);
+    heap_end = heap_lo + HEAP_RESERVE;
+    heap_limit = heap_lo + HEAP_MIN;
+    rstack = reserve(RSTACK_SIZE * sizeof(Obj *));
+    istack = reserve(ISTACK_SIZE * sizeof(int));
+    frames = reserve(FRAMES * sizeof(Frame));
+
+    run(argv[k]);
+    fputs("COOL program successfully executed\n", stdout);
+    return 0;
+}
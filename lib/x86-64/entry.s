@@ -0,0 +1,188 @@
+#
+# Entry points of the x86-64 runtime that the code of cgen -m x86-64
+# calls directly.  They use its calling convention: the receiver in
+# %rax, self in %rbx, arguments on the stack, popped by the callee.
+# Most of them hand over to a C function in runtime.c.
+#
+# A C function that may allocate is passed a pointer to the receiver
+# and the caller's self, pushed here, followed by the return address
+# and the arguments:
+#
+#	0(%rdi)		receiver
+#	8(%rdi)		caller's self (%rbx)
+#	16(%rdi)	return address
+#	24(%rdi) ...	arguments, the last one first
+#
+# cool_sp is left pointing there: everything from it up to
+# cool_stack_base is Cool stack, where the collector finds its roots.
+# The pushed receiver and self are roots too, and are reloaded from
+# the stack after the call in case they moved.
+#
+
+	.text
+
+#
+# Call the C function fn from Cool code: C wants the stack aligned to
+# 16 bytes, which Cool frames do not keep.
+#
+	.macro	CALL_C fn
+	pushq	%rbp
+	movq	%rsp, %rbp
+	andq	$-16, %rsp
+	call	\fn
+	leave
+	.endm
+
+#
+# A method of a basic class implemented by the C function fn, which
+# returns the result.
+#
+	.macro	PRIMITIVE name, fn, nargs
+	.globl	\name
+\name:
+	pushq	%rbx
+	pushq	%rax
+	movq	%rsp, %rdi
+	movq	%rsp, cool_sp(%rip)
+	CALL_C	\fn
+	addq	$8, %rsp
+	popq	%rbx
+	ret	$(8 * \nargs)
+	.endm
+
+#
+# Run Main.main on a new Main object.  The callee-saved registers of C
+# are kept above cool_stack_base; %rbx and %rbp, which Cool frames
+# save, are cleared so that no C value is taken for a root.
+#
+	.globl	_cool_start
+_cool_start:
+	pushq	%rbx
+	pushq	%rbp
+	pushq	%r12
+	pushq	%r13
+	pushq	%r14
+	pushq	%r15
+	movq	%rsp, cool_stack_base(%rip)
+	xorl	%ebx, %ebx
+	xorl	%ebp, %ebp
+	leaq	Main_protObj(%rip), %rax
+	call	Object.copy
+	call	Main_init
+	call	Main.main
+	popq	%r15
+	popq	%r14
+	popq	%r13
+	popq	%r12
+	popq	%rbp
+	popq	%rbx
+	ret
+
+#
+# Object.copy
+#
+#	INPUT:	%rax object to copy
+#	OUTPUT:	%rax the copy
+#
+# Allocates from cool_alloc_ptr up to cool_alloc_limit without
+# calling C; the C side makes room when that fails.
+#
+	.globl	Object.copy
+Object.copy:
+	movq	8(%rax), %rcx			# size in words
+	movq	cool_alloc_ptr(%rip), %rdi
+	leaq	(%rdi,%rcx,8), %rdx
+	cmpq	cool_alloc_limit(%rip), %rdx
+	ja	_copy_collect
+	movq	%rdx, cool_alloc_ptr(%rip)
+	movq	%rdi, %rdx
+	movq	%rax, %rsi
+	rep movsq
+	movq	%rdx, %rax
+	ret
+_copy_collect:
+	pushq	%rbx
+	pushq	%rax
+	movq	%rsp, %rdi
+	movq	%rsp, cool_sp(%rip)
+	CALL_C	cool_copy
+	addq	$8, %rsp
+	popq	%rbx
+	ret
+
+	PRIMITIVE Object.abort, cool_abort, 0
+	PRIMITIVE IO.out_string, cool_out_string, 1
+	PRIMITIVE IO.out_int, cool_out_int, 1
+	PRIMITIVE IO.in_string, cool_in_string, 0
+	PRIMITIVE IO.in_int, cool_in_int, 0
+	PRIMITIVE String.concat, cool_concat, 1
+	PRIMITIVE String.substr, cool_substr, 2
+
+#
+# Object.type_name
+#
+#	INPUT:	%rax object
+#	OUTPUT:	%rax its class name, from class_nameTab
+#
+	.globl	Object.type_name
+Object.type_name:
+	movq	(%rax), %rcx
+	leaq	class_nameTab(%rip), %rdx
+	movq	(%rdx,%rcx,8), %rax
+	ret
+
+#
+# String.length
+#
+#	INPUT:	%rax the string
+#	OUTPUT:	%rax the Int holding its length
+#
+	.globl	String.length
+String.length:
+	movq	24(%rax), %rax
+	ret
+
+#
+# equality_test
+#
+#	INPUT:	%rdi, %rsi two different objects
+#	OUTPUT:	%rax bool_const1 if they are equal Ints, Bools or
+#		Strings, bool_const0 otherwise
+#
+	.globl	equality_test
+equality_test:
+	CALL_C	cool_equal
+	ret
+
+#
+# The runtime errors.  None of these return.
+#
+#	_dispatch_abort, _case_abort2
+#		%rax file name, %rdi line number
+#	_case_abort
+#		%rax the object that matched no branch
+#	_overflow_abort
+#		an Int add, sub or neg overflowed
+#
+	.globl	_dispatch_abort
+_dispatch_abort:
+	movq	%rdi, %rsi
+	movq	%rax, %rdi
+	CALL_C	cool_dispatch_abort
+
+	.globl	_case_abort2
+_case_abort2:
+	movq	%rdi, %rsi
+	movq	%rax, %rdi
+	CALL_C	cool_case_abort2
+
+	.globl	_case_abort
+_case_abort:
+	movq	%rax, %rdi
+	CALL_C	cool_case_abort
+
+	.globl	_overflow_abort
+_overflow_abort:
+	CALL_C	cool_overflow
+
+	.section	.note.GNU-stack,"",@progbits
@@ -0,0 +1,416 @@
+/*
+ * Runtime system for Cool programs compiled with cgen -m x86-64.
+ *
+ * It does for native programs what lib/trap.handler does under spim:
+ * it starts the program, implements the methods of the basic classes,
+ * reports runtime errors with the same messages, and manages memory.
+ * The entry points that the generated code calls directly are in
+ * entry.s.
+ *
+ * Objects have the MIPS layout with 8-byte words:
+ *
+ *	 0	class tag
+ *	 8	size in words, header included
+ *	16	dispatch table
+ *	24	attributes ...
+ *
+ * An Int or Bool keeps its value in the low 32 bits of its attribute;
+ * a String has a pointer to its length (an Int) there, followed by
+ * the characters and a terminating zero.
+ *
+ * Programs compiled with -g (or -G) get a copying collector with two
+ * semispaces; otherwise the heap only grows.  The roots are the words
+ * of the Cool stack: the code generator keeps nothing there but
+ * references, return addresses and frame pointers, so every word that
+ * points into the heap is a reference to an object.  With -t the
+ * collector runs at every allocation.
+ */
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+typedef struct Object Object;
+struct Object {
+    long tag;
+    long size;
+    void *disp;
+    Object *attr[];
+};
+
+#define WORD_SIZE	8
+#define HEADER_WORDS	3
+#define INT_WORDS	(HEADER_WORDS + 1)
+#define STR_MAXSIZE	1026		/* longest line in_string reads */
+
+/* the int in the first attribute word, read and written without
+   type-punning the Object pointer stored there */
+static inline int int_val(Object *o)
+{
+    int v;
+    memcpy(&v, &o->attr[0], sizeof v);
+    return v;
+}
+
+static inline void set_int_val(Object *o, int v)
+{
+    memcpy(&o->attr[0], &v, sizeof v);
+}
+
+#define INT_VAL(o)	int_val(o)
+#define STR_LEN(o)	INT_VAL((o)->attr[0])
+#define STR_CHARS(o)	((char *) &(o)->attr[1])
+
+/* words of a String of n characters */
+#define STR_WORDS(n)	(HEADER_WORDS + 1 + ((n) + WORD_SIZE) / WORD_SIZE)
+
+#define FORWARDED	(-1L)		/* tag of an object already copied */
+
+/*
+ * What a C function called through PRIMITIVE in entry.s sees of the
+ * stack.  The arguments are in reverse order.
+ */
+typedef struct Frame {
+    Object *self;
+    Object *caller_self;
+    void *ret;
+    Object *args[];
+} Frame;
+
+#define ARG(f, nargs, i)	((f)->args[(nargs) - 1 - (i)])
+
+/* from the generated code */
+extern long _int_tag, _bool_tag, _string_tag;
+extern long _MemMgr_GC, _MemMgr_TEST;
+extern Object *class_nameTab[];
+extern Object Int_protObj, String_protObj, bool_const0, bool_const1;
+
+/* shared with entry.s */
+Object **cool_sp;
+Object **cool_stack_base;
+char *cool_alloc_ptr;
+char *cool_alloc_limit;
+
+extern void _cool_start(void);
+
+static char *heap_lo, *heap_hi;		/* current semispace or chunk */
+static size_t heap_size = 1 << 20;	/* size of the next one */
+
+static void die(const char *msg)
+{
+    fputs(msg, stdout);
+    fflush(stdout);
+    exit(0);
+}
+
+/*
+ * Memory.
+ */
+static void set_limit(void)
+{
+    cool_alloc_limit = _MemMgr_TEST ? NULL : heap_hi;
+}
+
+static char *new_space(size_t size)
+{
+    char *p = malloc(size);
+    if (p == NULL)
+        die("Out of memory.\n");
+    return p;
+}
+
+/* without a collector, a full heap is left behind for a new one */
+static void grow(size_t need)
+{
+    size_t size = heap_size > need ? heap_size : need;
+    heap_lo = cool_alloc_ptr = new_space(size);
+    heap_hi = heap_lo + size;
+    set_limit();
+}
+
+static int in_from_space(Object *o)
+{
+    return (char *) o >= heap_lo && (char *) o < heap_hi;
+}
+
+static long pointer_words(Object *o)
+{
+    if (o->tag == _int_tag || o->tag == _bool_tag)
+        return 0;
+    if (o->tag == _string_tag)
+        return 1;
+    return o->size - HEADER_WORDS;
+}
+
+static void forward(Object **p, char **next)
+{
+    Object *o = *p;
+    if (!in_from_space(o))
+        return;
+    if (o->tag == FORWARDED) {
+        *p = o->disp;
+        return;
+    }
+    Object *copy = (Object *) *next;
+    memcpy(copy, o, o->size * WORD_SIZE);
+    *next += o->size * WORD_SIZE;
+    o->tag = FORWARDED;
+    o->disp = copy;
+    *p = copy;
+}
+
+/*
+ * Copy what is reachable from the stack into a new semispace large
+ * enough for need more bytes even if everything is live; the next one
+ * is at least twice what survives.
+ */
+static void collect(size_t need)
+{
+    size_t used = cool_alloc_ptr - heap_lo;
+    size_t size = heap_size > used + need ? heap_size : used + need;
+    char *to = new_space(size);
+    char *next = to;
+    char *scan = to;
+
+    for (Object **p = cool_sp; p < cool_stack_base; p++)
+        forward(p, &next);
+    while (scan < next) {
+        Object *o = (Object *) scan;
+        long n = pointer_words(o);
+        for (long i = 0; i < n; i++)
+            forward(&o->attr[i], &next);
+        scan += o->size * WORD_SIZE;
+    }
+
+    free(heap_lo);
+    heap_lo = to;
+    heap_hi = to + size;
+    cool_alloc_ptr = next;
+    set_limit();
+    size_t live = next - to;
+    if (2 * (live + need) > heap_size)
+        heap_size = 2 * (live + need);
+}
+
+/*
+ * Make room for bytes more bytes; references held in C variables are
+ * stale afterwards and must be read again from the frame.
+ */
+static void reserve(size_t bytes)
+{
+    if (cool_alloc_ptr + bytes <= heap_hi && !_MemMgr_TEST)
+        return;
+    if (_MemMgr_GC)
+        collect(bytes);
+    else
+        grow(bytes);
+}
+
+/* allocate after reserve(); never collects */
+static Object *take(long words)
+{
+    Object *o = (Object *) cool_alloc_ptr;
+    cool_alloc_ptr += words * WORD_SIZE;
+    return o;
+}
+
+static Object *clone(Object *proto, long words)
+{
+    Object *o = take(words);
+    memcpy(o, proto, proto->size * WORD_SIZE);
+    o->size = words;
+    return o;
+}
+
+static Object *new_int(int val)
+{
+    Object *i = clone(&Int_protObj, INT_WORDS);
+    set_int_val(i, val);
+    return i;
+}
+
+/* a String of len characters, zeroed; needs room for an Int as well */
+static Object *new_string(int len)
+{
+    Object *length = new_int(len);
+    Object *s = clone(&String_protObj, STR_WORDS(len));
+    s->attr[0] = length;
+    memset(STR_CHARS(s), 0, (STR_WORDS(len) - HEADER_WORDS - 1) * WORD_SIZE);
+    return s;
+}
+
+static size_t string_bytes(int len)
+{
+    return (INT_WORDS + STR_WORDS(len)) * WORD_SIZE;
+}
+
+/*
+ * Methods of the basic classes.
+ */
+Object *cool_copy(Frame *f)
+{
+    reserve(f->self->size * WORD_SIZE);
+    return clone(f->self, f->self->size);
+}
+
+static void print_class_name(Object *o)
+{
+    Object *name = class_nameTab[o->tag];
+    fwrite(STR_CHARS(name), 1, STR_LEN(name), stdout);
+}
+
+Object *cool_abort(Frame *f)
+{
+    fputs("Abort called from class ", stdout);
+    print_class_name(f->self);
+    die("\n");
+    return NULL;
+}
+
+Object *cool_out_string(Frame *f)
+{
+    Object *s = ARG(f, 1, 0);
+    fwrite(STR_CHARS(s), 1, STR_LEN(s), stdout);
+    return f->self;
+}
+
+Object *cool_out_int(Frame *f)
+{
+    printf("%d", INT_VAL(ARG(f, 1, 0)));
+    return f->self;
+}
+
+/* reads a line, or nothing at the end of the input */
+static void read_line(char *buf, int size)
+{
+    fflush(stdout);
+    if (!fgets(buf, size, stdin))
+        buf[0] = '\0';
+}
+
+Object *cool_in_int(Frame *f)
+{
+    char buf[256];
+    read_line(buf, sizeof buf);
+    int val = (int) strtol(buf, NULL, 10);
+    reserve(INT_WORDS * WORD_SIZE);
+    return new_int(val);
+}
+
+/*
+ * The line without its newline.  As in trap.handler, nothing at all
+ * (the end of the input) reads as a newline.
+ */
+Object *cool_in_string(Frame *f)
+{
+    char buf[STR_MAXSIZE];
+    read_line(buf, sizeof buf);
+    int len = strlen(buf);
+    if (len == 0)
+        buf[len++] = '\n';
+    else if (buf[len - 1] == '\n')
+        len--;
+    reserve(string_bytes(len));
+    Object *s = new_string(len);
+    memcpy(STR_CHARS(s), buf, len);
+    return s;
+}
+
+Object *cool_concat(Frame *f)
+{
+    int len1 = STR_LEN(f->self);
+    int len2 = STR_LEN(ARG(f, 1, 0));
+    if (len2 == 0)
+        return f->self;
+    reserve(string_bytes(len1 + len2));
+    Object *s = new_string(len1 + len2);
+    memcpy(STR_CHARS(s), STR_CHARS(f->self), len1);
+    memcpy(STR_CHARS(s) + len1, STR_CHARS(ARG(f, 1, 0)), len2);
+    return s;
+}
+
+Object *cool_substr(Frame *f)
+{
+    int len = STR_LEN(f->self);
+    int i = INT_VAL(ARG(f, 2, 0));
+    int l = INT_VAL(ARG(f, 2, 1));
+
+    if (i < 0)
+        die("Index to substr is negative\nExecution aborted.\n");
+    if (i > len)
+        die("Index to substr is too big\nExecution aborted.\n");
+    if (i + l > len)
+        die("Length to substr too long\nExecution aborted.\n");
+    if (l < 0)
+        die("Length to substr is negative\nExecution aborted.\n");
+
+    reserve(string_bytes(l));
+    Object *s = new_string(l);
+    memcpy(STR_CHARS(s), STR_CHARS(f->self) + i, l);
+    return s;
+}
+
+Object *cool_equal(Object *a, Object *b)
+{
+    if (a == NULL || b == NULL || a->tag != b->tag)
+        return &bool_const0;
+    if (a->tag == _int_tag || a->tag == _bool_tag)
+        return INT_VAL(a) == INT_VAL(b) ? &bool_const1 : &bool_const0;
+    if (a->tag == _string_tag)
+        return STR_LEN(a) == STR_LEN(b) &&
+               memcmp(STR_CHARS(a), STR_CHARS(b), STR_LEN(a)) == 0 ?
+               &bool_const1 : &bool_const0;
+    return &bool_const0;
+}
+
+/*
+ * Runtime errors.
+ */
+static void print_position(Object *file, long line)
+{
+    fwrite(STR_CHARS(file), 1, STR_LEN(file), stdout);
+    printf(":%ld", line);
+}
+
+void cool_dispatch_abort(Object *file, long line)
+{
+    print_position(file, line);
+    die(": Dispatch to void.\n");
+}
+
+void cool_case_abort2(Object *file, long line)
+{
+    print_position(file, line);
+    die("Match on void in case statement.\n");
+}
+
+void cool_case_abort(Object *o)
+{
+    fputs("No match in case statement for Class ", stdout);
+    print_class_name(o);
+    die("\n");
+}
+
+void cool_overflow(void)
+{
+    die("  Exception 12  [Arithmetic overflow]  Execution aborted\n");
+}
+
+static void divide_by_zero(int sig)
+{
+    static const char msg[] = "  Exception 9  [Breakpoint/Division by 0]"
+                              "  Execution aborted\n";
+    fflush(stdout);
+    write(1, msg, sizeof msg - 1);
+    _exit(0);
+}
+
+int main(void)
+{
+    signal(SIGFPE, divide_by_zero);
+    grow(heap_size);
+    _cool_start();
+    fputs("COOL program successfully executed\n", stdout);
+    return 0;
+}